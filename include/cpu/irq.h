@@ -18,4 +18,8 @@ typedef void (*irq_handler_t)(registers_t *r);
 void irq_install();
 void irq_register_handler(int irq, irq_handler_t handler);
 
+// Returns 1 if `irq` could be delivered right now: interrupts are enabled
+// and no equal or higher priority IRQ is still in service at the PIC.
+int irq_can_deliver(int irq);
+
 #endif
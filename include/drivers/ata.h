@@ -3,7 +3,48 @@
 
 #include <stdint.h>
 
+#define ATA_SECTOR_SIZE 512
+
+// Largest transfer issued as a single READ/WRITE SECTORS command.
+#define ATA_MAX_SECTORS 256
+
+typedef struct
+{
+    uint8_t present;
+    uint8_t lba48;
+    uint8_t dma; // PCI bus master IDE DMA in use
+    uint32_t sectors;
+} ata_info_t;
+
+// One piece of a scatter-gather transfer: `count` sectors at `buffer`.
+typedef struct
+{
+    uint8_t *buffer;
+    uint32_t count;
+} ata_sg_t;
+
+// Identify the primary master (LBA48 support, disk size) and set up PCI
+// bus master DMA when the controller supports it. PIO is the fallback.
+void ata_init();
+ata_info_t ata_get_info();
+
 void ata_read_sector(uint32_t lba, uint8_t *buffer);
 void ata_write_sector(uint32_t lba, uint8_t *buffer);
 
+// Transfer 1..ATA_MAX_SECTORS sectors with one command (DMA when
+// available, completion signalled on IRQ14). LBA48 (EXT)
+// commands are used automatically past the 28-bit boundary.
+// Return 1 on success, 0 on a device error or invalid range.
+int ata_read_sectors(uint32_t lba, uint32_t count, uint8_t *buffer);
+int ata_write_sectors(uint32_t lba, uint32_t count, const uint8_t *buffer);
+
+// Same, but the consecutive sectors starting at `lba` are scattered over
+// `nsg` buffers. The segments' counts must add up to 1..ATA_MAX_SECTORS.
+// DMA maps the segments to PRD entries; PIO switches buffers per sector.
+int ata_transfer_sg(uint32_t lba, const ata_sg_t *sg, int nsg, int write);
+
+// Writes complete once the data is in the drive's write cache. FLUSH
+// CACHE is the barrier that puts it on the medium. Returns 1 on success.
+int ata_flush();
+
 #endif
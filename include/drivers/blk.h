@@ -0,0 +1,80 @@
+#ifndef BLK_H
+#define BLK_H
+
+#include <stdint.h>
+
+// Block request layer between the sector cache and the ATA driver.
+// Requests are queued in elevator (ascending LBA, C-LOOK) order; when the
+// queue runs, runs of adjacent same-direction requests are merged into a
+// single scatter-gather command of up to ATA_MAX_SECTORS sectors.
+//
+// Submissions dispatch immediately unless the queue is plugged. Plugging
+// lets a caller submit a whole batch (e.g. a file's cluster chain) and
+// have it coalesced when the outermost blk_unplug() runs.
+
+#define BLK_POOL_SIZE 64
+#define BLK_MAX_SEGMENTS 16
+
+#define BLK_PENDING 0
+#define BLK_OK 1
+#define BLK_ERROR 2
+
+typedef struct blk_request
+{
+    uint32_t lba;
+    uint32_t count;
+    uint8_t *buffer;
+    uint8_t write;
+    uint8_t pooled;
+    volatile int status;
+
+    // Called once the request finished (status is BLK_OK or BLK_ERROR).
+    void (*done)(struct blk_request *req);
+    void *ctx;
+
+    struct blk_request *next;
+} blk_request_t;
+
+typedef struct
+{
+    uint32_t requests;
+    uint32_t merges;
+    uint32_t commands;
+    uint32_t errors;
+} blk_stats_t;
+
+void blk_init();
+
+void blk_request_init(blk_request_t *req, uint32_t lba, uint32_t count,
+                      uint8_t *buffer, int write,
+                      void (*done)(blk_request_t *req), void *ctx);
+
+// Queue a caller-owned request. The request and its buffer must stay
+// valid until `done` runs.
+void blk_submit(blk_request_t *req);
+
+// Queue a write using a request from the internal pool. `buffer` must
+// stay untouched until the queue has run. Returns 0 if the write failed
+// or couldn't be queued; while plugged, a failure that happens when the
+// queue runs is reported by blk_unplug() instead.
+int blk_submit_write(uint32_t lba, uint32_t count, const uint8_t *buffer);
+
+// Plugging nests; the queue runs when the outermost plug is removed.
+// blk_unplug() returns 0 if a pooled write failed while plugged.
+void blk_plug();
+int blk_unplug();
+
+// Dispatch everything queued now, regardless of plugging.
+void blk_run_queue();
+
+// Write barrier: drain the queue, then flush the drive's write cache.
+// Returns 1 on success.
+int blk_flush();
+
+// Synchronous transfers. Return 1 on success, 0 on error.
+int blk_read(uint32_t lba, uint32_t count, uint8_t *buffer);
+int blk_write(uint32_t lba, uint32_t count, const uint8_t *buffer);
+
+blk_stats_t blk_get_stats();
+
+#endif
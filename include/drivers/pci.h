@@ -0,0 +1,33 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+
+// Legacy PCI configuration space access through ports 0xCF8/0xCFC.
+
+#define PCI_REG_VENDOR_ID 0x00
+#define PCI_REG_COMMAND 0x04
+#define PCI_REG_CLASS 0x08
+#define PCI_REG_HEADER_TYPE 0x0C
+#define PCI_REG_BAR4 0x20
+
+#define PCI_COMMAND_IO 0x0001
+#define PCI_COMMAND_BUS_MASTER 0x0004
+
+typedef struct
+{
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+} pci_device_t;
+
+uint32_t pci_config_read32(pci_device_t dev, uint8_t offset);
+void pci_config_write32(pci_device_t dev, uint8_t offset, uint32_t value);
+uint16_t pci_config_read16(pci_device_t dev, uint8_t offset);
+void pci_config_write16(pci_device_t dev, uint8_t offset, uint16_t value);
+
+// Scan every bus/slot/function for the first device with the given class
+// and subclass. Returns 1 and fills *out when found.
+int pci_find_class(uint8_t class_code, uint8_t subclass, pci_device_t *out);
+
+#endif
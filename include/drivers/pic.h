@@ -5,4 +5,7 @@ void pic_remap();
 void pic_send_eoi(int irq);
 void pic_clear_mask(unsigned char irq_line);
 
+// In-service register of both PICs (bit n = IRQ n is being handled).
+unsigned short pic_get_isr();
+
 #endif
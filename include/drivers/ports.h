@@ -7,5 +7,11 @@ uint8_t inb(uint16_t port);
 void outb(uint16_t port, uint8_t data);
 uint16_t inw(uint16_t port);
 void outw(uint16_t port, uint16_t data);
+uint32_t inl(uint16_t port);
+void outl(uint16_t port, uint32_t data);
+
+// Block transfers of `count` 16-bit words (rep insw / rep outsw).
+void insw(uint16_t port, void *buffer, uint32_t count);
+void outsw(uint16_t port, const void *buffer, uint32_t count);
 
 #endif
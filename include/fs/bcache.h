@@ -0,0 +1,59 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+
+// Write-back cache of 512-byte disk sectors sitting between the filesystem
+// and the ATA driver. Lookups are hashed by LBA; eviction is LRU.
+
+#define BCACHE_SECTOR_SIZE 512
+#define BCACHE_NUM_BUFFERS 128
+#define BCACHE_HASH_BUCKETS 64
+
+// Largest readahead batch: half the cache, so streaming a file can't
+// push all of the directory and FAT sectors out.
+#define BCACHE_READAHEAD_MAX (BCACHE_NUM_BUFFERS / 2)
+
+typedef struct
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t writebacks;
+    uint32_t evictions;
+    uint32_t dirty;
+    uint32_t readahead; // sectors fetched by bcache_prefetch()
+} bcache_stats_t;
+
+void bcache_init();
+
+// Copy a sector out of the cache, reading it from disk on a miss.
+void bcache_read(uint32_t lba, uint8_t *buffer);
+
+// Replace a cached sector and mark it dirty. The disk is only written on
+// eviction or bcache_sync().
+void bcache_write(uint32_t lba, const uint8_t *buffer);
+
+// Bulk transfers of `count` consecutive sectors. Fully cached ranges are
+// served from RAM; otherwise the range goes to the disk through the block
+// layer without displacing the cached metadata. Writes update any cached
+// copies and are queued straight to disk; while the block queue is
+// plugged the source buffer must stay valid until blk_unplug(), which
+// then reports a failed write. bcache_write_range() returns 0 on error.
+void bcache_read_range(uint32_t lba, uint32_t count, uint8_t *buffer);
+int bcache_write_range(uint32_t lba, uint32_t count, const uint8_t *buffer);
+
+// Start reading up to BCACHE_READAHEAD_MAX sectors from `lba` into the
+// cache ahead of use. Sectors already cached are skipped and the missing
+// ones go out as merged commands. Stops early rather than evicting a
+// dirty buffer.
+void bcache_prefetch(uint32_t lba, uint32_t count);
+
+// Write every dirty sector back to disk, merged into as few commands as
+// the elevator can manage, and wait for the queue to drain. Returns 0 if
+// a sector failed to write, here or when it was evicted earlier; sectors
+// that failed here stay dirty.
+int bcache_sync();
+
+bcache_stats_t bcache_get_stats();
+
+#endif
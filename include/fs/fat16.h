@@ -2,6 +2,7 @@
 #define FAT16_H
 
 #include <stdint.h>
+#include "fs/vfs.h"
 
 typedef struct
 {
@@ -11,10 +12,82 @@ typedef struct
     uint8_t num_fats;
     uint16_t root_entries;
     uint16_t total_sectors_16;
-    uint16_t sectors_per_fat;
+    uint32_t sectors_per_fat; // BPB_FATSz16, or BPB_FATSz32 on FAT32
     uint32_t total_sectors_32;
+
+    // FAT32 only
+    uint32_t root_cluster;
+    uint16_t fsinfo_sector;
 } fat16_bpb_t;
 
+// A mounted volume: the BPB plus the layout derived from it. FAT32
+// volumes share everything but the entry width and the root directory,
+// which is an ordinary cluster chain there.
+typedef struct
+{
+    fat16_bpb_t bpb;
+    uint8_t mounted;
+    uint8_t fat_bits;        // 16 or 32
+
+    uint32_t eoc;            // end-of-chain value written
+    uint32_t eoc_min;        // entries >= this end a chain
+
+    uint32_t fat_start;      // first sector of FAT #1
+    uint32_t root_start;     // first sector of the root directory (FAT16)
+    uint32_t root_sectors;   // sectors in the root directory (FAT16)
+    uint32_t data_start;     // first sector of cluster 2
+    uint32_t total_clusters; // data clusters on the volume
+    uint32_t cluster_bytes;
+} fat16_volume_t;
+
+// An open file: the resolved directory entry plus a cursor into its
+// cluster chain, so sequential access doesn't re-walk the FAT.
+typedef struct fat16_file
+{
+    uint32_t first_cluster;
+    uint32_t size;
+    uint8_t attr;
+
+    uint32_t entry_sector; // where the directory entry lives
+    uint32_t entry_offset;
+
+    uint32_t cursor_index;   // cluster index within the file...
+    uint32_t cursor_cluster; // ...and its cluster number (0 = unset)
+
+    uint32_t tail_index;   // last cluster of the chain, so appends don't
+    uint32_t tail_cluster; // walk it from the head (0 = unknown)
+
+    // Sequential readahead: where the next streaming read would start,
+    // how far the sector cache has been filled, and the window (sectors).
+    uint32_t ra_next;
+    uint32_t ra_end;
+    uint32_t ra_window;
+
+    // Size and first cluster are written to the directory entry on close
+    // or sync rather than after every write.
+    char name[11];
+    uint8_t dirty;
+    struct fat16_file *next_dirty;
+
+    // Open files are tracked from fat16_open() to fat16_file_close(), so
+    // path-based calls that replace, move or delete the entry can update
+    // them, and a write through one handle passes the new size and chain
+    // to the others on the same entry. A file whose entry was deleted has
+    // entry_sector 0.
+    struct fat16_file *next_open;
+} fat16_file_t;
+
+typedef struct
+{
+    uint32_t hits;          // names found through a directory index
+    uint32_t negative_hits; // names known to be absent
+    uint32_t builds;        // directories scanned to build an index
+} fat16_dindex_stats_t;
+
+// Longest name component accepted. VFAT allows 255 characters, but paths
+// are limited to 128 bytes anyway.
+#define FAT16_NAME_MAX 127
+
 typedef struct
 {
     char name[8];
@@ -32,29 +105,73 @@ typedef struct
     uint32_t file_size;
 } __attribute__((packed)) fat16_dir_entry_t;
 
+// VFAT long-name slot (attr 0x0F). A long name is stored in 13-character
+// pieces, last piece first, immediately before its 8.3 entry.
+typedef struct
+{
+    uint8_t order; // piece number, 0x40 set on the last piece
+    uint16_t name1[5];
+    uint8_t attr;
+    uint8_t type;
+    uint8_t checksum; // of the 8.3 name
+    uint16_t name2[6];
+    uint16_t first_cluster;
+    uint16_t name3[2];
+} __attribute__((packed)) fat16_lfn_entry_t;
+
 /* init */
+// Mount the volume on the primary disk: parse the BPB once and load the FAT.
+int fat16_mount();
+
+// Write everything back, then re-read and re-validate the boot sector
+// (e.g. after the disk was changed underneath us).
+int fat16_remount();
+
+// Cheap check used before filesystem calls; mounts lazily if needed.
 int fat16_init();
+
 fat16_bpb_t fat16_get_bpb();
+const fat16_volume_t *fat16_get_volume();
+uint32_t fat16_free_clusters();
+fat16_dindex_stats_t fat16_get_dindex_stats();
+
+/* durability */
+// What happens at the end of every modifying operation:
+//   LAZY      - dirty metadata stays in the sector cache until sync
+//   WRITEBACK - the sector cache is written to the drive
+//   FLUSH     - written back, then the drive cache is flushed (default)
+#define FAT16_DURABILITY_LAZY 0
+#define FAT16_DURABILITY_WRITEBACK 1
+#define FAT16_DURABILITY_FLUSH 2
+
+void fat16_set_durability(int mode);
+int fat16_get_durability();
 
-/* navigation */
-void fat16_ls();
-int fat16_ls_path(const char *path);
+// Write everything back and flush the drive cache, whatever the mode.
+int fat16_sync();
 
-int fat16_cd_path(const char *path);
-void fat16_pwd();
-const char *fat16_get_path();
+/* paths */
+// Paths are relative to the volume root; the working directory lives in
+// the VFS, which passes absolute paths.
 
-/* file reading */
-int fat16_cat(const char *filename);
+// Directory entry for `path`. The root reports as a directory (attr 0x10).
+int fat16_stat(const char *path, fat16_dir_entry_t *out);
+
+// Call `fn` for every entry of the directory at `path` except "." and
+// "..". Iteration stops early when `fn` returns 0.
+typedef int (*fat16_readdir_fn)(void *ctx, const char *name, const fat16_dir_entry_t *entry);
+int fat16_readdir(const char *path, fat16_readdir_fn fn, void *ctx);
 
 /* file creation */
-int fat16_touch(const char *filename);
-int fat16_mkdir(const char *dirname);
+int fat16_touch(const char *path);
+int fat16_mkdir(const char *path);
 int fat16_mkdir_p(const char *path);
 
 /* file deletion */
-int fat16_rm(const char *filename);
-int fat16_rmdir(const char *dirname);
+// rm returns -1 for a directory; rmdir returns -1 for a file and -2 if
+// the directory is not empty.
+int fat16_rm(const char *path);
+int fat16_rmdir(const char *path);
 int fat16_rm_rf(const char *path);
 
 /* file writing */
@@ -69,6 +186,34 @@ int fat16_mv(const char *src, const char *dst);
 // Returns 1 on success, 0 on failure. `out_read` receives bytes read.
 int fat16_read_at(const char *path, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read);
 int fat16_filesize(const char *path, uint32_t *out_size);
-int fat16_list_dir(const char *path, char *out, uint32_t out_size, uint32_t *out_written);
+
+/* open files */
+// Resolve `path` once. Returns 0 for missing files and directories.
+int fat16_open(const char *path, fat16_file_t *file);
+
+// Re-read size and first cluster from the directory entry after the file
+// was changed through a path-based call. Returns 0 if it was deleted.
+// (Path-based calls in this driver already refresh tracked open files.)
+int fat16_file_refresh(fat16_file_t *file);
+
+int fat16_file_read(fat16_file_t *file, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read);
+
+// Write `len` bytes at `offset` in place. Only the sectors covered are
+// touched; the chain grows as needed and a gap past the old end reads back
+// as zeros. Returns 1 if everything was written; `out_written` receives
+// the byte count either way (short only when the disk fills up).
+int fat16_file_write(fat16_file_t *file, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written);
+
+// Write the pending size/first-cluster update to the directory entry.
+int fat16_file_sync(fat16_file_t *file);
+
+// Sync the entry and commit per the durability mode. A written file
+// object must be closed (or the volume synced) before it goes away.
+void fat16_file_close(fat16_file_t *file);
+
+// Filesystem operations for mounting the volume in the VFS.
+extern const vfs_ops_t fat16_vfs_ops;
+
+int fat16_write_at(const char *path, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written);
 
 #endif
@@ -0,0 +1,23 @@
+#ifndef INITRD_H
+#define INITRD_H
+
+#include <stdint.h>
+#include "fs/vfs.h"
+
+// Read-only filesystem over a ustar archive loaded by the boot loader as
+// a multiboot module. File data is served straight from the module's
+// memory; only the index of entries is allocated.
+
+// Is the buffer a ustar archive (magic of the first header)?
+int initrd_probe(const uint8_t *base, uint32_t size);
+
+// Index the archive and return the mount data for initrd_vfs_ops, or 0
+// if it is not a valid archive. The module memory must stay reserved.
+void *initrd_create(const uint8_t *base, uint32_t size);
+
+// Number of files and directories indexed.
+uint32_t initrd_count(void *fs);
+
+extern const vfs_ops_t initrd_vfs_ops;
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef PCACHE_H
+#define PCACHE_H
+
+#include <stdint.h>
+#include "fs/vfs.h"
+
+// Page cache: whole 4KB pages of file data, kept in frames from the page
+// allocator so they can be mapped straight into user space. Files are
+// identified by mount and absolute path; a change to the mount (its VFS
+// generation) retires the cached copy, while pages still mapped keep the
+// old data. Unmapped pages stay cached after their last user, so running
+// the same program again finds them.
+
+#define PCACHE_PAGES 32
+#define PCACHE_FILES 16
+
+typedef struct pcache_file pcache_file_t;
+
+typedef struct
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t cached; // pages holding file data
+    uint32_t mapped; // pages with at least one mapping
+} pcache_stats_t;
+
+void pcache_init();
+
+// Cached file for the open `node`, whose absolute VFS path is `path`.
+// Takes a reference; returns 0 when every file slot is in use.
+pcache_file_t *pcache_file_get(vfs_node_t *node, const char *path);
+void pcache_file_put(pcache_file_t *file);
+
+// Frame holding page `index` of the file, read through `node` on a miss
+// and counted as mapped until pcache_page_put(). Returns 1 on success, 0
+// past the end of the file or on a read error, and -1 when every frame
+// is mapped.
+int pcache_page_get(pcache_file_t *file, vfs_node_t *node, uint32_t index, uint32_t *frame);
+void pcache_page_put(uint32_t frame);
+
+// Forget every cached page that isn't mapped (e.g. after a remount).
+void pcache_drop();
+
+pcache_stats_t pcache_get_stats();
+
+#endif
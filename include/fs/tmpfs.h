@@ -0,0 +1,27 @@
+#ifndef TMPFS_H
+#define TMPFS_H
+
+#include <stdint.h>
+#include "fs/vfs.h"
+
+// RAM-backed filesystem for scratch files. Everything lives on the kernel
+// heap and is gone at reboot; nothing ever reaches the disk.
+
+typedef struct
+{
+    uint32_t files;
+    uint32_t dirs;
+    uint32_t bytes;     // file data held
+    uint32_t max_bytes; // limit set at creation
+} tmpfs_stats_t;
+
+// Create an empty instance holding at most `max_bytes` of file data; pass
+// the result as the mount data for tmpfs_vfs_ops. Returns 0 when out of
+// memory.
+void *tmpfs_create(uint32_t max_bytes);
+
+tmpfs_stats_t tmpfs_get_stats(void *fs);
+
+extern const vfs_ops_t tmpfs_vfs_ops;
+
+#endif
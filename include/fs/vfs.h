@@ -0,0 +1,132 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include <stdint.h>
+
+// Virtual filesystem switch. Filesystems are mounted on absolute paths
+// and implement vfs_ops_t; the VFS owns the working directory, resolves
+// every path to (mount, path inside the mount) by longest mount prefix,
+// and hands the filesystem an absolute path within it ("/", "/A/B").
+// Names compare case-insensitively, as on FAT.
+
+#define VFS_PATH_MAX 128
+#define VFS_NAME_MAX 127
+#define VFS_MAX_MOUNTS 8
+
+#define VFS_FILE 1
+#define VFS_DIR 2
+
+// vfs_open() flags
+#define VFS_O_CREAT (1u << 0) // create the file if it doesn't exist
+#define VFS_O_TRUNC (1u << 1) // cut an existing file to zero length
+#define VFS_O_EXCL (1u << 2)  // with CREAT: fail if the file exists
+
+typedef struct
+{
+    uint8_t type; // VFS_FILE or VFS_DIR
+    uint32_t size;
+} vfs_stat_t;
+
+struct vfs_mount;
+struct vfs_ops;
+
+// An open file (vnode). Created by the filesystem's open(), released by
+// vfs_close(). `size` is kept current by the filesystem.
+typedef struct vfs_node
+{
+    const struct vfs_ops *ops;
+    struct vfs_mount *mount;
+    uint32_t size;
+    void *data; // filesystem private
+} vfs_node_t;
+
+// Called for each directory entry; returning 0 stops the listing.
+typedef int (*vfs_readdir_fn)(void *ctx, const char *name, const vfs_stat_t *st);
+
+// Return values follow the FAT driver: 1 on success, 0 on failure, and
+// for remove() -1 when the target has the wrong type and -2 when a
+// directory is not empty. Optional operations may be left 0.
+typedef struct vfs_ops
+{
+    const char *name;
+
+    /* namespace */
+    int (*open)(struct vfs_mount *mnt, const char *path, uint32_t flags, vfs_node_t **out);
+    int (*stat)(struct vfs_mount *mnt, const char *path, vfs_stat_t *out);
+    int (*readdir)(struct vfs_mount *mnt, const char *path, vfs_readdir_fn fn, void *ctx);
+    int (*mkdir)(struct vfs_mount *mnt, const char *path);
+    int (*remove)(struct vfs_mount *mnt, const char *path, int dir);
+    int (*remove_tree)(struct vfs_mount *mnt, const char *path);
+    int (*rename)(struct vfs_mount *mnt, const char *src, const char *dst);
+    int (*copy)(struct vfs_mount *mnt, const char *src, const char *dst); // optional
+    int (*sync)(struct vfs_mount *mnt); // optional
+
+    /* open files */
+    int (*read)(vfs_node_t *node, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read);
+    int (*write)(vfs_node_t *node, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written);
+    void (*close)(vfs_node_t *node);
+} vfs_ops_t;
+
+typedef struct vfs_mount
+{
+    uint8_t used;
+    char path[VFS_PATH_MAX]; // normalized mount point
+    uint32_t path_len;
+    const vfs_ops_t *ops;
+    void *data; // filesystem private
+
+    // Bumped by every change made through the VFS, so caches keyed by
+    // path can tell when their copy may be stale.
+    uint32_t generation;
+} vfs_mount_t;
+
+void vfs_init();
+
+// Mount `ops` at the absolute path `path`. The mount point does not need
+// to exist in the parent filesystem; it shows up in listings either way.
+int vfs_mount(const char *path, const vfs_ops_t *ops, void *data);
+
+// Mount table entry `index`, or 0 past the end.
+const vfs_mount_t *vfs_get_mount(int index);
+
+/* working directory */
+int vfs_chdir(const char *path);
+const char *vfs_getcwd();
+
+// Make `path` absolute against the working directory and fold "." and
+// ".." away. `out` holds VFS_PATH_MAX bytes.
+void vfs_normalize(const char *path, char *out);
+
+/* namespace */
+int vfs_stat(const char *path, vfs_stat_t *out);
+int vfs_readdir(const char *path, vfs_readdir_fn fn, void *ctx);
+
+// Names one per line into `out`, NUL terminated; stops quietly when the
+// buffer is full.
+int vfs_list_dir(const char *path, char *out, uint32_t out_size, uint32_t *out_written);
+int vfs_mkdir(const char *path);
+int vfs_mkdir_p(const char *path);
+int vfs_remove(const char *path, int dir);
+int vfs_remove_tree(const char *path);
+
+// Like the FAT commands: a directory destination receives the source
+// under its own name. Crossing mounts falls back to copying through
+// open files (mv: files only).
+int vfs_copy(const char *src, const char *dst);
+int vfs_rename(const char *src, const char *dst);
+
+// Write back every mounted filesystem.
+int vfs_sync();
+
+/* open files */
+int vfs_open(const char *path, uint32_t flags, vfs_node_t **out);
+int vfs_read(vfs_node_t *node, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read);
+int vfs_write(vfs_node_t *node, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written);
+void vfs_close(vfs_node_t *node);
+
+// Whole-file helpers: replace the contents, or append to them (creating
+// the file either way).
+int vfs_write_file(const char *path, const uint8_t *data, uint32_t size);
+int vfs_append_file(const char *path, const uint8_t *data, uint32_t size);
+
+#endif
@@ -51,10 +51,16 @@ typedef struct
     uint32_t p_align;
 } __attribute__((packed)) elf32_phdr_t;
 
-// Loads an ELF32 ET_EXEC from FAT16 into memory (identity-mapped).
+// p_flags
+#define PF_X 0x1
+#define PF_W 0x2
+#define PF_R 0x4
+
+// Loads an ELF32 ET_EXEC from any mounted filesystem into the current address
+// space, backing its segments with fresh pages (read-only unless writable).
 // Returns 1 on success. On success, sets *out_entry to the entry virtual address,
 // and *out_low/*out_high to the min/max virtual address range of loaded segments.
-int elf32_load_from_fat16(const char *path, uint32_t *out_entry, uint32_t *out_low, uint32_t *out_high);
+int elf32_load(const char *path, uint32_t *out_entry, uint32_t *out_low, uint32_t *out_high);
 
 #endif
 
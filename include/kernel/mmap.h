@@ -0,0 +1,27 @@
+#ifndef MMAP_H
+#define MMAP_H
+
+#include <stdint.h>
+
+// Read-only file mappings for user programs. mmap_file() only reserves
+// address space in the mmap window; pages are filled from the page cache
+// by the page-fault handler on first touch.
+
+#define MMAP_MAX_REGIONS 16
+
+// Map `length` bytes of the file at absolute VFS path `path` from
+// `offset` (page aligned). Returns the user address, or 0 on failure.
+uint32_t mmap_file(const char *path, uint32_t offset, uint32_t length);
+
+// Remove the mapping that starts at `addr`; `length` must cover it.
+// Returns 1 on success.
+int mmap_unmap(uint32_t addr, uint32_t length);
+
+// Drop every mapping (the user program exited).
+void mmap_unmap_all();
+
+// Page-fault hook: returns 1 when the fault was for a mapped file page
+// and has been resolved.
+int mmap_handle_fault(uint32_t addr, uint32_t err_code);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include <stdint.h>
+
+// Multiboot (v1) structures handed over by GRUB in EBX; EAX holds
+// MULTIBOOT_BOOTLOADER_MAGIC. Only the fields the kernel uses are named.
+
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+#define MULTIBOOT_INFO_MEMORY (1u << 0)
+#define MULTIBOOT_INFO_MODS (1u << 3)
+#define MULTIBOOT_INFO_MEM_MAP (1u << 6)
+
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
+typedef struct
+{
+    uint32_t flags;
+    uint32_t mem_lower; // KB below 1MB
+    uint32_t mem_upper; // KB above 1MB
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+} __attribute__((packed)) multiboot_info_t;
+
+typedef struct
+{
+    uint32_t mod_start;
+    uint32_t mod_end; // one past the last byte
+    uint32_t string;  // module command line
+    uint32_t reserved;
+} __attribute__((packed)) multiboot_module_t;
+
+// Memory map entries are `size` + 4 bytes apart.
+typedef struct
+{
+    uint32_t size; // of the rest of the entry
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type; // MULTIBOOT_MEMORY_AVAILABLE for usable RAM
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+#endif
@@ -18,7 +18,12 @@ enum
     SYS_CHDIR = 6,
     SYS_GETCWD = 7,
     SYS_WRITEFD = 8,
-    SYS_LISTDIR = 9
+    SYS_LISTDIR = 9,
+    SYS_LSEEK = 10,
+    SYS_PWRITE = 11,
+    SYS_MMAP = 12,
+    SYS_MUNMAP = 13,
+    SYS_MEMINFO = 14
 };
 
 // open() flags (shared between kernel and user wrappers)
@@ -28,4 +33,26 @@ enum
 #define SYS_O_CREAT  (1u << 2)
 #define SYS_O_TRUNC  (1u << 3)
 
+// lseek() whence values
+#define SYS_SEEK_SET 0
+#define SYS_SEEK_CUR 1
+#define SYS_SEEK_END 2
+
+// mmap() failure value
+#define SYS_MAP_FAILED ((void *)-1)
+
+// meminfo() result
+typedef struct
+{
+    uint32_t total_pages;
+    uint32_t free_pages;
+    uint32_t free_blocks;  // page allocator free-list length
+    uint32_t largest_free; // bytes in the largest free block
+    uint32_t heap_bytes;   // kmalloc, rounded to class/page size
+    uint32_t heap_peak;
+    uint32_t heap_blocks;
+    uint32_t heap_failures;
+    uint32_t slab_free; // unused objects in allocated slabs
+} sys_meminfo_t;
+
 #endif
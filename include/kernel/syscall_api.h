@@ -15,5 +15,15 @@ int sys_close(int fd);
 int sys_chdir(const char *path);
 int sys_getcwd(char *buf, uint32_t size);
 int sys_listdir(const char *path, char *out, uint32_t out_size);
+int sys_lseek(int fd, int32_t offset, uint32_t whence);
+int sys_pwrite(int fd, const void *buf, uint32_t count, uint32_t offset);
+
+// Map `length` bytes of an open file, from a page-aligned `offset`,
+// read-only into the address space. Returns SYS_MAP_FAILED on error.
+void *sys_mmap(int fd, uint32_t offset, uint32_t length);
+int sys_munmap(void *addr, uint32_t length);
+
+// Page allocator and kernel heap counters.
+int sys_meminfo(sys_meminfo_t *out);
 
 #endif
@@ -3,9 +3,51 @@
 
 #include <stdint.h>
 
-void kmalloc_init(uint32_t heap_start);
+// General-purpose kernel allocator: power-of-two size classes from 16 to
+// 2048 bytes come from slab caches, larger requests from the page
+// allocator (up to 4MB). Both paths are O(1) in the number of live
+// allocations. Returns 0 when out of memory.
+//
+// Every allocation is charged to its call site ("file:line"), so live
+// blocks can be traced back to the code that leaked them.
 
-void* kmalloc(uint32_t size);
+#define KMALLOC_CLASSES 8    // 16 ... 2048 bytes
+#define KMALLOC_MAX_SITES 48 // later sites are only counted in the totals
+
+typedef struct
+{
+    uint32_t bytes;      // handed out, rounded up to the class or page
+    uint32_t peak_bytes;
+    uint32_t blocks;     // live allocations
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    uint32_t sizes[KMALLOC_CLASSES + 1]; // requests per class, then large
+} kmalloc_stats_t;
+
+typedef struct
+{
+    const char *site;
+    uint32_t allocs;
+    uint32_t blocks; // live
+    uint32_t bytes;  // live
+} kmalloc_site_t;
+
+void kmalloc_init();
+
+#define KMALLOC_STR_(x) #x
+#define KMALLOC_STR(x) KMALLOC_STR_(x)
+#define kmalloc(size) kmalloc_at((size), __FILE__ ":" KMALLOC_STR(__LINE__))
+
+void* kmalloc_at(uint32_t size, const char *site);
 void kfree(void* ptr);
 
+kmalloc_stats_t kmalloc_get_stats();
+
+// Call site `index` in order of first use; returns 0 past the end.
+int kmalloc_get_site(int index, kmalloc_site_t *out);
+
+// Size of class `index`, or 0 for the large-object path.
+uint32_t kmalloc_class_size(int index);
+
 #endif
@@ -0,0 +1,26 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdint.h>
+
+#define PAGE_SIZE 4096
+
+// Page table entry bits.
+#define PAGE_PRESENT 0x1
+#define PAGE_RW 0x2
+#define PAGE_USER 0x4
+#define PAGE_LARGE 0x80 // 4MB page (page directory entry)
+#define PAGE_OWNED 0x200 // frame belongs to the mapping (available bit)
+
+// Virtual layout. RAM below LAYOUT_USER_BASE is identity-mapped,
+// supervisor-only, in every address space; user space above it is
+// private to each one. The top 1GB is left unmapped.
+#define LAYOUT_USER_BASE 0x40000000u
+#define LAYOUT_USER_END 0xC0000000u
+
+// Window of user virtual space for mmap(). Pages in it are mapped on
+// demand by the page-fault handler.
+#define LAYOUT_MMAP_BASE 0x40000000u
+#define LAYOUT_MMAP_END 0x44000000u
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include <stdint.h>
+#include "kernel/multiboot.h"
+#include "memory/layout.h"
+
+// Physical page frame allocator. Usable RAM comes from the multiboot
+// memory map (or mem_upper when there is none) and is managed as a buddy
+// system: free blocks of 2^order pages sit on per-order lists, an
+// allocation splits a larger block when it has to and a release merges
+// the block with its buddy while that is free. Both are O(log n).
+//
+// Only RAM below PMM_LIMIT (where user space starts) is managed.
+// The kernel identity-maps all of it, so a frame's address is also its
+// pointer.
+
+#define PMM_MAX_ORDER 10 // largest block: 1024 pages (4MB)
+#define PMM_LIMIT LAYOUT_USER_BASE
+
+typedef struct
+{
+    uint32_t start;
+    uint32_t end; // one past the last byte
+} pmm_range_t;
+
+typedef struct
+{
+    uint32_t total_pages; // usable RAM found at boot
+    uint32_t free_pages;
+    uint32_t free_blocks[PMM_MAX_ORDER + 1];
+} pmm_stats_t;
+
+// Build the free lists. `mbi` may be 0 (no boot information: the first
+// 4MB are assumed, as before the allocator existed); frames in
+// `reserved` (kernel image, boot modules, ...) and below 1MB are never
+// handed out. The per-frame table is placed after a reserved range.
+// Returns 0 when no usable memory was found.
+int pmm_init(const multiboot_info_t *mbi, const pmm_range_t *reserved, int reserved_count);
+
+// One past the highest usable byte, for sizing the identity map.
+uint32_t pmm_get_top();
+
+// A block of 2^order contiguous pages, aligned to its size, or 0.
+uint32_t pmm_alloc_pages(uint32_t order);
+void pmm_free_pages(uint32_t addr, uint32_t order);
+
+// `pages` contiguous pages (at most 2^PMM_MAX_ORDER) without rounding
+// up to a power of two: the block is split and its unused tail freed.
+// Returns 0 when no block is large enough.
+uint32_t pmm_alloc_run(uint32_t pages);
+
+// Free a run from pmm_alloc_run() and return its length in pages, or 0
+// if `addr` doesn't start one.
+uint32_t pmm_free_run(uint32_t addr);
+
+uint32_t pmm_alloc_page();
+void pmm_free_page(uint32_t addr);
+
+pmm_stats_t pmm_get_stats();
+
+#endif
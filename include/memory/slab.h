@@ -0,0 +1,47 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+
+// Slab allocator for fixed-size kernel objects. Each cache carves pages
+// from the page allocator into equal objects; a page (slab) starts with a
+// small header, so an object's slab is found by masking its address, and
+// free objects are chained through their first word. Allocation and
+// release are O(1). Each object also has a tag byte in the slab header
+// area for its owner's bookkeeping.
+
+#define KMEM_MAX_CACHES 24
+
+// Largest object a one-page slab can hold.
+#define KMEM_MAX_OBJECT 2048
+
+typedef struct kmem_cache kmem_cache_t;
+
+typedef struct
+{
+    const char *name;
+    uint32_t object_size;
+    uint32_t objects;  // allocated
+    uint32_t capacity; // objects the held slabs can take
+    uint32_t slabs;    // pages held
+} kmem_cache_stats_t;
+
+// Create a cache of `size`-byte objects (at most KMEM_MAX_OBJECT). `name`
+// must stay valid. Returns 0 when the cache table is full.
+kmem_cache_t *kmem_cache_create(const char *name, uint32_t size);
+
+void *kmem_cache_alloc(kmem_cache_t *cache);
+// Returns 0 (and frees nothing) if `obj` isn't an object of `cache`.
+int kmem_cache_free(kmem_cache_t *cache, void *obj);
+
+// Cache that owns `ptr`, or 0 when it isn't a slab object.
+kmem_cache_t *kmem_cache_of(const void *ptr);
+
+// Tag of an allocated object (0 when it is handed out, and after free).
+void kmem_set_tag(void *obj, uint8_t tag);
+uint8_t kmem_get_tag(const void *obj);
+
+// Stats for cache `index` in creation order; returns 0 past the end.
+int kmem_cache_get_stats(int index, kmem_cache_stats_t *out);
+
+#endif
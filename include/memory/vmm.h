@@ -0,0 +1,53 @@
+#ifndef VMM_H
+#define VMM_H
+
+#include <stdint.h>
+#include "memory/layout.h"
+
+// Virtual memory manager. The kernel half (below LAYOUT_USER_BASE) is
+// built once at boot and its page directory entries are copied into
+// every address space; the user half gets page tables from the page
+// allocator as mappings are made. Only one space is active (in CR3) at
+// a time.
+
+typedef struct vmm_space vmm_space_t;
+
+// Identity-map physical memory up to `ram_top` (at least the first 4MB,
+// which uses 4KB pages, the rest 4MB pages) and enable paging in the
+// kernel's own address space.
+void vmm_init(uint32_t ram_top);
+
+vmm_space_t *vmm_kernel_space();
+vmm_space_t *vmm_current();
+
+// New address space with an empty user half; 0 when out of memory.
+vmm_space_t *vmm_space_create();
+
+// Free the space's page tables and the frames it owns (PAGE_OWNED).
+// Other mappings must be gone already; the space must not be current.
+void vmm_space_destroy(vmm_space_t *space);
+
+// Load `space` into CR3 and return the one it replaced.
+vmm_space_t *vmm_switch(vmm_space_t *space);
+
+// Map one page of the user half. Fails if `vaddr` is already mapped or
+// a page table can't be allocated.
+int vmm_map(vmm_space_t *space, uint32_t vaddr, uint32_t paddr, uint32_t flags);
+
+// Unmap one page and return its frame (0 if nothing was mapped). An owned
+// frame is freed here; any other frame is the caller's to release.
+uint32_t vmm_unmap(vmm_space_t *space, uint32_t vaddr);
+
+// Replace the PAGE_RW/PAGE_USER bits of every mapped page in
+// [start, end). Returns 0 if the range isn't in the user half.
+int vmm_protect(vmm_space_t *space, uint32_t start, uint32_t end, uint32_t flags);
+
+// Back [start, end) with zeroed frames owned by the space. Pages already
+// mapped keep their frame and gain `flags`. Returns 0 when memory runs
+// out (pages mapped so far stay, and go with the space).
+int vmm_alloc(vmm_space_t *space, uint32_t start, uint32_t end, uint32_t flags);
+
+// Physical address behind `vaddr` in the current space, or 0.
+uint32_t vmm_virt_to_phys(uint32_t vaddr);
+
+#endif
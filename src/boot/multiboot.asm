@@ -1,9 +1,12 @@
+MB_MAGIC equ 0x1BADB002
+MB_FLAGS equ 0x3            ; page-align boot modules, memory map
+
 section .multiboot
 align 4
 
-dd 0x1BADB002
-dd 0x0
-dd -(0x1BADB002 + 0x0)
+dd MB_MAGIC
+dd MB_FLAGS
+dd -(MB_MAGIC + MB_FLAGS)
 
 section .bss
 align 16
@@ -19,6 +22,8 @@ start:
     cli
     mov esp, stack_top  ; setup stack
 
+    push ebx            ; multiboot info
+    push eax            ; boot loader magic
     call kernel_main
 
 .hang:
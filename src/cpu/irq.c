@@ -38,6 +38,28 @@ void irq_handler(registers_t *r) {
     }
 }
 
+int irq_can_deliver(int irq) {
+    uint32_t eflags;
+    __asm__ __volatile__("pushf; pop %0" : "=r"(eflags));
+
+    if (!(eflags & 0x200)) {
+        return 0;
+    }
+
+    unsigned short isr = pic_get_isr();
+
+    // Master priority order is 0, 1, 2 (the whole slave), 3..7.
+    if (irq < 8) {
+        return (isr & ((1 << (irq + 1)) - 1)) ? 0 : 1;
+    }
+
+    if (isr & 0x07) {
+        return 0;
+    }
+
+    return ((isr >> 8) & ((1 << (irq - 8 + 1)) - 1)) ? 0 : 1;
+}
+
 void irq_install() {
     idt_set_gate(32, (uint32_t)irq0);
     idt_set_gate(33, (uint32_t)irq1);
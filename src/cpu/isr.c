@@ -1,6 +1,7 @@
 #include "cpu/isr.h"
 #include "cpu/idt.h"
 #include "kernel/print.h"
+#include "kernel/mmap.h"
 #include "vga.h"
 
 static isr_t interrupt_handlers[256];
@@ -146,6 +147,10 @@ void isr_handler(registers_t *r)
         return;
     }
 
+    // Page faults in the mmap window are demand paging, not errors.
+    if (r->int_no == 14 && mmap_handle_fault(read_cr2(), r->err_code))
+        return;
+
     // Default exception handling
     print("\n\n[EXCEPTION] ");
 
@@ -1,5 +1,8 @@
 #include "drivers/ata.h"
 #include "drivers/ports.h"
+#include "drivers/pci.h"
+#include "cpu/irq.h"
+#include "memory/vmm.h"
 
 #define ATA_PRIMARY_IO 0x1F0
 #define ATA_PRIMARY_CTRL 0x3F6
@@ -15,74 +18,448 @@
 #define ATA_REG_STATUS 0x07
 
 #define ATA_CMD_READ_PIO 0x20
+#define ATA_CMD_READ_PIO_EXT 0x24
+#define ATA_CMD_WRITE_PIO 0x30
+#define ATA_CMD_WRITE_PIO_EXT 0x34
+#define ATA_CMD_CACHE_FLUSH 0xE7
+#define ATA_CMD_CACHE_FLUSH_EXT 0xEA
+#define ATA_CMD_IDENTIFY 0xEC
+#define ATA_CMD_READ_DMA 0xC8
+#define ATA_CMD_READ_DMA_EXT 0x25
+#define ATA_CMD_WRITE_DMA 0xCA
+#define ATA_CMD_WRITE_DMA_EXT 0x35
 
 #define ATA_STATUS_BSY 0x80
+#define ATA_STATUS_DF 0x20
 #define ATA_STATUS_DRQ 0x08
 #define ATA_STATUS_ERR 0x01
 
-static void ata_wait_bsy()
+// Highest sector reachable with a 28-bit LBA command.
+#define ATA_LBA28_MAX 0x0FFFFFFFu
+
+#define ATA_IRQ 14
+
+// Bus master IDE registers (primary channel, offsets from BAR4).
+#define BM_REG_COMMAND 0x00
+#define BM_REG_STATUS 0x02
+#define BM_REG_PRDT 0x04
+
+#define BM_CMD_START 0x01
+#define BM_CMD_READ 0x08 // device -> memory
+
+#define BM_STATUS_ACTIVE 0x01
+#define BM_STATUS_ERR 0x02
+#define BM_STATUS_IRQ 0x04
+
+#define PRD_EOT 0x8000
+#define PRD_MAX_ENTRIES 32
+
+// Physical region descriptor: one physically contiguous chunk that must
+// not cross a 64 KB boundary. byte_count 0 means 64 KB.
+typedef struct
+{
+    uint32_t phys_addr;
+    uint16_t byte_count;
+    uint16_t flags;
+} __attribute__((packed)) ata_prd_t;
+
+static ata_info_t info;
+
+static uint16_t bm_base = 0;
+static ata_prd_t prd_table[PRD_MAX_ENTRIES] __attribute__((aligned(64)));
+
+static volatile int irq_fired = 0;
+
+/* ---------------- IRQ14 completion ---------------- */
+
+static void ata_irq_handler(registers_t *r)
+{
+    (void)r;
+
+    // Reading the status register acknowledges INTRQ on the drive.
+    inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+    irq_fired = 1;
+}
+
+// Sleep until the next IRQ14 (or any other interrupt). cli/sti around the
+// check closes the window where the IRQ lands just before hlt.
+static void ata_sleep()
+{
+    __asm__ __volatile__("cli");
+
+    if (!irq_fired)
+        __asm__ __volatile__("sti; hlt");
+    else
+        __asm__ __volatile__("sti");
+
+    irq_fired = 0;
+}
+
+// Give up the CPU while a command is in flight. Sleeps until IRQ14 when it
+// can be delivered, so the timer and keyboard keep running during I/O.
+// Inside another IRQ handler (the shell runs in the keyboard IRQ) or with
+// interrupts off the PIC holds IRQ14 back, so the caller just polls.
+static void ata_yield()
+{
+    if (irq_can_deliver(ATA_IRQ))
+        ata_sleep();
+    else
+        __asm__ __volatile__("pause");
+}
+
+// Wait until the drive drops BSY and return its status. Polls the
+// alternate status register, which does not acknowledge INTRQ.
+static uint8_t ata_wait_ready()
+{
+    while (inb(ATA_PRIMARY_CTRL) & ATA_STATUS_BSY)
+        ata_yield();
+
+    // The regular status register acknowledges INTRQ for this phase.
+    return inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+}
+
+static int ata_wait_drq()
+{
+    uint8_t status = ata_wait_ready();
+
+    if (status & (ATA_STATUS_ERR | ATA_STATUS_DF))
+        return 0;
+
+    return (status & ATA_STATUS_DRQ) ? 1 : 0;
+}
+
+// Wait for a DMA command to finish; returns the bus master status.
+static uint8_t ata_dma_wait()
 {
-    while (inb(ATA_PRIMARY_IO + ATA_REG_STATUS) & ATA_STATUS_BSY)
+    for (;;)
     {
+        uint8_t bm_status = inb(bm_base + BM_REG_STATUS);
+        if (bm_status & (BM_STATUS_IRQ | BM_STATUS_ERR))
+            return bm_status;
+
+        ata_yield();
     }
 }
 
-static void ata_wait_drq()
+// Reading the alternate status register four times gives the drive the
+// 400ns it needs before the status register is valid after a command.
+static void ata_delay_400ns()
+{
+    for (int i = 0; i < 4; i++)
+        inb(ATA_PRIMARY_CTRL);
+}
+
+static int ata_needs_lba48(uint32_t lba, uint32_t count)
+{
+    return (lba + count - 1) > ATA_LBA28_MAX;
+}
+
+// Program the task file for `count` sectors at `lba` and issue `cmd28`
+// or its EXT variant. count == 256 is encoded as 0 for LBA28.
+static void ata_issue(uint32_t lba, uint32_t count, uint8_t cmd28, uint8_t cmd48)
 {
-    while (!(inb(ATA_PRIMARY_IO + ATA_REG_STATUS) & ATA_STATUS_DRQ))
+    ata_wait_ready();
+
+    if (ata_needs_lba48(lba, count))
     {
+        outb(ATA_PRIMARY_IO + ATA_REG_HDDEVSEL, 0x40);
+
+        // High-order bytes first, then low-order bytes.
+        outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT0, (uint8_t)(count >> 8));
+        outb(ATA_PRIMARY_IO + ATA_REG_LBA0, (uint8_t)(lba >> 24));
+        outb(ATA_PRIMARY_IO + ATA_REG_LBA1, 0);
+        outb(ATA_PRIMARY_IO + ATA_REG_LBA2, 0);
+
+        outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT0, (uint8_t)(count & 0xFF));
+        outb(ATA_PRIMARY_IO + ATA_REG_LBA0, (uint8_t)(lba & 0xFF));
+        outb(ATA_PRIMARY_IO + ATA_REG_LBA1, (uint8_t)((lba >> 8) & 0xFF));
+        outb(ATA_PRIMARY_IO + ATA_REG_LBA2, (uint8_t)((lba >> 16) & 0xFF));
+
+        outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, cmd48);
     }
+    else
+    {
+        outb(ATA_PRIMARY_IO + ATA_REG_HDDEVSEL, 0xE0 | ((lba >> 24) & 0x0F));
+        outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT0, (uint8_t)(count & 0xFF));
+
+        outb(ATA_PRIMARY_IO + ATA_REG_LBA0, (uint8_t)(lba & 0xFF));
+        outb(ATA_PRIMARY_IO + ATA_REG_LBA1, (uint8_t)((lba >> 8) & 0xFF));
+        outb(ATA_PRIMARY_IO + ATA_REG_LBA2, (uint8_t)((lba >> 16) & 0xFF));
+
+        outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, cmd28);
+    }
+
+    ata_delay_400ns();
 }
 
-void ata_read_sector(uint32_t lba, uint8_t *buffer)
+static int ata_check_range(uint32_t lba, uint32_t count)
 {
+    if (count == 0 || count > ATA_MAX_SECTORS)
+        return 0;
+
+    if (ata_needs_lba48(lba, count) && info.present && !info.lba48)
+        return 0;
 
-    ata_wait_bsy();
+    return 1;
+}
+
+/* ---------------- Bus master DMA ---------------- */
+
+static void ata_dma_init(const uint16_t *ident)
+{
+    bm_base = 0;
 
-    outb(ATA_PRIMARY_IO + ATA_REG_HDDEVSEL, 0xE0 | ((lba >> 24) & 0x0F));
-    outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT0, 1);
+    // Word 49 bit 8: DMA supported.
+    if (!(ident[49] & (1 << 8)))
+        return;
 
-    outb(ATA_PRIMARY_IO + ATA_REG_LBA0, (uint8_t)(lba & 0xFF));
-    outb(ATA_PRIMARY_IO + ATA_REG_LBA1, (uint8_t)((lba >> 8) & 0xFF));
-    outb(ATA_PRIMARY_IO + ATA_REG_LBA2, (uint8_t)((lba >> 16) & 0xFF));
+    pci_device_t dev;
+    if (!pci_find_class(0x01, 0x01, &dev))
+        return;
 
-    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_READ_PIO);
+    // Prog-if bit 7: controller supports bus mastering.
+    uint8_t prog_if = (uint8_t)(pci_config_read32(dev, PCI_REG_CLASS) >> 8);
+    if (!(prog_if & 0x80))
+        return;
 
-    ata_wait_bsy();
-    ata_wait_drq();
+    uint32_t bar4 = pci_config_read32(dev, PCI_REG_BAR4);
+    if (!(bar4 & 1))
+        return; // expected an I/O space BAR
 
-    for (int i = 0; i < 256; i++)
+    uint16_t cmd = pci_config_read16(dev, PCI_REG_COMMAND);
+    pci_config_write16(dev, PCI_REG_COMMAND, cmd | PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+
+    bm_base = (uint16_t)(bar4 & 0xFFFC);
+
+    outb(bm_base + BM_REG_COMMAND, 0);
+    outb(bm_base + BM_REG_STATUS, BM_STATUS_IRQ | BM_STATUS_ERR);
+}
+
+// Describe the segment list as PRD entries, splitting each buffer on
+// 64 KB boundaries. Kernel memory is identity-mapped; user buffers are
+// translated page by page, since their frames needn't be contiguous.
+static int ata_dma_build_prd(const ata_sg_t *sg, int nsg)
+{
+    int n = 0;
+
+    for (int i = 0; i < nsg; i++)
     {
-        uint16_t data = inw(ATA_PRIMARY_IO + ATA_REG_DATA);
-        buffer[i * 2] = (uint8_t)(data & 0xFF);
-        buffer[i * 2 + 1] = (uint8_t)((data >> 8) & 0xFF);
+        uint32_t addr = (uint32_t)sg[i].buffer;
+        uint32_t bytes = sg[i].count * ATA_SECTOR_SIZE;
+
+        // PRD buffers must be word aligned.
+        if (addr & 1)
+            return 0;
+
+        while (bytes > 0)
+        {
+            if (n == PRD_MAX_ENTRIES)
+                return 0;
+
+            uint32_t phys = vmm_virt_to_phys(addr);
+            if (!phys)
+                return 0;
+
+            uint32_t chunk = 0x10000 - (phys & 0xFFFF);
+            if (addr >= LAYOUT_USER_BASE && chunk > PAGE_SIZE - (addr & (PAGE_SIZE - 1)))
+                chunk = PAGE_SIZE - (addr & (PAGE_SIZE - 1));
+            if (chunk > bytes)
+                chunk = bytes;
+
+            prd_table[n].phys_addr = phys;
+            prd_table[n].byte_count = (uint16_t)(chunk & 0xFFFF);
+            prd_table[n].flags = 0;
+
+            addr += chunk;
+            bytes -= chunk;
+            n++;
+        }
     }
+
+    prd_table[n - 1].flags = PRD_EOT;
+    return 1;
+}
+
+// Returns 1 on success, 0 on a device error, -1 when DMA can't be used
+// for this request (caller falls back to PIO).
+static int ata_dma_transfer(uint32_t lba, uint32_t count, const ata_sg_t *sg, int nsg, int write)
+{
+    if (!bm_base)
+        return -1;
+
+    if (!ata_dma_build_prd(sg, nsg))
+        return -1;
+
+    outb(bm_base + BM_REG_COMMAND, 0);
+    outl(bm_base + BM_REG_PRDT, (uint32_t)prd_table);
+    outb(bm_base + BM_REG_STATUS, BM_STATUS_IRQ | BM_STATUS_ERR);
+    outb(bm_base + BM_REG_COMMAND, write ? 0 : BM_CMD_READ);
+
+    irq_fired = 0;
+
+    if (write)
+        ata_issue(lba, count, ATA_CMD_WRITE_DMA, ATA_CMD_WRITE_DMA_EXT);
+    else
+        ata_issue(lba, count, ATA_CMD_READ_DMA, ATA_CMD_READ_DMA_EXT);
+
+    outb(bm_base + BM_REG_COMMAND, (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+
+    uint8_t bm_status = ata_dma_wait();
+
+    outb(bm_base + BM_REG_COMMAND, 0);
+    outb(bm_base + BM_REG_STATUS, BM_STATUS_IRQ | BM_STATUS_ERR);
+
+    ata_wait_ready();
+    uint8_t status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+
+    if ((bm_status & BM_STATUS_ERR) || (status & (ATA_STATUS_ERR | ATA_STATUS_DF)))
+        return 0;
+
+    return 1;
+}
+
+// A failed DMA command drops the driver back to PIO for good; the caller
+// retries the same request over PIO.
+static void ata_dma_disable()
+{
+    bm_base = 0;
+    info.dma = 0;
+}
+
+/* ------------------- Public API ------------------- */
+
+void ata_init()
+{
+    info.present = 0;
+    info.lba48 = 0;
+    info.dma = 0;
+    info.sectors = 0;
+
+    irq_register_handler(ATA_IRQ, ata_irq_handler);
+
+    outb(ATA_PRIMARY_IO + ATA_REG_HDDEVSEL, 0xA0);
+    ata_delay_400ns();
+
+    outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT0, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA0, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA1, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA2, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    ata_delay_400ns();
+
+    // Status 0 means no drive on the channel; 0xFF is a floating bus.
+    uint8_t status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+    if (status == 0 || status == 0xFF)
+        return;
+
+    ata_wait_ready();
+
+    // Non-zero LBA1/LBA2 signature means ATAPI/SATA, not a PATA disk.
+    if (inb(ATA_PRIMARY_IO + ATA_REG_LBA1) != 0 || inb(ATA_PRIMARY_IO + ATA_REG_LBA2) != 0)
+        return;
+
+    if (!ata_wait_drq())
+        return;
+
+    uint16_t ident[256];
+    insw(ATA_PRIMARY_IO + ATA_REG_DATA, ident, 256);
+
+    info.present = 1;
+    info.lba48 = (ident[83] & (1 << 10)) ? 1 : 0;
+
+    if (!info.lba48)
+        info.sectors = (uint32_t)ident[60] | ((uint32_t)ident[61] << 16);
+    else if (ident[102] != 0 || ident[103] != 0)
+        info.sectors = 0xFFFFFFFFu; // clamp to what a 32-bit LBA can address
+    else
+        info.sectors = (uint32_t)ident[100] | ((uint32_t)ident[101] << 16);
+
+    ata_dma_init(ident);
+    info.dma = bm_base ? 1 : 0;
+}
+
+ata_info_t ata_get_info()
+{
+    return info;
 }
 
-void ata_write_sector(uint32_t lba, uint8_t *buffer) {
+int ata_transfer_sg(uint32_t lba, const ata_sg_t *sg, int nsg, int write)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < nsg; i++)
+        count += sg[i].count;
+
+    if (nsg <= 0 || !ata_check_range(lba, count))
+        return 0;
 
-    // Wait until not busy
-    while (inb(0x1F7) & 0x80);
+    int dma = ata_dma_transfer(lba, count, sg, nsg, write);
+    if (dma == 1)
+        return 1;
+    if (dma == 0)
+        ata_dma_disable();
 
-    outb(0x1F6, 0xE0 | ((lba >> 24) & 0x0F));
-    outb(0x1F2, 1);                 // sector count
-    outb(0x1F3, (uint8_t)(lba));     // LBA low
-    outb(0x1F4, (uint8_t)(lba >> 8));// LBA mid
-    outb(0x1F5, (uint8_t)(lba >> 16));// LBA high
-    outb(0x1F7, 0x30);              // WRITE SECTORS command
+    if (write)
+        ata_issue(lba, count, ATA_CMD_WRITE_PIO, ATA_CMD_WRITE_PIO_EXT);
+    else
+        ata_issue(lba, count, ATA_CMD_READ_PIO, ATA_CMD_READ_PIO_EXT);
 
-    // Wait until drive is ready
-    while (!(inb(0x1F7) & 0x08));
+    // One command, one DRQ data block per sector; step to the next
+    // segment's buffer once the current one is used up.
+    for (int i = 0; i < nsg; i++)
+    {
+        for (uint32_t s = 0; s < sg[i].count; s++)
+        {
+            if (!ata_wait_drq())
+                return 0;
 
-    // Write 256 words (512 bytes)
-    for (int i = 0; i < 256; i++) {
-        uint16_t word = buffer[i * 2] | (buffer[i * 2 + 1] << 8);
-        outw(0x1F0, word);
+            uint8_t *p = sg[i].buffer + s * ATA_SECTOR_SIZE;
+            if (write)
+                outsw(ATA_PRIMARY_IO + ATA_REG_DATA, p, ATA_SECTOR_SIZE / 2);
+            else
+                insw(ATA_PRIMARY_IO + ATA_REG_DATA, p, ATA_SECTOR_SIZE / 2);
+        }
     }
 
-    // Flush cache
-    outb(0x1F7, 0xE7);
+    if (!write)
+        return 1;
+
+    // The drive signals completion once the last sector is in its cache;
+    // getting it onto the platters is ata_flush()'s job.
+    return (ata_wait_ready() & (ATA_STATUS_ERR | ATA_STATUS_DF)) ? 0 : 1;
+}
+
+int ata_flush()
+{
+    if (!info.present)
+        return 1;
 
-    // Wait for completion
-    while (inb(0x1F7) & 0x80);
+    ata_wait_ready();
+
+    outb(ATA_PRIMARY_IO + ATA_REG_HDDEVSEL, 0xE0);
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, info.lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH);
+    ata_delay_400ns();
+
+    return (ata_wait_ready() & (ATA_STATUS_ERR | ATA_STATUS_DF)) ? 0 : 1;
+}
+
+int ata_read_sectors(uint32_t lba, uint32_t count, uint8_t *buffer)
+{
+    ata_sg_t sg = {buffer, count};
+    return ata_transfer_sg(lba, &sg, 1, 0);
+}
+
+int ata_write_sectors(uint32_t lba, uint32_t count, const uint8_t *buffer)
+{
+    ata_sg_t sg = {(uint8_t *)buffer, count};
+    return ata_transfer_sg(lba, &sg, 1, 1);
+}
+
+void ata_read_sector(uint32_t lba, uint8_t *buffer)
+{
+    ata_read_sectors(lba, 1, buffer);
+}
+
+void ata_write_sector(uint32_t lba, uint8_t *buffer)
+{
+    ata_write_sectors(lba, 1, buffer);
 }
@@ -0,0 +1,308 @@
+#include "drivers/blk.h"
+#include "drivers/ata.h"
+
+// Pending requests, sorted by LBA. Queued requests never overlap: a
+// submission that overlaps one runs the queue first, so sorting can't
+// reorder a read around a write to the same sector.
+static blk_request_t *queue = 0;
+
+// Elevator position: the sector after the last one dispatched.
+static uint32_t head_pos = 0;
+
+static int plug_depth = 0;
+static int running = 0;
+
+static blk_request_t pool[BLK_POOL_SIZE];
+static blk_request_t *pool_free = 0;
+
+// Set when a pooled write fails; nobody waits on those requests, so the
+// error is reported by the next outermost blk_unplug() instead.
+static int write_error = 0;
+
+static blk_stats_t stats;
+
+/* -------------------- Helpers -------------------- */
+
+static int blk_overlaps(const blk_request_t *a, const blk_request_t *b)
+{
+    return a->lba < b->lba + b->count && b->lba < a->lba + a->count;
+}
+
+static void blk_complete(blk_request_t *req, int ok)
+{
+    req->status = ok ? BLK_OK : BLK_ERROR;
+
+    if (!ok)
+    {
+        stats.errors++;
+
+        if (req->pooled)
+            write_error = 1;
+    }
+
+    if (req->done)
+        req->done(req);
+
+    if (req->pooled)
+    {
+        req->next = pool_free;
+        pool_free = req;
+    }
+}
+
+// A request larger than one command is issued on its own, in chunks.
+static void blk_dispatch_large(blk_request_t *req)
+{
+    uint32_t lba = req->lba;
+    uint32_t left = req->count;
+    uint8_t *buf = req->buffer;
+    int ok = 1;
+
+    while (left > 0 && ok)
+    {
+        uint32_t n = (left > ATA_MAX_SECTORS) ? ATA_MAX_SECTORS : left;
+        ata_sg_t sg = {buf, n};
+
+        ok = ata_transfer_sg(lba, &sg, 1, req->write);
+        stats.commands++;
+
+        lba += n;
+        buf += n * ATA_SECTOR_SIZE;
+        left -= n;
+    }
+
+    head_pos = req->lba + req->count;
+    blk_complete(req, ok);
+}
+
+// Unlink the request at `*link` plus every following request that
+// continues it on disk, and issue them as one scatter-gather command.
+static void blk_dispatch(blk_request_t **link)
+{
+    blk_request_t *first = *link;
+
+    if (first->count > ATA_MAX_SECTORS)
+    {
+        *link = first->next;
+        blk_dispatch_large(first);
+        return;
+    }
+
+    blk_request_t *batch[BLK_MAX_SEGMENTS];
+    ata_sg_t sg[BLK_MAX_SEGMENTS];
+    int n = 0;
+    uint32_t total = 0;
+    uint32_t end = first->lba;
+
+    blk_request_t *r = first;
+
+    while (r && n < BLK_MAX_SEGMENTS && r->write == first->write &&
+           r->lba == end && total + r->count <= ATA_MAX_SECTORS)
+    {
+        batch[n] = r;
+        sg[n].buffer = r->buffer;
+        sg[n].count = r->count;
+
+        n++;
+        total += r->count;
+        end += r->count;
+        r = r->next;
+    }
+
+    *link = r;
+
+    int ok = ata_transfer_sg(first->lba, sg, n, first->write);
+    stats.commands++;
+    stats.merges += n - 1;
+
+    head_pos = end;
+
+    for (int i = 0; i < n; i++)
+        blk_complete(batch[i], ok);
+}
+
+// Report and clear a pooled write failure. Returns 1 if none happened.
+static int blk_take_write_status()
+{
+    int ok = !write_error;
+    write_error = 0;
+    return ok;
+}
+
+/* ------------------- Public API ------------------- */
+
+void blk_init()
+{
+    queue = 0;
+    head_pos = 0;
+    plug_depth = 0;
+    running = 0;
+    write_error = 0;
+
+    pool_free = 0;
+    for (int i = 0; i < BLK_POOL_SIZE; i++)
+    {
+        pool[i].pooled = 1;
+        pool[i].next = pool_free;
+        pool_free = &pool[i];
+    }
+
+    stats.requests = 0;
+    stats.merges = 0;
+    stats.commands = 0;
+    stats.errors = 0;
+}
+
+void blk_request_init(blk_request_t *req, uint32_t lba, uint32_t count,
+                      uint8_t *buffer, int write,
+                      void (*done)(blk_request_t *req), void *ctx)
+{
+    req->lba = lba;
+    req->count = count;
+    req->buffer = buffer;
+    req->write = write ? 1 : 0;
+    req->pooled = 0;
+    req->status = BLK_PENDING;
+    req->done = done;
+    req->ctx = ctx;
+    req->next = 0;
+}
+
+void blk_submit(blk_request_t *req)
+{
+    stats.requests++;
+    req->status = BLK_PENDING;
+    req->next = 0;
+
+    if (req->count == 0)
+    {
+        blk_complete(req, 1);
+        return;
+    }
+
+    for (blk_request_t *q = queue; q; q = q->next)
+    {
+        if (blk_overlaps(q, req))
+        {
+            blk_run_queue();
+            break;
+        }
+    }
+
+    // Insertion sort; equal LBAs keep submission order.
+    blk_request_t **link = &queue;
+    while (*link && (*link)->lba <= req->lba)
+        link = &(*link)->next;
+
+    req->next = *link;
+    *link = req;
+
+    if (plug_depth == 0)
+        blk_run_queue();
+}
+
+int blk_submit_write(uint32_t lba, uint32_t count, const uint8_t *buffer)
+{
+    if (!pool_free)
+        blk_run_queue();
+
+    // From a completion callback the queue is already running and can't
+    // be drained to free a request.
+    if (!pool_free)
+    {
+        stats.errors++;
+        return 0;
+    }
+
+    blk_request_t *req = pool_free;
+    pool_free = req->next;
+
+    blk_request_init(req, lba, count, (uint8_t *)buffer, 1, 0, 0);
+    req->pooled = 1;
+
+    blk_submit(req);
+
+    // Unplugged, the write has run by now; otherwise blk_unplug() reports it.
+    if (plug_depth > 0 || running)
+        return 1;
+
+    return blk_take_write_status();
+}
+
+void blk_plug()
+{
+    plug_depth++;
+}
+
+int blk_unplug()
+{
+    if (plug_depth > 0)
+        plug_depth--;
+
+    // Inner plugs leave the error for the outermost one to collect.
+    if (plug_depth > 0)
+        return !write_error;
+
+    blk_run_queue();
+    return blk_take_write_status();
+}
+
+void blk_run_queue()
+{
+    // Completion callbacks may submit more work; the outer loop picks it up.
+    if (running)
+        return;
+
+    running = 1;
+
+    while (queue)
+    {
+        // C-LOOK: continue upward from the head position, then wrap
+        // around to the lowest pending LBA.
+        blk_request_t **link = &queue;
+        while (*link && (*link)->lba < head_pos)
+            link = &(*link)->next;
+
+        if (!*link)
+            link = &queue;
+
+        blk_dispatch(link);
+    }
+
+    running = 0;
+}
+
+int blk_flush()
+{
+    blk_run_queue();
+    return ata_flush();
+}
+
+// The synchronous helpers must not be used from a completion callback:
+// the queue is already running there and the request would stay pending.
+int blk_read(uint32_t lba, uint32_t count, uint8_t *buffer)
+{
+    blk_request_t req;
+    blk_request_init(&req, lba, count, buffer, 0, 0, 0);
+
+    blk_submit(&req);
+    blk_run_queue();
+
+    return req.status == BLK_OK;
+}
+
+int blk_write(uint32_t lba, uint32_t count, const uint8_t *buffer)
+{
+    blk_request_t req;
+    blk_request_init(&req, lba, count, (uint8_t *)buffer, 1, 0, 0);
+
+    blk_submit(&req);
+    blk_run_queue();
+
+    return req.status == BLK_OK;
+}
+
+blk_stats_t blk_get_stats()
+{
+    return stats;
+}
@@ -0,0 +1,80 @@
+#include "drivers/pci.h"
+#include "drivers/ports.h"
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+
+static uint32_t pci_address(pci_device_t dev, uint8_t offset)
+{
+    return 0x80000000u |
+           ((uint32_t)dev.bus << 16) |
+           ((uint32_t)(dev.slot & 0x1F) << 11) |
+           ((uint32_t)(dev.func & 0x07) << 8) |
+           (offset & 0xFC);
+}
+
+uint32_t pci_config_read32(pci_device_t dev, uint8_t offset)
+{
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+void pci_config_write32(pci_device_t dev, uint8_t offset, uint32_t value)
+{
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+uint16_t pci_config_read16(pci_device_t dev, uint8_t offset)
+{
+    uint32_t v = pci_config_read32(dev, offset);
+    return (uint16_t)(v >> ((offset & 2) * 8));
+}
+
+void pci_config_write16(pci_device_t dev, uint8_t offset, uint16_t value)
+{
+    uint32_t v = pci_config_read32(dev, offset);
+    uint32_t shift = (offset & 2) * 8;
+
+    v &= ~(0xFFFFu << shift);
+    v |= (uint32_t)value << shift;
+
+    pci_config_write32(dev, offset, v);
+}
+
+int pci_find_class(uint8_t class_code, uint8_t subclass, pci_device_t *out)
+{
+    for (uint32_t bus = 0; bus < 256; bus++)
+    {
+        for (uint8_t slot = 0; slot < 32; slot++)
+        {
+            pci_device_t dev = {(uint8_t)bus, slot, 0};
+
+            if (pci_config_read16(dev, PCI_REG_VENDOR_ID) == 0xFFFF)
+                continue;
+
+            // Only probe functions 1..7 on multi-function devices.
+            uint8_t header = (uint8_t)(pci_config_read32(dev, PCI_REG_HEADER_TYPE) >> 16);
+            uint8_t funcs = (header & 0x80) ? 8 : 1;
+
+            for (uint8_t func = 0; func < funcs; func++)
+            {
+                dev.func = func;
+
+                if (pci_config_read16(dev, PCI_REG_VENDOR_ID) == 0xFFFF)
+                    continue;
+
+                uint32_t class_reg = pci_config_read32(dev, PCI_REG_CLASS);
+
+                if ((uint8_t)(class_reg >> 24) == class_code &&
+                    (uint8_t)(class_reg >> 16) == subclass)
+                {
+                    *out = dev;
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
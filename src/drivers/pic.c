@@ -44,3 +44,10 @@ void pic_clear_mask(unsigned char irq_line) {
     value = inb(port) & ~(1 << irq_line);
     outb(port, value);
 }
+
+unsigned short pic_get_isr() {
+    // OCW3: next read of the command port returns the ISR.
+    outb(PIC1_COMMAND, 0x0B);
+    outb(PIC2_COMMAND, 0x0B);
+    return (unsigned short)((inb(PIC2_COMMAND) << 8) | inb(PIC1_COMMAND));
+}
@@ -19,3 +19,21 @@ uint16_t inw(uint16_t port) {
 void outw(uint16_t port, uint16_t data) {
     __asm__ __volatile__("outw %0, %1" : : "a"(data), "Nd"(port));
 }
+
+uint32_t inl(uint16_t port) {
+    uint32_t result;
+    __asm__ __volatile__("inl %1, %0" : "=a"(result) : "Nd"(port));
+    return result;
+}
+
+void outl(uint16_t port, uint32_t data) {
+    __asm__ __volatile__("outl %0, %1" : : "a"(data), "Nd"(port));
+}
+
+void insw(uint16_t port, void *buffer, uint32_t count) {
+    __asm__ __volatile__("rep insw" : "+D"(buffer), "+c"(count) : "d"(port) : "memory");
+}
+
+void outsw(uint16_t port, const void *buffer, uint32_t count) {
+    __asm__ __volatile__("rep outsw" : "+S"(buffer), "+c"(count) : "d"(port) : "memory");
+}
@@ -0,0 +1,408 @@
+#include "fs/bcache.h"
+#include "drivers/blk.h"
+
+typedef struct bcache_buf
+{
+    uint32_t lba;
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t busy; // writeback or readahead queued in the block layer
+
+    blk_request_t req;
+
+    struct bcache_buf *hash_next;
+    struct bcache_buf *lru_prev;
+    struct bcache_buf *lru_next;
+
+    uint8_t data[BCACHE_SECTOR_SIZE];
+} bcache_buf_t;
+
+static bcache_buf_t buffers[BCACHE_NUM_BUFFERS];
+static bcache_buf_t *hash_table[BCACHE_HASH_BUCKETS];
+
+// LRU list: head = most recently used, tail = eviction candidate.
+static bcache_buf_t *lru_head = 0;
+static bcache_buf_t *lru_tail = 0;
+
+static bcache_stats_t stats;
+
+// Set when a dirty sector had to be dropped without reaching the disk;
+// reported by the next bcache_sync().
+static int write_error = 0;
+
+/* -------------------- Helpers -------------------- */
+
+static uint32_t bcache_hash(uint32_t lba)
+{
+    return (lba ^ (lba >> 6)) % BCACHE_HASH_BUCKETS;
+}
+
+static void bcache_copy(uint8_t *dst, const uint8_t *src)
+{
+    for (int i = 0; i < BCACHE_SECTOR_SIZE; i++)
+        dst[i] = src[i];
+}
+
+static void lru_unlink(bcache_buf_t *b)
+{
+    if (b->lru_prev)
+        b->lru_prev->lru_next = b->lru_next;
+    else
+        lru_head = b->lru_next;
+
+    if (b->lru_next)
+        b->lru_next->lru_prev = b->lru_prev;
+    else
+        lru_tail = b->lru_prev;
+
+    b->lru_prev = 0;
+    b->lru_next = 0;
+}
+
+static void lru_push_front(bcache_buf_t *b)
+{
+    b->lru_prev = 0;
+    b->lru_next = lru_head;
+
+    if (lru_head)
+        lru_head->lru_prev = b;
+    lru_head = b;
+
+    if (!lru_tail)
+        lru_tail = b;
+}
+
+static void hash_remove(bcache_buf_t *b)
+{
+    bcache_buf_t **link = &hash_table[bcache_hash(b->lba)];
+
+    while (*link)
+    {
+        if (*link == b)
+        {
+            *link = b->hash_next;
+            break;
+        }
+        link = &(*link)->hash_next;
+    }
+
+    b->hash_next = 0;
+}
+
+static void hash_insert(bcache_buf_t *b)
+{
+    uint32_t h = bcache_hash(b->lba);
+    b->hash_next = hash_table[h];
+    hash_table[h] = b;
+}
+
+static bcache_buf_t *bcache_lookup(uint32_t lba)
+{
+    bcache_buf_t *b = hash_table[bcache_hash(lba)];
+
+    while (b)
+    {
+        if (b->valid && b->lba == lba)
+            return b;
+        b = b->hash_next;
+    }
+
+    return 0;
+}
+
+// Returns 0 if the write failed; the buffer then stays dirty.
+static int bcache_writeback(bcache_buf_t *b)
+{
+    if (!b->valid || !b->dirty)
+        return 1;
+
+    if (!blk_write(b->lba, 1, b->data))
+        return 0;
+
+    b->dirty = 0;
+    stats.writebacks++;
+    stats.dirty--;
+    return 1;
+}
+
+static void bcache_writeback_done(blk_request_t *req)
+{
+    bcache_buf_t *b = (bcache_buf_t *)req->ctx;
+
+    b->busy = 0;
+
+    if (req->status == BLK_OK)
+    {
+        b->dirty = 0;
+        stats.writebacks++;
+        stats.dirty--;
+    }
+}
+
+// Queue a dirty buffer's writeback without waiting for it, so a batch of
+// neighbouring sectors goes out as one command.
+static void bcache_queue_writeback(bcache_buf_t *b)
+{
+    if (!b->valid || !b->dirty || b->busy)
+        return;
+
+    b->busy = 1;
+    blk_request_init(&b->req, b->lba, 1, b->data, 1, bcache_writeback_done, b);
+    blk_submit(&b->req);
+}
+
+static void bcache_prefetch_done(blk_request_t *req)
+{
+    bcache_buf_t *b = (bcache_buf_t *)req->ctx;
+
+    b->busy = 0;
+
+    // A failed readahead must not leave stale data behind a valid entry;
+    // the next bcache_get() reads the sector again and sees the error.
+    if (req->status != BLK_OK)
+    {
+        hash_remove(b);
+        b->valid = 0;
+    }
+}
+
+// A buffer with queued I/O can't be used until the queue has run.
+static void bcache_settle(bcache_buf_t *b)
+{
+    if (b->busy)
+        blk_run_queue();
+}
+
+// Find the buffer for `lba`, recycling the LRU buffer on a miss.
+// When `fill` is set a miss reads the sector from disk.
+static bcache_buf_t *bcache_get(uint32_t lba, int fill)
+{
+    bcache_buf_t *b = bcache_lookup(lba);
+
+    if (b)
+        bcache_settle(b);
+
+    // A failed readahead drops the buffer while we wait for it.
+    if (b && b->valid)
+    {
+        stats.hits++;
+        lru_unlink(b);
+        lru_push_front(b);
+        return b;
+    }
+
+    stats.misses++;
+
+    // Recycle the least recently used buffer that is clean or can be
+    // written back; one whose writeback fails stays cached and dirty.
+    for (b = lru_tail; b; b = b->lru_prev)
+    {
+        bcache_settle(b);
+
+        if (bcache_writeback(b))
+            break;
+    }
+
+    // Nothing could be written back: drop the oldest sector and report
+    // the loss.
+    if (!b)
+    {
+        b = lru_tail;
+        b->dirty = 0;
+        stats.dirty--;
+        write_error = 1;
+    }
+
+    if (b->valid)
+    {
+        hash_remove(b);
+        stats.evictions++;
+    }
+
+    b->lba = lba;
+    b->valid = 1;
+    b->dirty = 0;
+
+    if (fill)
+        blk_read(lba, 1, b->data);
+
+    hash_insert(b);
+    lru_unlink(b);
+    lru_push_front(b);
+
+    return b;
+}
+
+/* ------------------- Public API ------------------- */
+
+void bcache_init()
+{
+    lru_head = 0;
+    lru_tail = 0;
+
+    for (int i = 0; i < BCACHE_HASH_BUCKETS; i++)
+        hash_table[i] = 0;
+
+    for (int i = 0; i < BCACHE_NUM_BUFFERS; i++)
+    {
+        buffers[i].lba = 0;
+        buffers[i].valid = 0;
+        buffers[i].dirty = 0;
+        buffers[i].busy = 0;
+        buffers[i].hash_next = 0;
+        lru_push_front(&buffers[i]);
+    }
+
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.writebacks = 0;
+    stats.evictions = 0;
+    stats.dirty = 0;
+    stats.readahead = 0;
+
+    write_error = 0;
+}
+
+void bcache_read(uint32_t lba, uint8_t *buffer)
+{
+    bcache_buf_t *b = bcache_get(lba, 1);
+    bcache_copy(buffer, b->data);
+}
+
+void bcache_write(uint32_t lba, const uint8_t *buffer)
+{
+    // Whole-sector overwrite: no need to fetch the old contents on a miss.
+    bcache_buf_t *b = bcache_get(lba, 0);
+    bcache_copy(b->data, buffer);
+
+    if (!b->dirty)
+    {
+        b->dirty = 1;
+        stats.dirty++;
+    }
+}
+
+void bcache_read_range(uint32_t lba, uint32_t count, uint8_t *buffer)
+{
+    uint32_t cached = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (bcache_lookup(lba + i))
+            cached++;
+    }
+
+    if (cached == count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            bcache_read(lba + i, buffer + i * BCACHE_SECTOR_SIZE);
+        return;
+    }
+
+    // The disk copy must be current before we read around the cache.
+    blk_plug();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        bcache_buf_t *b = bcache_lookup(lba + i);
+        if (b)
+            bcache_queue_writeback(b);
+    }
+    blk_unplug();
+
+    stats.misses += count - cached;
+    stats.hits += cached;
+
+    blk_read(lba, count, buffer);
+}
+
+int bcache_write_range(uint32_t lba, uint32_t count, const uint8_t *buffer)
+{
+    // Keep cached copies coherent; the data goes to disk right away so
+    // they are clean afterwards.
+    for (uint32_t i = 0; i < count; i++)
+    {
+        bcache_buf_t *b = bcache_lookup(lba + i);
+        if (!b)
+            continue;
+
+        bcache_settle(b);
+        bcache_copy(b->data, buffer + i * BCACHE_SECTOR_SIZE);
+        if (b->dirty)
+        {
+            b->dirty = 0;
+            stats.dirty--;
+        }
+    }
+
+    return blk_submit_write(lba, count, buffer);
+}
+
+void bcache_prefetch(uint32_t lba, uint32_t count)
+{
+    if (count > BCACHE_READAHEAD_MAX)
+        count = BCACHE_READAHEAD_MAX;
+
+    // One request per missing sector; the elevator merges the neighbours
+    // into scatter-gather commands when the plug comes off.
+    blk_plug();
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (bcache_lookup(lba + i))
+            continue;
+
+        // Readahead is only a hint: never write back or wait for a
+        // buffer to make room for it.
+        bcache_buf_t *b = lru_tail;
+        if (b->busy || b->dirty)
+            break;
+
+        if (b->valid)
+        {
+            hash_remove(b);
+            stats.evictions++;
+        }
+
+        b->lba = lba + i;
+        b->valid = 1;
+        b->dirty = 0;
+        b->busy = 1;
+
+        blk_request_init(&b->req, b->lba, 1, b->data, 0, bcache_prefetch_done, b);
+
+        hash_insert(b);
+        lru_unlink(b);
+        lru_push_front(b);
+
+        stats.readahead++;
+        blk_submit(&b->req);
+    }
+    blk_unplug();
+}
+
+int bcache_sync()
+{
+    // Queue every dirty sector, then let the elevator merge neighbours.
+    blk_plug();
+    for (int i = 0; i < BCACHE_NUM_BUFFERS; i++)
+        bcache_queue_writeback(&buffers[i]);
+    blk_unplug();
+
+    blk_run_queue();
+
+    // Failed writebacks leave their buffers dirty.
+    int ok = !write_error;
+    write_error = 0;
+
+    for (int i = 0; i < BCACHE_NUM_BUFFERS; i++)
+    {
+        if (buffers[i].valid && buffers[i].dirty)
+            ok = 0;
+    }
+
+    return ok;
+}
+
+bcache_stats_t bcache_get_stats()
+{
+    return stats;
+}
@@ -1,586 +1,1912 @@
 #include "fs/fat16.h"
-#include "drivers/ata.h"
+#include "fs/bcache.h"
+#include "drivers/blk.h"
 #include "vga.h"
 #include "kernel/print.h"
 #include "string.h"
 #include "memory/kmalloc.h"
 
-static fat16_bpb_t bpb;
-
-static uint16_t current_dir_cluster = 0; // 0 = root
-static char current_path[128] = "/";
-
-static int fat16_read_file(const char *path, uint8_t *out_buf, uint32_t max_size, uint32_t *out_size);
+// The mounted volume: parsed once by fat16_mount(), re-read only by
+// fat16_remount().
+static fat16_volume_t vol;
+
+static int durability = FAT16_DURABILITY_FLUSH;
+
+// Staging buffer size for fat16_cp.
+#define FAT16_CP_CHUNK (32 * 1024)
+
+// Readahead window for sequential reads, in sectors. It starts small and
+// doubles while the reader keeps streaming.
+#define FAT16_RA_MIN 8
+#define FAT16_RA_MAX BCACHE_READAHEAD_MAX
+
+// In-memory copy of the first FAT, loaded once at mount. Updates only touch
+// RAM and mark the FAT sector dirty; fat16_flush_fat() writes dirty sectors
+// to every FAT copy. When the table is larger than FAT_RAM_MAX (big FAT32
+// volumes) or can't be allocated, the FAT is accessed through the sector
+// cache instead.
+#define FAT_RAM_MAX (512 * 1024)
+
+static uint8_t *fat_table = 0;  // raw FAT #1, 2 or 4 bytes per entry
+static uint8_t *fat_dirty = 0;  // one flag per FAT sector
+static uint32_t *free_map = 0;  // bit set = cluster free
+static uint32_t fat_entries = 0; // entries held in fat_table
+static uint32_t fat_limit = 0;   // one past the highest data cluster
+static uint32_t free_hint = 2;
+
+// Free cluster count; without the in-memory FAT it comes from FSInfo and
+// may be unknown until counted.
+static uint32_t free_count = 0;
+static uint8_t free_known = 0;
+
+// FSInfo values last read from or written to disk (FAT32).
+static uint32_t fsinfo_free = 0xFFFFFFFF;
+static uint32_t fsinfo_next = 0xFFFFFFFF;
+
+static int fat16_file_write_nocommit(fat16_file_t *file, uint32_t offset, const uint8_t *data,
+                                     uint32_t len, uint32_t *out_written);
 static int fat16_get_file_size_internal(const char *path, uint32_t *out_size);
 static int fat16_is_directory(const char *path);
 
 /* -------------------- Helpers -------------------- */
-static void fat16_copy_entry(fat16_dir_entry_t *dst, fat16_dir_entry_t *src)
+static void fat16_flush_fat();
+static void fat16_flush_open_files();
+
+// End-of-operation sync point; how far the data gets depends on the
+// durability mode.
+static void fat16_commit()
 {
-    for (int i = 0; i < 32; i++)
-        ((uint8_t *)dst)[i] = ((uint8_t *)src)[i];
+    if (durability == FAT16_DURABILITY_LAZY)
+        return;
+
+    fat16_flush_fat();
+    bcache_sync();
+
+    if (durability == FAT16_DURABILITY_FLUSH)
+        blk_flush();
 }
 
 
 static uint32_t fat16_root_start_sector()
 {
-    return bpb.reserved_sectors + (bpb.num_fats * bpb.sectors_per_fat);
+    return vol.root_start;
 }
 
 static uint32_t fat16_root_dir_sectors()
 {
-    return (bpb.root_entries * 32 + (bpb.bytes_per_sector - 1)) / bpb.bytes_per_sector;
+    return vol.root_sectors;
 }
 
-static uint32_t fat16_first_data_sector()
+static uint32_t fat16_cluster_to_sector(uint32_t cluster)
 {
-    return fat16_root_start_sector() + fat16_root_dir_sectors();
+    return vol.data_start + (cluster - 2) * vol.bpb.sectors_per_cluster;
 }
 
-static uint32_t fat16_cluster_to_sector(uint16_t cluster)
+static uint32_t fat16_total_clusters()
 {
-    return fat16_first_data_sector() + (cluster - 2) * bpb.sectors_per_cluster;
+    return vol.total_clusters;
 }
 
-static uint16_t fat16_get_fat_entry(uint16_t cluster)
+// The directory entry's first cluster; the high word only exists on FAT32.
+static uint32_t fat16_entry_cluster(const fat16_dir_entry_t *entry)
 {
-    uint32_t fat_start = bpb.reserved_sectors;
-    uint32_t fat_offset = cluster * 2;
-
-    uint32_t sector_num = fat_start + (fat_offset / 512);
-    uint32_t offset = fat_offset % 512;
+    uint32_t cluster = entry->first_cluster_low;
 
-    uint8_t sector[512];
-    ata_read_sector(sector_num, sector);
+    if (vol.fat_bits == 32)
+        cluster |= (uint32_t)entry->first_cluster_high << 16;
 
-    return *(uint16_t *)&sector[offset];
+    return cluster;
 }
 
-static void fat16_set_fat_entry(uint16_t cluster, uint16_t value)
+static void fat16_entry_set_cluster(fat16_dir_entry_t *entry, uint32_t cluster)
 {
-    uint32_t fat_start = bpb.reserved_sectors;
-    uint32_t fat_offset = cluster * 2;
+    entry->first_cluster_low = (uint16_t)cluster;
 
-    uint32_t sector_num = fat_start + (fat_offset / 512);
-    uint32_t offset = fat_offset % 512;
+    if (vol.fat_bits == 32)
+        entry->first_cluster_high = (uint16_t)(cluster >> 16);
+}
 
-    uint8_t sector[512];
+/* -------------------- FAT cache -------------------- */
 
-    // FAT1
-    ata_read_sector(sector_num, sector);
-    *(uint16_t *)&sector[offset] = value;
-    ata_write_sector(sector_num, sector);
+static void free_map_set(uint32_t cluster, int is_free)
+{
+    uint32_t bit = 1u << (cluster % 32);
 
-    // FAT2 mirror
-    uint32_t fat2_start = fat_start + bpb.sectors_per_fat;
-    ata_read_sector(fat2_start + (fat_offset / 512), sector);
-    *(uint16_t *)&sector[offset] = value;
-    ata_write_sector(fat2_start + (fat_offset / 512), sector);
+    if (is_free)
+        free_map[cluster / 32] |= bit;
+    else
+        free_map[cluster / 32] &= ~bit;
 }
 
-static void fat16_format_filename(const char *input, char *out11)
+static int free_map_test(uint32_t cluster)
 {
-    for (int i = 0; i < 11; i++)
-        out11[i] = ' ';
-
-    int i = 0;
-    int j = 0;
+    return (free_map[cluster / 32] >> (cluster % 32)) & 1;
+}
 
-    while (input[i] != '\0' && input[i] != '.' && j < 8)
-    {
-        char c = input[i];
-        if (c >= 'a' && c <= 'z')
-            c -= 32;
-        out11[j++] = c;
-        i++;
-    }
+static uint32_t fat16_entry_bytes()
+{
+    return vol.fat_bits / 8;
+}
 
-    if (input[i] == '.')
-    {
-        i++;
-        j = 8;
-        int k = 0;
+// Read an entry from a buffer holding FAT sector(s). FAT32 entries are
+// 28 bits; the top four are reserved.
+static uint32_t fat16_raw_get(const uint8_t *buf, uint32_t offset)
+{
+    if (vol.fat_bits == 32)
+        return *(const uint32_t *)&buf[offset] & 0x0FFFFFFF;
 
-        while (input[i] != '\0' && k < 3)
-        {
-            char c = input[i];
-            if (c >= 'a' && c <= 'z')
-                c -= 32;
-            out11[j++] = c;
-            i++;
-            k++;
-        }
-    }
+    return *(const uint16_t *)&buf[offset];
 }
 
-static void fat16_entry_to_name(fat16_dir_entry_t *entry, char *out)
+static void fat16_raw_set(uint8_t *buf, uint32_t offset, uint32_t value)
 {
-    int pos = 0;
-
-    for (int j = 0; j < 8; j++)
+    if (vol.fat_bits == 32)
     {
-        if (entry->name[j] == ' ')
-            break;
-        out[pos++] = entry->name[j];
+        uint32_t *p = (uint32_t *)&buf[offset];
+        *p = (*p & 0xF0000000) | (value & 0x0FFFFFFF);
     }
-
-    if (entry->ext[0] != ' ')
+    else
     {
-        out[pos++] = '.';
-        for (int j = 0; j < 3; j++)
-        {
-            if (entry->ext[j] == ' ')
-                break;
-            out[pos++] = entry->ext[j];
-        }
+        *(uint16_t *)&buf[offset] = (uint16_t)value;
     }
+}
 
-    out[pos] = '\0';
+static void fat16_unload_fat()
+{
+    if (fat_table)
+        kfree(fat_table);
+    if (fat_dirty)
+        kfree(fat_dirty);
+    if (free_map)
+        kfree(free_map);
+
+    fat_table = 0;
+    fat_dirty = 0;
+    free_map = 0;
+    fat_entries = 0;
+    fat_limit = 0;
+    free_count = 0;
+    free_known = 0;
 }
 
-static uint16_t fat16_alloc_cluster()
+// Pick up the FSInfo free-count and next-free hints (FAT32). Values that
+// are unset (0xFFFFFFFF) or out of range are ignored.
+static void fat16_read_fsinfo()
 {
-    uint32_t total_sectors = (bpb.total_sectors_16 != 0) ? bpb.total_sectors_16 : bpb.total_sectors_32;
+    fsinfo_free = 0xFFFFFFFF;
+    fsinfo_next = 0xFFFFFFFF;
+
+    if (vol.fat_bits != 32 || vol.bpb.fsinfo_sector == 0 || vol.bpb.fsinfo_sector == 0xFFFF)
+        return;
+
+    uint8_t sector[512];
+    bcache_read(vol.bpb.fsinfo_sector, sector);
 
-    uint32_t data_sectors =
-        total_sectors -
-        (bpb.reserved_sectors + (bpb.num_fats * bpb.sectors_per_fat) + fat16_root_dir_sectors());
+    if (*(uint32_t *)&sector[0] != 0x41615252 || *(uint32_t *)&sector[484] != 0x61417272)
+        return;
 
-    uint32_t total_clusters = data_sectors / bpb.sectors_per_cluster;
+    fsinfo_free = *(uint32_t *)&sector[488];
+    fsinfo_next = *(uint32_t *)&sector[492];
 
-    for (uint16_t cluster = 2; cluster < total_clusters + 2; cluster++)
+    if (fsinfo_free <= vol.total_clusters && !free_known)
     {
-        if (fat16_get_fat_entry(cluster) == 0x0000)
-        {
-            fat16_set_fat_entry(cluster, 0xFFFF);
-            return cluster;
-        }
+        free_count = fsinfo_free;
+        free_known = 1;
     }
 
-    return 0;
+    if (fsinfo_next >= 2 && fsinfo_next < fat_limit)
+        free_hint = fsinfo_next;
 }
 
-static void fat16_clear_cluster(uint16_t cluster)
+// Store the current free count and allocation hint in FSInfo when they
+// changed, so the next mount starts allocating where we left off.
+static void fat16_write_fsinfo()
 {
-    uint8_t zero[512];
-    for (int i = 0; i < 512; i++)
-        zero[i] = 0;
+    if (vol.fat_bits != 32 || vol.bpb.fsinfo_sector == 0 || vol.bpb.fsinfo_sector == 0xFFFF)
+        return;
 
-    uint32_t start_sector = fat16_cluster_to_sector(cluster);
+    uint32_t count = free_known ? free_count : 0xFFFFFFFF;
 
-    for (int s = 0; s < bpb.sectors_per_cluster; s++)
-        ata_write_sector(start_sector + s, zero);
-}
+    if (count == fsinfo_free && free_hint == fsinfo_next)
+        return;
 
-static void fat16_free_cluster_chain(uint16_t start_cluster)
-{
-    uint16_t cluster = start_cluster;
+    uint8_t sector[512];
+    bcache_read(vol.bpb.fsinfo_sector, sector);
 
-    while (cluster >= 2 && cluster < 0xFFF8)
-    {
-        uint16_t next = fat16_get_fat_entry(cluster);
-        fat16_set_fat_entry(cluster, 0x0000);
-        cluster = next;
-    }
-}
+    if (*(uint32_t *)&sector[0] != 0x41615252 || *(uint32_t *)&sector[484] != 0x61417272)
+        return;
 
-/* ---------------- PATH HANDLING ---------------- */
+    *(uint32_t *)&sector[488] = count;
+    *(uint32_t *)&sector[492] = free_hint;
+    bcache_write(vol.bpb.fsinfo_sector, sector);
+
+    fsinfo_free = count;
+    fsinfo_next = free_hint;
+}
 
-static void fat16_normalize_path(const char *base, const char *input, char *out)
+// Read the whole first FAT into RAM and build the free-cluster bitmap.
+// Returns 0 (and leaves the FAT on the sector cache) when it's too big.
+static int fat16_load_fat()
 {
-    char temp[128];
-    int ti = 0;
+    uint32_t entries = vol.bpb.sectors_per_fat * 512 / fat16_entry_bytes();
 
-    if (input[0] == '/')
-    {
-        temp[ti++] = '/';
-    }
-    else
-    {
-        for (int i = 0; base[i] != '\0'; i++)
-            temp[ti++] = base[i];
+    fat_limit = fat16_total_clusters() + 2;
+    if (fat_limit > entries)
+        fat_limit = entries;
 
-        if (ti > 1 && temp[ti - 1] != '/')
-            temp[ti++] = '/';
-    }
+    free_hint = 2;
+    fat16_read_fsinfo();
 
-    for (int i = 0; input[i] != '\0'; i++)
-        temp[ti++] = input[i];
+    if (vol.bpb.sectors_per_fat > FAT_RAM_MAX / 512)
+        return 0;
 
-    temp[ti] = '\0';
+    uint32_t bytes = vol.bpb.sectors_per_fat * 512;
 
-    char stack[16][32];
-    int top = 0;
+    fat_table = (uint8_t *)kmalloc(bytes);
+    fat_dirty = (uint8_t *)kmalloc(vol.bpb.sectors_per_fat);
+    free_map = (uint32_t *)kmalloc(((fat_limit + 31) / 32) * 4);
 
-    int i = 0;
-    while (temp[i] != '\0')
+    if (!fat_table || !fat_dirty || !free_map)
     {
-        while (temp[i] == '/')
-            i++;
-
-        if (temp[i] == '\0')
-            break;
+        uint32_t limit = fat_limit;
+        fat16_unload_fat();
+        fat_limit = limit;
+        return 0;
+    }
 
-        char part[32];
-        int pi = 0;
+    fat_entries = entries;
 
-        while (temp[i] != '\0' && temp[i] != '/')
-        {
-            if (pi < 31)
-                part[pi++] = temp[i];
-            i++;
-        }
+    bcache_read_range(vol.fat_start, vol.bpb.sectors_per_fat, fat_table);
 
-        part[pi] = '\0';
+    for (uint32_t i = 0; i < vol.bpb.sectors_per_fat; i++)
+        fat_dirty[i] = 0;
 
-        if (strcmp(part, ".") == 0)
-            continue;
+    for (uint32_t i = 0; i < (fat_limit + 31) / 32; i++)
+        free_map[i] = 0;
 
-        if (strcmp(part, "..") == 0)
+    // The bitmap gives the exact count; FSInfo only seeds the hint.
+    free_count = 0;
+    for (uint32_t c = 2; c < fat_limit; c++)
+    {
+        if (fat16_raw_get(fat_table, c * fat16_entry_bytes()) == 0)
         {
-            if (top > 0)
-                top--;
-            continue;
+            free_map_set(c, 1);
+            free_count++;
         }
-
-        strcpy(stack[top], part);
-        top++;
-    }
-
-    int oi = 0;
-    out[oi++] = '/';
-
-    for (int j = 0; j < top; j++)
-    {
-        int k = 0;
-        while (stack[j][k])
-            out[oi++] = stack[j][k++];
-
-        if (j != top - 1)
-            out[oi++] = '/';
     }
 
-    out[oi] = '\0';
+    free_known = 1;
+    return 1;
 }
 
-/* ---------------- DIRECTORY SEARCH ---------------- */
-
-static int fat16_find_entry(uint16_t dir_cluster, const char *name, fat16_dir_entry_t *out)
+// Copy dirty FAT sectors into the sector cache for every FAT copy; the
+// next bcache_sync() writes them out together.
+static void fat16_flush_fat()
 {
-    char fatname[11];
-    fat16_format_filename(name, fatname);
+    fat16_write_fsinfo();
 
-    uint8_t sector[512];
+    if (!fat_table)
+        return;
 
-    if (dir_cluster == 0)
+    for (uint32_t s = 0; s < vol.bpb.sectors_per_fat; s++)
     {
-        uint32_t root_start = fat16_root_start_sector();
-        uint32_t root_sectors = fat16_root_dir_sectors();
+        if (!fat_dirty[s])
+            continue;
 
-        for (uint32_t s = 0; s < root_sectors; s++)
+        for (uint32_t copy = 0; copy < vol.bpb.num_fats; copy++)
         {
-            ata_read_sector(root_start + s, sector);
+            uint32_t lba = vol.fat_start + copy * vol.bpb.sectors_per_fat + s;
+            bcache_write(lba, fat_table + s * 512);
+        }
 
-            for (int i = 0; i < 512; i += 32)
-            {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
+        fat_dirty[s] = 0;
+    }
+}
 
-                if (entry->name[0] == 0x00)
-                    return 0;
+static uint32_t fat16_get_fat_entry(uint32_t cluster)
+{
+    uint32_t fat_offset = cluster * fat16_entry_bytes();
 
-                if ((uint8_t)entry->name[0] == 0xE5)
-                    continue;
+    if (fat_table && cluster < fat_entries)
+        return fat16_raw_get(fat_table, fat_offset);
 
-                if (entry->attr == 0x0F)
-                    continue;
+    uint32_t sector_num = vol.fat_start + (fat_offset / 512);
+    uint32_t offset = fat_offset % 512;
 
-                int match = 1;
-                for (int j = 0; j < 8; j++)
-                {
-                    if (entry->name[j] != fatname[j])
-                    {
-                        match = 0;
-                        break;
-                    }
-                }
+    uint8_t sector[512];
+    bcache_read(sector_num, sector);
 
-                if (match)
-                {
-                    for (int j = 0; j < 3; j++)
-                    {
-                        if (entry->ext[j] != fatname[8 + j])
-                        {
-                            match = 0;
-                            break;
-                        }
-                    }
-                }
+    return fat16_raw_get(sector, offset);
+}
 
-                if (match)
-                {
-                    *out = *entry;
-                    return 1;
-                }
-            }
-        }
+// Keep the free count, bitmap and hint in step with one entry change.
+static void fat16_note_fat_change(uint32_t cluster, uint32_t old, uint32_t value)
+{
+    if (cluster < 2 || cluster >= fat_limit || (old == 0) == (value == 0))
+        return;
 
-        return 0;
+    if (free_map)
+        free_map_set(cluster, value == 0);
+
+    if (value == 0)
+    {
+        if (free_known)
+            free_count++;
+        if (cluster < free_hint)
+            free_hint = cluster;
+    }
+    else if (free_known && free_count > 0)
+    {
+        free_count--;
     }
+}
 
-    uint16_t cluster = dir_cluster;
+static void fat16_set_fat_entry(uint32_t cluster, uint32_t value)
+{
+    uint32_t fat_offset = cluster * fat16_entry_bytes();
 
-    while (cluster < 0xFFF8)
+    if (fat_table && cluster < fat_entries)
     {
-        uint32_t start_sector = fat16_cluster_to_sector(cluster);
-
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
-        {
-            ata_read_sector(start_sector + s, sector);
+        uint32_t old = fat16_raw_get(fat_table, fat_offset);
 
-            for (int i = 0; i < 512; i += 32)
-            {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
+        fat16_raw_set(fat_table, fat_offset, value);
+        fat_dirty[fat_offset / 512] = 1;
 
-                if (entry->name[0] == 0x00)
-                    return 0;
+        fat16_note_fat_change(cluster, old, value);
+        return;
+    }
 
-                if ((uint8_t)entry->name[0] == 0xE5)
-                    continue;
+    uint32_t sector_num = vol.fat_start + (fat_offset / 512);
+    uint32_t offset = fat_offset % 512;
 
-                if (entry->attr == 0x0F)
-                    continue;
+    uint8_t sector[512];
+    uint32_t old = 0;
 
-                int match = 1;
-                for (int j = 0; j < 8; j++)
-                {
-                    if (entry->name[j] != fatname[j])
-                    {
-                        match = 0;
-                        break;
-                    }
-                }
+    for (uint32_t copy = 0; copy < vol.bpb.num_fats; copy++)
+    {
+        uint32_t lba = sector_num + copy * vol.bpb.sectors_per_fat;
 
-                if (match)
-                {
-                    for (int j = 0; j < 3; j++)
-                    {
-                        if (entry->ext[j] != fatname[8 + j])
-                        {
-                            match = 0;
-                            break;
-                        }
-                    }
-                }
+        bcache_read(lba, sector);
 
-                if (match)
-                {
-                    *out = *entry;
-                    return 1;
-                }
-            }
-        }
+        if (copy == 0)
+            old = fat16_raw_get(sector, offset);
 
-        cluster = fat16_get_fat_entry(cluster);
+        fat16_raw_set(sector, offset, value);
+        bcache_write(lba, sector);
     }
 
-    return 0;
+    fat16_note_fat_change(cluster, old, value);
 }
 
-static int fat16_find_entry_location(uint16_t dir_cluster, const char *name,
-                                     uint32_t *out_sector, uint32_t *out_offset,
-                                     fat16_dir_entry_t *out_entry)
+// Without the in-memory FAT: the first free cluster at or after `from`,
+// wrapping once, reading the FAT a sector at a time. 0 if there is none.
+static uint32_t fat16_scan_free(uint32_t from)
 {
-    char fatname[11];
-    fat16_format_filename(name, fatname);
-
+    uint32_t per_sector = 512 / fat16_entry_bytes();
+    uint32_t c = (from >= 2 && from < fat_limit) ? from : 2;
+    uint32_t loaded = 0xFFFFFFFF;
     uint8_t sector[512];
 
-    if (dir_cluster == 0)
+    for (uint32_t n = 2; n < fat_limit; n++, c++)
     {
-        uint32_t root_start = fat16_root_start_sector();
-        uint32_t root_sectors = fat16_root_dir_sectors();
+        if (c >= fat_limit)
+            c = 2;
 
-        for (uint32_t s = 0; s < root_sectors; s++)
+        uint32_t s = c / per_sector;
+        if (s != loaded)
         {
-            ata_read_sector(root_start + s, sector);
-
-            for (uint32_t i = 0; i < 512; i += 32)
-            {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
-
-                if (entry->name[0] == 0x00)
-                    return 0;
-
-                if ((uint8_t)entry->name[0] == 0xE5)
-                    continue;
-
-                if (entry->attr == 0x0F)
-                    continue;
-
-                int match = 1;
-                for (int j = 0; j < 8; j++)
-                {
-                    if (entry->name[j] != fatname[j])
-                    {
-                        match = 0;
-                        break;
-                    }
-                }
-
-                if (match)
-                {
-                    for (int j = 0; j < 3; j++)
-                    {
-                        if (entry->ext[j] != fatname[8 + j])
-                        {
-                            match = 0;
-                            break;
-                        }
-                    }
-                }
-
-                if (match)
-                {
-                    if (out_sector) *out_sector = root_start + s;
-                    if (out_offset) *out_offset = i;
-                    if (out_entry) *out_entry = *entry;
-                    return 1;
-                }
-            }
+            bcache_read(vol.fat_start + s, sector);
+            loaded = s;
         }
 
-        return 0;
+        if (fat16_raw_get(sector, (c % per_sector) * fat16_entry_bytes()) == 0)
+            return c;
     }
 
-    uint16_t cluster = dir_cluster;
+    return 0;
+}
 
-    while (cluster < 0xFFF8)
+static uint32_t fat16_alloc_cluster()
+{
+    if (free_map)
     {
-        uint32_t start_sector = fat16_cluster_to_sector(cluster);
+        if (free_count == 0)
+            return 0;
+
+        // Scan the bitmap a word at a time from the hint, wrapping once.
+        uint32_t words = (fat_limit + 31) / 32;
+        uint32_t start = free_hint / 32;
 
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
+        for (uint32_t n = 0; n <= words; n++)
         {
-            ata_read_sector(start_sector + s, sector);
+            uint32_t w = (start + n) % words;
+            if (free_map[w] == 0)
+                continue;
 
-            for (uint32_t i = 0; i < 512; i += 32)
+            for (uint32_t b = 0; b < 32; b++)
             {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
-
-                if (entry->name[0] == 0x00)
-                    return 0;
+                uint32_t cluster = w * 32 + b;
 
-                if ((uint8_t)entry->name[0] == 0xE5)
+                if (cluster < 2 || cluster >= fat_limit || !free_map_test(cluster))
                     continue;
 
-                if (entry->attr == 0x0F)
-                    continue;
-
-                int match = 1;
-                for (int j = 0; j < 8; j++)
-                {
-                    if (entry->name[j] != fatname[j])
-                    {
-                        match = 0;
-                        break;
-                    }
-                }
-
-                if (match)
-                {
-                    for (int j = 0; j < 3; j++)
-                    {
-                        if (entry->ext[j] != fatname[8 + j])
-                        {
-                            match = 0;
-                            break;
-                        }
-                    }
-                }
-
-                if (match)
-                {
-                    if (out_sector) *out_sector = start_sector + s;
-                    if (out_offset) *out_offset = i;
-                    if (out_entry) *out_entry = *entry;
-                    return 1;
-                }
+                fat16_set_fat_entry(cluster, vol.eoc);
+                free_hint = cluster + 1;
+                return cluster;
             }
         }
 
-        cluster = fat16_get_fat_entry(cluster);
+        return 0;
     }
 
-    return 0;
+    if (free_known && free_count == 0)
+        return 0;
+
+    uint32_t cluster = fat16_scan_free(free_hint);
+    if (cluster == 0)
+        return 0;
+
+    fat16_set_fat_entry(cluster, vol.eoc);
+    free_hint = cluster + 1;
+    return cluster;
 }
 
-static int fat16_find_free_dir_entry(uint16_t dir_cluster, uint32_t *out_sector, uint32_t *out_offset)
+// Allocate up to `want` clusters as one contiguous run, chained and
+// terminated. A run starting at `goal` (normally the cluster after the
+// file's current tail) is preferred so files grow in place; otherwise the
+// first free run long enough is taken, or the longest one found. Returns
+// the first cluster and stores the run length in `got`; 0 if the disk is
+// full.
+static uint32_t fat16_alloc_run(uint32_t want, uint32_t goal, uint32_t *got)
 {
-    uint8_t sector[512];
+    *got = 0;
 
-    if (dir_cluster == 0)
-    {
-        uint32_t root_start = fat16_root_start_sector();
-        uint32_t root_sectors = fat16_root_dir_sectors();
+    if (want == 0)
+        want = 1;
 
-        for (uint32_t s = 0; s < root_sectors; s++)
-        {
-            ata_read_sector(root_start + s, sector);
+    uint32_t start = 0;
+    uint32_t len = 0;
 
-            for (uint32_t i = 0; i < 512; i += 32)
-            {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
+    if (!free_map)
+    {
+        // Through the sector cache: take the goal or the first free
+        // cluster from the hint, and grow the run while the next one is
+        // free too.
+        if (free_known && free_count == 0)
+            return 0;
 
-                if (entry->name[0] == 0x00 || (uint8_t)entry->name[0] == 0xE5)
-                {
-                    *out_sector = root_start + s;
-                    *out_offset = i;
-                    return 1;
-                }
-            }
-        }
+        if (goal >= 2 && goal < fat_limit && fat16_get_fat_entry(goal) == 0)
+            start = goal;
+        else
+            start = fat16_scan_free(free_hint);
 
+        if (start == 0)
+            return 0;
+
+        len = 1;
+        while (len < want && start + len < fat_limit && fat16_get_fat_entry(start + len) == 0)
+            len++;
+    }
+    else if (free_count == 0)
+    {
         return 0;
     }
+    else if (goal >= 2 && goal < fat_limit)
+    {
+        while (len < want && goal + len < fat_limit && free_map_test(goal + len))
+            len++;
 
-    uint16_t cluster = dir_cluster;
+        start = goal;
+    }
 
-    while (cluster < 0xFFF8)
+    if (len == 0)
     {
-        uint32_t start_sector = fat16_cluster_to_sector(cluster);
+        uint32_t c = (free_hint >= 2 && free_hint < fat_limit) ? free_hint : 2;
+        uint32_t scanned = 0;
+        uint32_t total = fat_limit - 2;
 
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
+        while (scanned < total)
         {
-            ata_read_sector(start_sector + s, sector);
+            if (c >= fat_limit)
+                c = 2;
 
-            for (uint32_t i = 0; i < 512; i += 32)
+            if (!free_map_test(c))
             {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
-
-                if (entry->name[0] == 0x00 || (uint8_t)entry->name[0] == 0xE5)
-                {
-                    *out_sector = start_sector + s;
-                    *out_offset = i;
-                    return 1;
-                }
+                // Skip fully allocated bitmap words in one step.
+                uint32_t step = (c % 32 == 0 && free_map[c / 32] == 0) ? 32 : 1;
+                c += step;
+                scanned += step;
+                continue;
             }
-        }
 
-        cluster = fat16_get_fat_entry(cluster);
-    }
+            uint32_t run_start = c;
+            uint32_t run_len = 0;
 
-    return 0;
-}
+            while (c < fat_limit && run_len < want && free_map_test(c))
+            {
+                c++;
+                run_len++;
+            }
 
-static int fat16_resolve_absolute(const char *path, uint16_t *out_cluster)
-{
-    if (!path || path[0] != '/')
-        return 0;
+            scanned += run_len;
 
-    uint16_t cluster = 0;
-    path++;
+            if (run_len > len)
+            {
+                start = run_start;
+                len = run_len;
+            }
 
-    char part[32];
-    int pi = 0;
+            if (len >= want)
+                break;
+        }
+    }
+
+    if (len == 0)
+        return 0;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint32_t next = (i + 1 < len) ? start + i + 1 : vol.eoc;
+        fat16_set_fat_entry(start + i, next);
+    }
+
+    if (free_hint >= start && free_hint < start + len)
+        free_hint = start + len;
+
+    *got = len;
+    return start;
+}
+
+static void fat16_clear_cluster(uint32_t cluster)
+{
+    uint8_t zero[512];
+    for (int i = 0; i < 512; i++)
+        zero[i] = 0;
+
+    uint32_t start_sector = fat16_cluster_to_sector(cluster);
+
+    for (int s = 0; s < vol.bpb.sectors_per_cluster; s++)
+        bcache_write(start_sector + s, zero);
+}
+
+// Write up to `count` clusters of `data` into a freshly allocated run of
+// contiguous clusters. Whole sectors go out as one multi-sector write; a
+// partial last sector is zero-padded. Returns the number of bytes consumed,
+// or 0 if the write failed.
+static uint32_t fat16_fill_run(uint32_t cluster, uint32_t count, const uint8_t *data, uint32_t len)
+{
+    uint32_t run_bytes = vol.cluster_bytes * count;
+    if (len > run_bytes)
+        len = run_bytes;
+
+    uint32_t sector_start = fat16_cluster_to_sector(cluster);
+    uint32_t full = len / 512;
+
+    if (full > 0 && !bcache_write_range(sector_start, full, data))
+        return 0;
+
+    uint32_t tail = len % 512;
+    if (tail > 0)
+    {
+        uint8_t buf[512];
+        for (uint32_t i = 0; i < 512; i++)
+            buf[i] = (i < tail) ? data[full * 512 + i] : 0;
+
+        bcache_write(sector_start + full, buf);
+    }
+
+    return len;
+}
+
+static void fat16_free_cluster_chain(uint32_t start_cluster)
+{
+    uint32_t cluster = start_cluster;
+
+    while (cluster >= 2 && cluster < vol.eoc_min)
+    {
+        uint32_t next = fat16_get_fat_entry(cluster);
+        fat16_set_fat_entry(cluster, 0x0000);
+        cluster = next;
+    }
+}
+
+/* ---------------- PATH HANDLING ---------------- */
+
+// Paths are taken from the volume root; the working directory belongs to
+// the VFS, which hands us absolute paths.
+static void fat16_normalize_path(const char *input, char *out)
+{
+    char temp[128];
+    int ti = 0;
+
+    temp[ti++] = '/';
+
+    for (int i = 0; input[i] != '\0' && ti < 127; i++)
+        temp[ti++] = input[i];
+
+    temp[ti] = '\0';
+
+    // Components are kept as (start, length) pairs into `temp`; with long
+    // names a copy per component would not fit on the stack.
+    int part_start[64];
+    int part_len[64];
+    int top = 0;
+
+    int i = 0;
+    while (temp[i] != '\0')
+    {
+        while (temp[i] == '/')
+            i++;
+
+        if (temp[i] == '\0')
+            break;
+
+        int start = i;
+        while (temp[i] != '\0' && temp[i] != '/')
+            i++;
+
+        int len = i - start;
+
+        if (len == 1 && temp[start] == '.')
+            continue;
+
+        if (len == 2 && temp[start] == '.' && temp[start + 1] == '.')
+        {
+            if (top > 0)
+                top--;
+            continue;
+        }
+
+        if (len > FAT16_NAME_MAX)
+            len = FAT16_NAME_MAX;
+
+        if (top < 64)
+        {
+            part_start[top] = start;
+            part_len[top] = len;
+            top++;
+        }
+    }
+
+    int oi = 0;
+    out[oi++] = '/';
+
+    for (int j = 0; j < top; j++)
+    {
+        for (int k = 0; k < part_len[j]; k++)
+            out[oi++] = temp[part_start[j] + k];
+
+        if (j != top - 1)
+            out[oi++] = '/';
+    }
+
+    out[oi] = '\0';
+}
+
+/* ---------------- NAMES ---------------- */
+
+#define FAT16_ATTR_LFN 0x0F
+#define FAT16_LFN_LAST 0x40
+#define FAT16_LFN_CHARS 13
+#define FAT16_LFN_MAX_SLOTS ((FAT16_NAME_MAX + FAT16_LFN_CHARS - 1) / FAT16_LFN_CHARS)
+
+// NT case flags in the reserved byte: an all-lowercase base or extension
+// is stored as a plain 8.3 entry instead of needing a long name.
+#define FAT16_NT_LOWER_BASE 0x08
+#define FAT16_NT_LOWER_EXT 0x10
+
+static char fat16_fold(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        return c - 32;
+    return c;
+}
+
+static int fat16_names_equal(const char *a, const char *b)
+{
+    while (*a && fat16_fold(*a) == fat16_fold(*b))
+    {
+        a++;
+        b++;
+    }
+
+    return *a == '\0' && *b == '\0';
+}
+
+static uint32_t fat16_name_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+
+    for (; *name; name++)
+        h = (h ^ (uint8_t)fat16_fold(*name)) * 16777619u;
+
+    return h;
+}
+
+static int fat16_name_matches(const fat16_dir_entry_t *entry, const char *fatname)
+{
+    for (int j = 0; j < 8; j++)
+    {
+        if (entry->name[j] != fatname[j])
+            return 0;
+    }
+
+    for (int j = 0; j < 3; j++)
+    {
+        if (entry->ext[j] != fatname[8 + j])
+            return 0;
+    }
+
+    return 1;
+}
+
+// Characters allowed in a long name. Only ASCII is accepted since names
+// are stored as the low byte of each UCS-2 character.
+static int fat16_long_char_ok(char c)
+{
+    if (c < 0x20 || c == 0x7F || (c & 0x80))
+        return 0;
+
+    const char *bad = "\"*/:<>?\\|";
+    for (int i = 0; bad[i]; i++)
+    {
+        if (c == bad[i])
+            return 0;
+    }
+
+    return 1;
+}
+
+static int fat16_short_char_ok(char c)
+{
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))
+        return 1;
+
+    const char *ok = "$%'-_@~`!(){}^#&";
+    for (int i = 0; ok[i]; i++)
+    {
+        if (c == ok[i])
+            return 1;
+    }
+
+    return 0;
+}
+
+static int fat16_name_valid(const char *name)
+{
+    int len = strlen(name);
+
+    if (len == 0 || len > FAT16_NAME_MAX)
+        return 0;
+
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        return 0;
+
+    for (int i = 0; i < len; i++)
+    {
+        if (!fat16_long_char_ok(name[i]))
+            return 0;
+    }
+
+    return 1;
+}
+
+// Case of a run of short-name characters: 1 = all lower, 2 = all upper
+// (or no letters), 0 = mixed.
+static int fat16_short_case(const char *s, int len)
+{
+    int lower = 0;
+    int upper = 0;
+
+    for (int i = 0; i < len; i++)
+    {
+        if (s[i] >= 'a' && s[i] <= 'z')
+            lower = 1;
+        else if (s[i] >= 'A' && s[i] <= 'Z')
+            upper = 1;
+    }
+
+    if (lower && upper)
+        return 0;
+
+    return lower ? 1 : 2;
+}
+
+// Fill `out11` if `name` can be stored exactly as an 8.3 entry, with
+// `*nt` receiving the case flags. Returns 0 if it needs a long name.
+static int fat16_short_name(const char *name, char *out11, uint8_t *nt)
+{
+    int len = strlen(name);
+    int dot = -1;
+
+    for (int i = 0; i < len; i++)
+    {
+        if (name[i] == '.')
+        {
+            if (dot >= 0)
+                return 0;
+            dot = i;
+        }
+        else if (!fat16_short_char_ok(name[i]))
+            return 0;
+    }
+
+    int base_len = (dot >= 0) ? dot : len;
+    int ext_len = (dot >= 0) ? len - dot - 1 : 0;
+
+    if (base_len < 1 || base_len > 8 || ext_len > 3 || (dot >= 0 && ext_len == 0))
+        return 0;
+
+    int base_case = fat16_short_case(name, base_len);
+    int ext_case = fat16_short_case(name + base_len + 1, ext_len);
+
+    if (base_case == 0 || ext_case == 0)
+        return 0;
+
+    *nt = 0;
+    if (base_case == 1)
+        *nt |= FAT16_NT_LOWER_BASE;
+    if (ext_case == 1)
+        *nt |= FAT16_NT_LOWER_EXT;
+
+    for (int i = 0; i < 11; i++)
+        out11[i] = ' ';
+
+    for (int i = 0; i < base_len; i++)
+        out11[i] = fat16_fold(name[i]);
+
+    for (int i = 0; i < ext_len; i++)
+        out11[8 + i] = fat16_fold(name[base_len + 1 + i]);
+
+    return 1;
+}
+
+// 8.3 name as text, lowercased where the NT flags say so.
+static void fat16_short_to_name(const char *short11, uint8_t nt, char *out)
+{
+    int pos = 0;
+
+    for (int j = 0; j < 8 && short11[j] != ' '; j++)
+    {
+        char c = short11[j];
+        if ((nt & FAT16_NT_LOWER_BASE) && c >= 'A' && c <= 'Z')
+            c += 32;
+        out[pos++] = c;
+    }
+
+    if (short11[8] != ' ')
+    {
+        out[pos++] = '.';
+        for (int j = 8; j < 11 && short11[j] != ' '; j++)
+        {
+            char c = short11[j];
+            if ((nt & FAT16_NT_LOWER_EXT) && c >= 'A' && c <= 'Z')
+                c += 32;
+            out[pos++] = c;
+        }
+    }
+
+    out[pos] = '\0';
+}
+
+// Uppercased, filtered 8.3 basis for a long name; a numeric tail is
+// added by fat16_short_tail().
+static void fat16_short_basis(const char *name, char *out11)
+{
+    for (int i = 0; i < 11; i++)
+        out11[i] = ' ';
+
+    int len = strlen(name);
+    int dot = -1;
+
+    for (int i = len - 1; i > 0; i--)
+    {
+        if (name[i] == '.')
+        {
+            dot = i;
+            break;
+        }
+    }
+
+    int end = (dot >= 0) ? dot : len;
+    int j = 0;
+
+    for (int i = 0; i < end && j < 8; i++)
+    {
+        char c = name[i];
+        if (c == ' ' || c == '.')
+            continue;
+        out11[j++] = fat16_short_char_ok(c) ? fat16_fold(c) : '_';
+    }
+
+    if (j == 0)
+        out11[j++] = '_';
+
+    if (dot >= 0)
+    {
+        j = 8;
+        for (int i = dot + 1; i < len && j < 11; i++)
+        {
+            char c = name[i];
+            if (c == ' ' || c == '.')
+                continue;
+            out11[j++] = fat16_short_char_ok(c) ? fat16_fold(c) : '_';
+        }
+    }
+}
+
+// Candidate `n` for a long name's short alias: BASIS~1..BASIS~4 first,
+// then two basis characters, four hex digits and ~1, so a directory full
+// of similar names doesn't have to probe thousands of ~N tails.
+static void fat16_short_tail(const char *basis11, uint32_t n, uint32_t hash, char *out11)
+{
+    char tail[8];
+    int tail_len = 0;
+    int keep;
+
+    if (n <= 4)
+    {
+        tail[tail_len++] = '~';
+        tail[tail_len++] = (char)('0' + n);
+        keep = 6;
+    }
+    else
+    {
+        const char *hex = "0123456789ABCDEF";
+        uint32_t v = hash + n;
+
+        for (int i = 3; i >= 0; i--)
+            tail[tail_len++] = hex[(v >> (i * 4)) & 0xF];
+
+        tail[tail_len++] = '~';
+        tail[tail_len++] = '1';
+        keep = 2;
+    }
+
+    for (int i = 0; i < 11; i++)
+        out11[i] = basis11[i];
+
+    int base_len = 0;
+    while (base_len < 8 && basis11[base_len] != ' ')
+        base_len++;
+
+    if (base_len > keep)
+        base_len = keep;
+
+    for (int i = 0; i < 8; i++)
+        out11[i] = ' ';
+
+    for (int i = 0; i < base_len; i++)
+        out11[i] = basis11[i];
+
+    for (int i = 0; i < tail_len; i++)
+        out11[base_len + i] = tail[i];
+}
+
+static uint8_t fat16_lfn_checksum(const char *short11)
+{
+    uint8_t sum = 0;
+
+    for (int i = 0; i < 11; i++)
+        sum = (uint8_t)(((sum & 1) << 7) + (sum >> 1) + (uint8_t)short11[i]);
+
+    return sum;
+}
+
+// Store characters [13 * (ord - 1), 13 * ord) of `name` in one long-name
+// slot: NUL after the last character, 0xFFFF padding after that.
+static void fat16_lfn_fill(fat16_lfn_entry_t *lfn, const char *name, uint32_t len,
+                           uint32_t ord, int last, uint8_t checksum)
+{
+    uint16_t chars[FAT16_LFN_CHARS];
+
+    for (uint32_t i = 0; i < FAT16_LFN_CHARS; i++)
+    {
+        uint32_t at = (ord - 1) * FAT16_LFN_CHARS + i;
+
+        if (at < len)
+            chars[i] = (uint8_t)name[at];
+        else if (at == len)
+            chars[i] = 0x0000;
+        else
+            chars[i] = 0xFFFF;
+    }
+
+    lfn->order = (uint8_t)(ord | (last ? FAT16_LFN_LAST : 0));
+    lfn->attr = FAT16_ATTR_LFN;
+    lfn->type = 0;
+    lfn->checksum = checksum;
+    lfn->first_cluster = 0;
+
+    for (int i = 0; i < 5; i++)
+        lfn->name1[i] = chars[i];
+    for (int i = 0; i < 6; i++)
+        lfn->name2[i] = chars[5 + i];
+    for (int i = 0; i < 2; i++)
+        lfn->name3[i] = chars[11 + i];
+}
+
+// Copy one slot's characters into `out` (13 bytes). Non-ASCII characters
+// read back as '?'; the terminator and padding become NULs.
+static void fat16_lfn_extract(const fat16_lfn_entry_t *lfn, char *out)
+{
+    uint16_t chars[FAT16_LFN_CHARS];
+
+    for (int i = 0; i < 5; i++)
+        chars[i] = lfn->name1[i];
+    for (int i = 0; i < 6; i++)
+        chars[5 + i] = lfn->name2[i];
+    for (int i = 0; i < 2; i++)
+        chars[11 + i] = lfn->name3[i];
+
+    for (int i = 0; i < FAT16_LFN_CHARS; i++)
+    {
+        uint16_t c = chars[i];
+
+        if (c == 0x0000 || c == 0xFFFF)
+            out[i] = '\0';
+        else
+            out[i] = (c < 0x80) ? (char)c : '?';
+    }
+}
+
+/* ---------------- DIRECTORY ITERATION ---------------- */
+
+// Slot position within a directory; `cluster` is 0 in the fixed root.
+typedef struct
+{
+    uint32_t lba;
+    uint32_t cluster;
+    uint16_t offset;
+} fat16_slot_t;
+
+// Walks the 32-byte slots of a directory, one cached sector at a time.
+typedef struct
+{
+    uint32_t dir_cluster;
+    fat16_slot_t pos;
+    uint32_t index; // sector within the cluster (or the root directory)
+    uint8_t fixed;  // FAT16 root: a fixed run of sectors, not a chain
+    uint8_t end;
+    uint8_t loaded;
+
+    // Set when the walk stopped at a 0x00 end marker rather than the end
+    // of the directory's storage.
+    uint8_t marker;
+    fat16_slot_t marker_pos;
+
+    uint32_t deleted; // deleted slots passed by fat16_dir_next()
+
+    uint8_t sector[512];
+} fat16_dir_iter_t;
+
+// One directory entry: the 8.3 entry plus its long name, if any.
+typedef struct
+{
+    fat16_dir_entry_t entry;
+    fat16_slot_t slot;  // the 8.3 entry
+    fat16_slot_t first; // first slot of the entry (long-name or 8.3)
+    uint32_t slots;
+    char name[FAT16_NAME_MAX + 1];
+} fat16_dirent_t;
+
+static void fat16_open_files_reload(uint32_t entry_sector, uint32_t entry_offset);
+static void fat16_open_files_move(uint32_t entry_sector, uint32_t entry_offset, const fat16_dirent_t *to);
+static void fat16_open_files_detach(uint32_t entry_sector, uint32_t entry_offset);
+
+static int fat16_slot_equal(const fat16_slot_t *a, const fat16_slot_t *b)
+{
+    return a->lba == b->lba && a->offset == b->offset;
+}
+
+// First cluster of a directory. Directory cluster 0 is the root (as in
+// ".." entries), which is a chain starting at the BPB's root cluster on
+// FAT32 and a fixed region on FAT16 (returns 0).
+static uint32_t fat16_dir_chain(uint32_t dir_cluster)
+{
+    return dir_cluster ? dir_cluster : vol.bpb.root_cluster;
+}
+
+static void fat16_iter_seek(fat16_dir_iter_t *it, uint32_t dir_cluster, const fat16_slot_t *slot)
+{
+    it->dir_cluster = dir_cluster;
+    it->fixed = (fat16_dir_chain(dir_cluster) == 0);
+    it->pos = *slot;
+    it->end = 0;
+    it->loaded = 0;
+    it->marker = 0;
+    it->deleted = 0;
+
+    if (it->fixed)
+        it->index = slot->lba - fat16_root_start_sector();
+    else
+        it->index = slot->lba - fat16_cluster_to_sector(slot->cluster);
+}
+
+static void fat16_iter_start(fat16_dir_iter_t *it, uint32_t dir_cluster)
+{
+    uint32_t chain = fat16_dir_chain(dir_cluster);
+
+    fat16_slot_t slot;
+    slot.cluster = chain;
+    slot.offset = 0;
+    slot.lba = (chain == 0) ? fat16_root_start_sector()
+                            : fat16_cluster_to_sector(chain);
+
+    fat16_iter_seek(it, dir_cluster, &slot);
+}
+
+// The slot under the iterator, or 0 past the end of the directory.
+static fat16_dir_entry_t *fat16_iter_entry(fat16_dir_iter_t *it)
+{
+    if (it->end)
+        return 0;
+
+    if (!it->loaded)
+    {
+        bcache_read(it->pos.lba, it->sector);
+        it->loaded = 1;
+    }
+
+    return (fat16_dir_entry_t *)&it->sector[it->pos.offset];
+}
+
+static void fat16_iter_advance(fat16_dir_iter_t *it)
+{
+    if (it->end)
+        return;
+
+    it->pos.offset += 32;
+    if (it->pos.offset < 512)
+        return;
+
+    it->pos.offset = 0;
+    it->loaded = 0;
+    it->index++;
+
+    if (it->fixed)
+    {
+        if (it->index >= fat16_root_dir_sectors())
+            it->end = 1;
+        else
+            it->pos.lba++;
+        return;
+    }
+
+    if (it->index < vol.bpb.sectors_per_cluster)
+    {
+        it->pos.lba++;
+        return;
+    }
+
+    uint32_t next = fat16_get_fat_entry(it->pos.cluster);
+    if (next < 2 || next >= vol.eoc_min)
+    {
+        it->end = 1;
+        return;
+    }
+
+    it->pos.cluster = next;
+    it->pos.lba = fat16_cluster_to_sector(next);
+    it->index = 0;
+}
+
+// Next live entry. Long-name slots are attached to the 8.3 entry that
+// follows them when their sequence and checksum hold up; orphans are
+// ignored and the 8.3 name is used. Volume labels are skipped.
+// Returns 0 at the end of the directory.
+static int fat16_dir_next(fat16_dir_iter_t *it, fat16_dirent_t *out)
+{
+    char lfn[FAT16_LFN_MAX_SLOTS * FAT16_LFN_CHARS + 1];
+    int next_ord = -1; // long-name slot expected next; 0 = complete
+    uint8_t checksum = 0;
+    uint32_t lfn_slots = 0;
+    fat16_slot_t first = it->pos;
+
+    fat16_dir_entry_t *e;
+
+    while ((e = fat16_iter_entry(it)) != 0)
+    {
+        fat16_slot_t here = it->pos;
+        fat16_dir_entry_t cur = *e;
+
+        if (cur.name[0] == 0x00)
+        {
+            it->marker = 1;
+            it->marker_pos = here;
+            it->end = 1;
+            return 0;
+        }
+
+        fat16_iter_advance(it);
+
+        if ((uint8_t)cur.name[0] == 0xE5)
+        {
+            it->deleted++;
+            next_ord = -1;
+            continue;
+        }
+
+        if (cur.attr == FAT16_ATTR_LFN)
+        {
+            fat16_lfn_entry_t *l = (fat16_lfn_entry_t *)&cur;
+            int ord = l->order & 0x1F;
+
+            if (l->order & FAT16_LFN_LAST)
+            {
+                if (ord < 1 || ord > FAT16_LFN_MAX_SLOTS)
+                {
+                    next_ord = -1;
+                    continue;
+                }
+
+                checksum = l->checksum;
+                lfn_slots = ord;
+                first = here;
+                lfn[ord * FAT16_LFN_CHARS] = '\0';
+            }
+            else if (next_ord < 1 || ord != next_ord || l->checksum != checksum)
+            {
+                next_ord = -1;
+                continue;
+            }
+
+            fat16_lfn_extract(l, &lfn[(ord - 1) * FAT16_LFN_CHARS]);
+            next_ord = ord - 1;
+            continue;
+        }
+
+        if (cur.attr & 0x08)
+        {
+            next_ord = -1;
+            continue;
+        }
+
+        out->entry = cur;
+        out->slot = here;
+
+        const char *short11 = (const char *)&cur;
+
+        if (next_ord == 0 && fat16_lfn_checksum(short11) == checksum &&
+            lfn[0] != '\0' && strlen(lfn) <= FAT16_NAME_MAX)
+        {
+            strcpy(out->name, lfn);
+            out->first = first;
+            out->slots = lfn_slots + 1;
+        }
+        else
+        {
+            fat16_short_to_name(short11, cur.reserved, out->name);
+            out->first = here;
+            out->slots = 1;
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+// Resumable form of fat16_dir_next() for recursive walks: the position
+// lives in the caller, the iterator's sector buffer does not.
+static int fat16_dir_next_at(uint32_t dir_cluster, fat16_slot_t *pos, int *done, fat16_dirent_t *out)
+{
+    if (*done)
+        return 0;
+
+    fat16_dir_iter_t it;
+    fat16_iter_seek(&it, dir_cluster, pos);
+
+    if (!fat16_dir_next(&it, out))
+    {
+        *done = 1;
+        return 0;
+    }
+
+    if (it.end)
+        *done = 1;
+    else
+        *pos = it.pos;
+
+    return 1;
+}
+
+static void fat16_dir_start_pos(uint32_t dir_cluster, fat16_slot_t *pos)
+{
+    fat16_dir_iter_t it;
+    fat16_iter_start(&it, dir_cluster);
+    *pos = it.pos;
+}
+
+static int fat16_is_dot_entry(const fat16_dir_entry_t *entry)
+{
+    return entry->name[0] == '.' && (entry->name[1] == ' ' || entry->name[1] == '.');
+}
+
+// `name` refers to this entry by its long name or its 8.3 alias
+// (case-insensitively).
+static int fat16_dirent_matches(const fat16_dirent_t *d, const char *name)
+{
+    if (fat16_names_equal(d->name, name))
+        return 1;
+
+    char short11[11];
+    uint8_t nt;
+
+    return d->slots > 1 && fat16_short_name(name, short11, &nt) &&
+           fat16_name_matches(&d->entry, short11);
+}
+
+/* ---------------- DIRECTORY INDEX ---------------- */
+
+// Per-directory hash index, built by one scan on first lookup and kept up
+// to date by every create and delete, so a lookup costs one hash probe
+// plus a read of the candidate's slots (which also guards against hash
+// collisions). Entries are hashed by long name and by 8.3 alias. Only a
+// few directories are indexed at a time; the least recently used index is
+// discarded. If memory runs out lookups fall back to a linear scan.
+
+#define DINDEX_DIRS 8
+#define DINDEX_NIL 0xFFFFFFFFu
+#define DINDEX_MIN_BUCKETS 16
+
+typedef struct
+{
+    uint32_t hash;
+    uint32_t next;
+    fat16_slot_t first;
+} fat16_dindex_node_t;
+
+typedef struct
+{
+    uint8_t valid;
+    uint32_t dir_cluster;
+    uint32_t last_use;
+
+    uint32_t *buckets; // power-of-two count
+    uint32_t nbuckets;
+
+    fat16_dindex_node_t *nodes;
+    uint32_t capacity;
+    uint32_t count;     // nodes in use
+    uint32_t unused;    // nodes[unused..capacity) were never handed out
+    uint32_t free_list;
+
+    // Start of the free space after the last entry, so new entries can be
+    // appended without a scan. Only used while the directory has no
+    // deleted slots (`holes`) that a scan would reuse first.
+    fat16_slot_t end;
+    uint8_t end_valid;
+    uint8_t holes;
+} fat16_dindex_t;
+
+static fat16_dindex_t dindex[DINDEX_DIRS];
+static uint32_t dindex_clock = 0;
+static fat16_dindex_stats_t dindex_stats;
+
+static void fat16_dindex_free(fat16_dindex_t *ix)
+{
+    if (ix->buckets)
+        kfree(ix->buckets);
+    if (ix->nodes)
+        kfree(ix->nodes);
+
+    ix->buckets = 0;
+    ix->nodes = 0;
+    ix->valid = 0;
+}
+
+// Forget every index; used when directory clusters are freed in bulk or
+// the volume changes.
+static void fat16_dindex_flush()
+{
+    for (int i = 0; i < DINDEX_DIRS; i++)
+        fat16_dindex_free(&dindex[i]);
+}
+
+static fat16_dindex_t *fat16_dindex_find(uint32_t dir_cluster)
+{
+    for (int i = 0; i < DINDEX_DIRS; i++)
+    {
+        if (dindex[i].valid && dindex[i].dir_cluster == dir_cluster)
+        {
+            dindex[i].last_use = ++dindex_clock;
+            return &dindex[i];
+        }
+    }
+
+    return 0;
+}
+
+// A directory was deleted; its cluster may be reused by another one.
+static void fat16_dindex_drop(uint32_t dir_cluster)
+{
+    fat16_dindex_t *ix = fat16_dindex_find(dir_cluster);
+    if (ix)
+        fat16_dindex_free(ix);
+}
+
+static int fat16_dindex_rehash(fat16_dindex_t *ix, uint32_t nbuckets)
+{
+    uint32_t *buckets = (uint32_t *)kmalloc(nbuckets * sizeof(uint32_t));
+    if (!buckets)
+        return 0;
+
+    for (uint32_t i = 0; i < nbuckets; i++)
+        buckets[i] = DINDEX_NIL;
+
+    for (uint32_t b = 0; b < ix->nbuckets; b++)
+    {
+        uint32_t n = ix->buckets[b];
+
+        while (n != DINDEX_NIL)
+        {
+            uint32_t next = ix->nodes[n].next;
+            uint32_t h = ix->nodes[n].hash & (nbuckets - 1);
+
+            ix->nodes[n].next = buckets[h];
+            buckets[h] = n;
+            n = next;
+        }
+    }
+
+    if (ix->buckets)
+        kfree(ix->buckets);
+
+    ix->buckets = buckets;
+    ix->nbuckets = nbuckets;
+    return 1;
+}
+
+static int fat16_dindex_insert(fat16_dindex_t *ix, uint32_t hash, const fat16_slot_t *first)
+{
+    uint32_t n = ix->free_list;
+
+    if (n != DINDEX_NIL)
+    {
+        ix->free_list = ix->nodes[n].next;
+    }
+    else
+    {
+        if (ix->unused == ix->capacity)
+        {
+            uint32_t capacity = ix->capacity * 2;
+            fat16_dindex_node_t *nodes =
+                (fat16_dindex_node_t *)kmalloc(capacity * sizeof(fat16_dindex_node_t));
+            if (!nodes)
+                return 0;
+
+            for (uint32_t i = 0; i < ix->unused; i++)
+                nodes[i] = ix->nodes[i];
+
+            kfree(ix->nodes);
+            ix->nodes = nodes;
+            ix->capacity = capacity;
+        }
+
+        n = ix->unused++;
+    }
+
+    uint32_t b = hash & (ix->nbuckets - 1);
+
+    ix->nodes[n].hash = hash;
+    ix->nodes[n].first = *first;
+    ix->nodes[n].next = ix->buckets[b];
+    ix->buckets[b] = n;
+    ix->count++;
+
+    // Keep chains short; a failed grow just leaves them longer.
+    if (ix->count > ix->nbuckets * 2)
+        fat16_dindex_rehash(ix, ix->nbuckets * 2);
+
+    return 1;
+}
+
+static void fat16_dindex_unlink(fat16_dindex_t *ix, uint32_t hash, const fat16_slot_t *first)
+{
+    uint32_t *link = &ix->buckets[hash & (ix->nbuckets - 1)];
+
+    while (*link != DINDEX_NIL)
+    {
+        fat16_dindex_node_t *node = &ix->nodes[*link];
+
+        if (node->hash == hash && fat16_slot_equal(&node->first, first))
+        {
+            uint32_t n = *link;
+            *link = node->next;
+
+            node->next = ix->free_list;
+            ix->free_list = n;
+            ix->count--;
+            return;
+        }
+
+        link = &node->next;
+    }
+}
+
+// Hash of an entry's 8.3 alias, when it differs from its long name.
+static int fat16_dirent_alias_hash(const fat16_dirent_t *d, uint32_t *out)
+{
+    if (d->slots <= 1)
+        return 0;
+
+    char alias[13];
+    fat16_short_to_name((const char *)&d->entry, 0, alias);
+
+    uint32_t h = fat16_name_hash(alias);
+    if (h == fat16_name_hash(d->name))
+        return 0;
+
+    *out = h;
+    return 1;
+}
+
+static int fat16_dindex_add(fat16_dindex_t *ix, const fat16_dirent_t *d)
+{
+    if (!fat16_dindex_insert(ix, fat16_name_hash(d->name), &d->first))
+        return 0;
+
+    uint32_t alias;
+    if (fat16_dirent_alias_hash(d, &alias) && !fat16_dindex_insert(ix, alias, &d->first))
+        return 0;
+
+    return 1;
+}
+
+static void fat16_dindex_remove(fat16_dindex_t *ix, const fat16_dirent_t *d)
+{
+    fat16_dindex_unlink(ix, fat16_name_hash(d->name), &d->first);
+
+    uint32_t alias;
+    if (fat16_dirent_alias_hash(d, &alias))
+        fat16_dindex_unlink(ix, alias, &d->first);
+}
+
+static fat16_dindex_t *fat16_dindex_build(uint32_t dir_cluster)
+{
+    fat16_dindex_t *ix = &dindex[0];
+
+    for (int i = 0; i < DINDEX_DIRS; i++)
+    {
+        if (!dindex[i].valid)
+        {
+            ix = &dindex[i];
+            break;
+        }
+
+        if (dindex[i].last_use < ix->last_use)
+            ix = &dindex[i];
+    }
+
+    fat16_dindex_free(ix);
+
+    ix->nbuckets = 0;
+    ix->capacity = DINDEX_MIN_BUCKETS;
+    ix->count = 0;
+    ix->unused = 0;
+    ix->free_list = DINDEX_NIL;
+    ix->nodes = (fat16_dindex_node_t *)kmalloc(ix->capacity * sizeof(fat16_dindex_node_t));
+
+    if (!ix->nodes || !fat16_dindex_rehash(ix, DINDEX_MIN_BUCKETS))
+    {
+        fat16_dindex_free(ix);
+        return 0;
+    }
+
+    dindex_stats.builds++;
+
+    fat16_dir_iter_t it;
+    fat16_dirent_t d;
+    fat16_iter_start(&it, dir_cluster);
+
+    while (fat16_dir_next(&it, &d))
+    {
+        if (!fat16_dindex_add(ix, &d))
+        {
+            fat16_dindex_free(ix);
+            return 0;
+        }
+    }
+
+    ix->end = it.marker_pos;
+    ix->end_valid = it.marker;
+    ix->holes = (it.deleted != 0);
+
+    ix->dir_cluster = dir_cluster;
+    ix->valid = 1;
+    ix->last_use = ++dindex_clock;
+    return ix;
+}
+
+/* ---------------- DIRECTORY LOOKUP ---------------- */
+
+// Linear scan, used only when no index could be built.
+static int fat16_dir_scan(uint32_t dir_cluster, const char *name, fat16_dirent_t *out)
+{
+    fat16_dir_iter_t it;
+    fat16_iter_start(&it, dir_cluster);
+
+    while (fat16_dir_next(&it, out))
+    {
+        if (fat16_dirent_matches(out, name))
+            return 1;
+    }
+
+    return 0;
+}
+
+static int fat16_dir_lookup(uint32_t dir_cluster, const char *name, fat16_dirent_t *out)
+{
+    fat16_dindex_t *ix = fat16_dindex_find(dir_cluster);
+
+    if (!ix)
+        ix = fat16_dindex_build(dir_cluster);
+
+    if (!ix)
+        return fat16_dir_scan(dir_cluster, name, out);
+
+    uint32_t h = fat16_name_hash(name);
+
+    for (uint32_t n = ix->buckets[h & (ix->nbuckets - 1)]; n != DINDEX_NIL; n = ix->nodes[n].next)
+    {
+        fat16_dindex_node_t *node = &ix->nodes[n];
+        if (node->hash != h)
+            continue;
+
+        fat16_dir_iter_t it;
+        fat16_iter_seek(&it, dir_cluster, &node->first);
+
+        if (fat16_dir_next(&it, out) && fat16_slot_equal(&out->first, &node->first) &&
+            fat16_dirent_matches(out, name))
+        {
+            dindex_stats.hits++;
+            return 1;
+        }
+    }
+
+    dindex_stats.negative_hits++;
+    return 0;
+}
+
+static int fat16_find_entry_location(uint32_t dir_cluster, const char *name,
+                                     uint32_t *out_sector, uint32_t *out_offset,
+                                     fat16_dir_entry_t *out_entry)
+{
+    fat16_dirent_t d;
+
+    if (!fat16_dir_lookup(dir_cluster, name, &d))
+        return 0;
+
+    if (out_sector) *out_sector = d.slot.lba;
+    if (out_offset) *out_offset = d.slot.offset;
+    if (out_entry) *out_entry = d.entry;
+    return 1;
+}
+
+static int fat16_find_entry(uint32_t dir_cluster, const char *name, fat16_dir_entry_t *out)
+{
+    return fat16_find_entry_location(dir_cluster, name, 0, 0, out);
+}
+
+/* ---------------- DIRECTORY UPDATES ---------------- */
+
+// Append a cleared cluster to a directory. The FAT16 root directory has a
+// fixed size and can't grow.
+static int fat16_dir_extend(uint32_t dir_cluster)
+{
+    uint32_t last = fat16_dir_chain(dir_cluster);
+    uint32_t next;
+
+    if (last == 0)
+        return 0;
+
+    while ((next = fat16_get_fat_entry(last)) >= 2 && next < vol.eoc_min)
+        last = next;
+
+    uint32_t cluster = fat16_alloc_cluster();
+    if (cluster == 0)
+        return 0;
+
+    fat16_clear_cluster(cluster);
+    fat16_set_fat_entry(last, cluster);
+    return 1;
+}
+
+// First of `slots` consecutive free slots, growing a subdirectory when it
+// is full.
+static int fat16_dir_find_free(uint32_t dir_cluster, uint32_t slots, fat16_slot_t *out)
+{
+    fat16_dindex_t *ix = fat16_dindex_find(dir_cluster);
+
+    for (uint32_t attempt = 0; attempt <= FAT16_LFN_MAX_SLOTS; attempt++)
+    {
+        fat16_dir_iter_t it;
+
+        if (ix && ix->end_valid && ix->holes == 0)
+            fat16_iter_seek(&it, dir_cluster, &ix->end);
+        else
+            fat16_iter_start(&it, dir_cluster);
+
+        uint32_t run = 0;
+        fat16_slot_t start = it.pos;
+
+        for (fat16_dir_entry_t *e; (e = fat16_iter_entry(&it)) != 0; fat16_iter_advance(&it))
+        {
+            if (e->name[0] != 0x00 && (uint8_t)e->name[0] != 0xE5)
+            {
+                run = 0;
+                continue;
+            }
+
+            if (run == 0)
+                start = it.pos;
+
+            if (++run == slots)
+            {
+                *out = start;
+                return 1;
+            }
+        }
+
+        if (!fat16_dir_extend(dir_cluster))
+            return 0;
+    }
+
+    return 0;
+}
+
+// Create an entry called `name` from `tmpl` (attributes, cluster, size),
+// adding long-name slots when the name isn't a plain 8.3 name. The caller
+// has checked that the name is not taken.
+static int fat16_dir_create(uint32_t dir_cluster, const char *name,
+                            const fat16_dir_entry_t *tmpl, fat16_dirent_t *out)
+{
+    if (!fat16_name_valid(name))
+        return 0;
+
+    fat16_dirent_t d;
+    d.entry = *tmpl;
+    d.slot.lba = 0;
+
+    char short11[11];
+    uint8_t nt = 0;
+    uint32_t len = strlen(name);
+    int need_lfn = !fat16_short_name(name, short11, &nt);
+
+    if (need_lfn)
+    {
+        char basis[11];
+        fat16_short_basis(name, basis);
+
+        uint32_t hash = fat16_name_hash(name);
+        uint32_t n;
+
+        for (n = 1; n <= 0x10000; n++)
+        {
+            fat16_dirent_t other;
+            char alias[13];
+
+            fat16_short_tail(basis, n, hash, short11);
+            fat16_short_to_name(short11, 0, alias);
+
+            if (!fat16_dir_lookup(dir_cluster, alias, &other))
+                break;
+        }
+
+        if (n > 0x10000)
+            return 0;
+
+        nt = 0;
+    }
+
+    d.slots = need_lfn ? 1 + (len + FAT16_LFN_CHARS - 1) / FAT16_LFN_CHARS : 1;
+
+    if (!fat16_dir_find_free(dir_cluster, d.slots, &d.first))
+        return 0;
+
+    for (int j = 0; j < 8; j++)
+        d.entry.name[j] = short11[j];
+    for (int j = 0; j < 3; j++)
+        d.entry.ext[j] = short11[8 + j];
+    d.entry.reserved = nt;
+
+    strcpy(d.name, name);
+
+    uint8_t checksum = fat16_lfn_checksum(short11);
+
+    fat16_dir_iter_t it;
+    fat16_iter_seek(&it, dir_cluster, &d.first);
+
+    for (uint32_t i = 0; i < d.slots; i++)
+    {
+        fat16_dir_entry_t *e = fat16_iter_entry(&it);
+        if (!e)
+            return 0;
+
+        if (i + 1 < d.slots)
+        {
+            uint32_t ord = d.slots - 1 - i;
+            fat16_lfn_fill((fat16_lfn_entry_t *)e, name, len, ord, i == 0, checksum);
+        }
+        else
+        {
+            *e = d.entry;
+            d.slot = it.pos;
+        }
+
+        bcache_write(it.pos.lba, it.sector);
+        fat16_iter_advance(&it);
+    }
+
+    fat16_dindex_t *ix = fat16_dindex_find(dir_cluster);
+    if (ix)
+    {
+        if (!fat16_dindex_add(ix, &d))
+            fat16_dindex_free(ix);
+        else if (ix->holes == 0)
+        {
+            // Without holes the entry went at the start of the free tail,
+            // which now begins right after it.
+            ix->end = it.pos;
+            ix->end_valid = !it.end;
+        }
+    }
+
+    if (out)
+        *out = d;
+
+    return 1;
+}
+
+// Mark all of an entry's slots deleted.
+static void fat16_dir_remove(uint32_t dir_cluster, const fat16_dirent_t *d)
+{
+    fat16_open_files_detach(d->slot.lba, d->slot.offset);
+
+    fat16_dir_iter_t it;
+    fat16_iter_seek(&it, dir_cluster, &d->first);
+
+    for (uint32_t i = 0; i < d->slots; i++)
+    {
+        fat16_dir_entry_t *e = fat16_iter_entry(&it);
+        if (!e)
+            break;
+
+        e->name[0] = (char)0xE5;
+        bcache_write(it.pos.lba, it.sector);
+        fat16_iter_advance(&it);
+    }
+
+    fat16_dindex_t *ix = fat16_dindex_find(dir_cluster);
+    if (ix)
+    {
+        fat16_dindex_remove(ix, d);
+        ix->holes = 1;
+    }
+}
+
+// Template for a new entry: everything but the name.
+static void fat16_entry_template(fat16_dir_entry_t *entry, uint8_t attr, uint32_t cluster, uint32_t size)
+{
+    for (int i = 0; i < 32; i++)
+        ((uint8_t *)entry)[i] = 0;
+
+    entry->attr = attr;
+    fat16_entry_set_cluster(entry, cluster);
+    entry->file_size = size;
+}
+
+static int fat16_resolve_absolute(const char *path, uint32_t *out_cluster)
+{
+    if (!path || path[0] != '/')
+        return 0;
+
+    uint32_t cluster = 0;
+    path++;
+
+    char part[FAT16_NAME_MAX + 1];
+    int pi = 0;
 
     for (int i = 0;; i++)
     {
@@ -600,7 +1926,7 @@ static int fat16_resolve_absolute(const char *path, uint16_t *out_cluster)
                 if (!(entry.attr & 0x10))
                     return 0;
 
-                cluster = entry.first_cluster_low;
+                cluster = fat16_entry_cluster(&entry);
             }
 
             pi = 0;
@@ -610,7 +1936,7 @@ static int fat16_resolve_absolute(const char *path, uint16_t *out_cluster)
         }
         else
         {
-            if (pi < 31)
+            if (pi < FAT16_NAME_MAX)
                 part[pi++] = c;
         }
     }
@@ -653,7 +1979,7 @@ static int fat16_split_path(const char *path, char *parent_out, char *name_out)
     int ni = 0;
     for (int i = slash + 1; path[i] != '\0'; i++)
     {
-        if (ni < 31)
+        if (ni < FAT16_NAME_MAX)
             name_out[ni++] = path[i];
     }
     name_out[ni] = '\0';
@@ -664,369 +1990,276 @@ static int fat16_split_path(const char *path, char *parent_out, char *name_out)
     return 1;
 }
 
-/* ------------------- FAT16 Public API ------------------- */
-
-int fat16_init()
+// Resolve everything but the last component of `path`: the parent's
+// directory cluster and the final name.
+static int fat16_resolve_parent(const char *path, uint32_t *parent_cluster, char *name_out)
 {
-    uint8_t sector[512];
-    ata_read_sector(0, sector);
-
-    bpb.bytes_per_sector = *(uint16_t *)&sector[11];
-    bpb.sectors_per_cluster = sector[13];
-    bpb.reserved_sectors = *(uint16_t *)&sector[14];
-    bpb.num_fats = sector[16];
-    bpb.root_entries = *(uint16_t *)&sector[17];
-    bpb.total_sectors_16 = *(uint16_t *)&sector[19];
-    bpb.sectors_per_fat = *(uint16_t *)&sector[22];
-    bpb.total_sectors_32 = *(uint32_t *)&sector[32];
-
-    if (sector[510] != 0x55 || sector[511] != 0xAA)
-        return 0;
-
-    if (bpb.bytes_per_sector != 512)
+    if (!path || path[0] == '\0')
         return 0;
 
-    return 1;
-}
-
-fat16_bpb_t fat16_get_bpb()
-{
-    return bpb;
-}
+    char abs[128];
+    fat16_normalize_path(path, abs);
 
-void fat16_pwd()
-{
-    print("\n");
-    print(current_path);
-    print("\n");
-}
+    char parent_path[128];
+    if (!fat16_split_path(abs, parent_path, name_out))
+        return 0;
 
-const char *fat16_get_path()
-{
-    return current_path;
+    return fat16_resolve_absolute(parent_path, parent_cluster);
 }
 
-/* ---------------- ls ---------------- */
+/* ------------------- FAT16 Public API ------------------- */
 
-void fat16_ls()
+// Parse the boot sector at LBA 0 into `out` and derive the layout.
+static int fat16_read_volume(fat16_volume_t *out)
 {
     uint8_t sector[512];
+    bcache_read(0, sector);
 
-    if (current_dir_cluster == 0)
-    {
-        uint32_t root_start = fat16_root_start_sector();
-        uint32_t root_sectors = fat16_root_dir_sectors();
-
-        for (uint32_t s = 0; s < root_sectors; s++)
-        {
-            ata_read_sector(root_start + s, sector);
-
-            for (int i = 0; i < 512; i += 32)
-            {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
-
-                if (entry->name[0] == 0x00)
-                    return;
-
-                if ((uint8_t)entry->name[0] == 0xE5)
-                    continue;
-
-                if (entry->attr == 0x0F)
-                    continue;
+    if (sector[510] != 0x55 || sector[511] != 0xAA)
+        return 0;
 
-                char filename[13];
-                fat16_entry_to_name(entry, filename);
+    fat16_bpb_t *b = &out->bpb;
 
-                if (entry->attr & 0x10)
-                {
-                    print("DIR   ");
-                    print(filename);
-                    print("\n");
-                }
-                else
-                {
-                    print("FILE  ");
-                    print(filename);
-                    print("  ");
-                    print_uint(entry->file_size);
-                    print(" bytes\n");
-                }
-            }
-        }
+    b->bytes_per_sector = *(uint16_t *)&sector[11];
+    b->sectors_per_cluster = sector[13];
+    b->reserved_sectors = *(uint16_t *)&sector[14];
+    b->num_fats = sector[16];
+    b->root_entries = *(uint16_t *)&sector[17];
+    b->total_sectors_16 = *(uint16_t *)&sector[19];
+    b->sectors_per_fat = *(uint16_t *)&sector[22];
+    b->total_sectors_32 = *(uint32_t *)&sector[32];
+    b->root_cluster = 0;
+    b->fsinfo_sector = 0;
 
-        return;
+    // FAT32 leaves the 16-bit FAT size at zero and extends the BPB.
+    out->fat_bits = 16;
+    if (b->sectors_per_fat == 0)
+    {
+        out->fat_bits = 32;
+        b->sectors_per_fat = *(uint32_t *)&sector[36];
+        b->root_cluster = *(uint32_t *)&sector[44];
+        b->fsinfo_sector = *(uint16_t *)&sector[48];
     }
 
-    uint16_t cluster = current_dir_cluster;
+    if (b->bytes_per_sector != 512)
+        return 0;
 
-    while (cluster < 0xFFF8)
-    {
-        uint32_t start_sector = fat16_cluster_to_sector(cluster);
+    if (b->sectors_per_cluster == 0 || b->num_fats == 0 || b->sectors_per_fat == 0)
+        return 0;
 
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
-        {
-            ata_read_sector(start_sector + s, sector);
+    if (out->fat_bits == 32 && (b->root_entries != 0 || b->root_cluster < 2))
+        return 0;
 
-            for (int i = 0; i < 512; i += 32)
-            {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
+    out->eoc = (out->fat_bits == 32) ? 0x0FFFFFFF : 0xFFFF;
+    out->eoc_min = (out->fat_bits == 32) ? 0x0FFFFFF8 : 0xFFF8;
 
-                if (entry->name[0] == 0x00)
-                    return;
+    out->fat_start = b->reserved_sectors;
+    out->root_start = out->fat_start + (uint32_t)b->num_fats * b->sectors_per_fat;
+    out->root_sectors = ((uint32_t)b->root_entries * 32 + (b->bytes_per_sector - 1)) / b->bytes_per_sector;
+    out->data_start = out->root_start + out->root_sectors;
+    out->cluster_bytes = (uint32_t)b->sectors_per_cluster * b->bytes_per_sector;
 
-                if ((uint8_t)entry->name[0] == 0xE5)
-                    continue;
+    uint32_t total_sectors = (b->total_sectors_16 != 0) ? b->total_sectors_16 : b->total_sectors_32;
+    if (total_sectors <= out->data_start)
+        return 0;
 
-                if (entry->attr == 0x0F)
-                    continue;
+    out->total_clusters = (total_sectors - out->data_start) / b->sectors_per_cluster;
 
-                char filename[13];
-                fat16_entry_to_name(entry, filename);
+    if (out->fat_bits == 32 && b->root_cluster >= out->total_clusters + 2)
+        return 0;
 
-                if (entry->attr & 0x10)
-                {
-                    print("DIR   ");
-                    print(filename);
-                    print("\n");
-                }
-                else
-                {
-                    print("FILE  ");
-                    print(filename);
-                    print("  ");
-                    print_uint(entry->file_size);
-                    print(" bytes\n");
-                }
-            }
-        }
+    out->mounted = 1;
 
-        cluster = fat16_get_fat_entry(cluster);
-    }
+    return 1;
 }
 
-int fat16_ls_path(const char *path)
+int fat16_mount()
 {
-    char abs[128];
-    fat16_normalize_path(current_path, path, abs);
+    if (vol.mounted)
+        return 1;
 
-    uint16_t dir_cluster;
-    if (!fat16_resolve_absolute(abs, &dir_cluster))
+    if (!fat16_read_volume(&vol))
+    {
+        vol.mounted = 0;
         return 0;
+    }
 
-    uint16_t saved = current_dir_cluster;
-    current_dir_cluster = dir_cluster;
-    fat16_ls();
-    current_dir_cluster = saved;
-
+    fat16_load_fat();
     return 1;
 }
 
-/* ---------------- cd ---------------- */
-
-int fat16_cd_path(const char *path)
+int fat16_remount()
 {
-    if (!path || path[0] == '\0')
-        return 0;
+    if (vol.mounted)
+        fat16_sync();
 
-    char abs[128];
-    fat16_normalize_path(current_path, path, abs);
-
-    uint16_t new_cluster;
-    if (!fat16_resolve_absolute(abs, &new_cluster))
-        return 0;
-
-    current_dir_cluster = new_cluster;
-    strcpy(current_path, abs);
+    fat16_unload_fat();
+    fat16_dindex_flush();
+    vol.mounted = 0;
 
-    return 1;
+    return fat16_mount();
 }
 
-/* ---------------- cat ---------------- */
-
-int fat16_cat(const char *path)
+// Callers use this as "make sure the volume is usable"; after the first
+// successful mount it costs nothing.
+int fat16_init()
 {
-    if (!path || path[0] == '\0')
-        return 0;
-
-    char abs[128];
-    fat16_normalize_path(current_path, path, abs);
+    if (vol.mounted)
+        return 1;
 
-    char parent_path[128];
-    char filename[32];
+    return fat16_mount();
+}
 
-    if (!fat16_split_path(abs, parent_path, filename))
-        return 0;
+const fat16_volume_t *fat16_get_volume()
+{
+    return &vol;
+}
 
-    uint16_t parent_cluster;
-    if (!fat16_resolve_absolute(parent_path, &parent_cluster))
-        return 0;
+fat16_bpb_t fat16_get_bpb()
+{
+    return vol.bpb;
+}
 
-    fat16_dir_entry_t entry;
-    if (!fat16_find_entry(parent_cluster, filename, &entry))
-        return 0;
+void fat16_set_durability(int mode)
+{
+    if (mode < FAT16_DURABILITY_LAZY || mode > FAT16_DURABILITY_FLUSH)
+        return;
 
-    if (entry.attr & 0x10)
-        return 0;
+    durability = mode;
 
-    uint32_t remaining = entry.file_size;
-    uint16_t cluster = entry.first_cluster_low;
-    uint8_t buf[512];
+    // Nothing written under a weaker mode should stay behind.
+    fat16_commit();
+}
 
-    print("\n");
+int fat16_get_durability()
+{
+    return durability;
+}
 
-    // Empty file: FAT16 commonly stores first_cluster_low = 0.
-    if (remaining == 0)
-        return 1;
+uint32_t fat16_free_clusters()
+{
+    if (free_known)
+        return free_count;
 
-    // Non-empty file must have a valid data cluster (>= 2).
-    if (cluster < 2)
-        return 0;
+    uint32_t per_sector = 512 / fat16_entry_bytes();
+    uint8_t sector[512];
+    uint32_t count = 0;
 
-    while (cluster < 0xFFF8)
+    for (uint32_t cluster = 2; cluster < fat_limit; cluster++)
     {
-        uint32_t sector_num = fat16_cluster_to_sector(cluster);
-
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
-        {
-            ata_read_sector(sector_num + s, buf);
+        if (cluster == 2 || cluster % per_sector == 0)
+            bcache_read(vol.fat_start + cluster / per_sector, sector);
 
-            for (int i = 0; i < 512; i++)
-            {
-                if (remaining == 0)
-                {
-                    print("\n");
-                    return 1;
-                }
+        if (fat16_raw_get(sector, (cluster % per_sector) * fat16_entry_bytes()) == 0)
+            count++;
+    }
 
-                char c = (char)buf[i];
+    // Counted once; kept up to date from here on.
+    free_count = count;
+    free_known = 1;
+    return count;
+}
 
-                if (c == '\n' || c == '\r' || (c >= 32 && c <= 126))
-                    print_char(c);
-                else
-                    print_char('.');
+fat16_dindex_stats_t fat16_get_dindex_stats()
+{
+    return dindex_stats;
+}
 
-                remaining--;
-            }
-        }
+int fat16_sync()
+{
+    fat16_flush_open_files();
+    fat16_flush_fat();
 
-        cluster = fat16_get_fat_entry(cluster);
-    }
+    int ok = bcache_sync();
+    if (!blk_flush())
+        ok = 0;
 
-    print("\n");
-    return 1;
+    return ok;
 }
 
 /* ---------------- touch ---------------- */
 
-int fat16_touch(const char *filename)
+int fat16_touch(const char *path)
 {
-    if (!filename || filename[0] == '\0')
+    uint32_t parent_cluster;
+    char filename[FAT16_NAME_MAX + 1];
+
+    if (!fat16_resolve_parent(path, &parent_cluster, filename))
         return 0;
 
     fat16_dir_entry_t existing;
-    if (fat16_find_entry(current_dir_cluster, filename, &existing))
+    if (fat16_find_entry(parent_cluster, filename, &existing))
         return 0;
 
-    uint32_t free_sector;
-    uint32_t free_offset;
+    fat16_dir_entry_t tmpl;
+    fat16_entry_template(&tmpl, 0x20, 0, 0);
 
-    if (!fat16_find_free_dir_entry(current_dir_cluster, &free_sector, &free_offset))
+    if (!fat16_dir_create(parent_cluster, filename, &tmpl, 0))
         return 0;
 
-    uint8_t sector[512];
-    ata_read_sector(free_sector, sector);
-
-    fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[free_offset];
-
-    for (int i = 0; i < 32; i++)
-        ((uint8_t *)entry)[i] = 0;
-
-    char fatname[11];
-    fat16_format_filename(filename, fatname);
-
-    for (int j = 0; j < 8; j++)
-        entry->name[j] = fatname[j];
-
-    for (int j = 0; j < 3; j++)
-        entry->ext[j] = fatname[8 + j];
-
-    entry->attr = 0x20;
-    entry->first_cluster_low = 0;
-    entry->file_size = 0;
-
-    ata_write_sector(free_sector, sector);
-
+    fat16_commit();
     return 1;
 }
 
 /* ---------------- mkdir ---------------- */
 
-int fat16_mkdir(const char *dirname)
+static int fat16_mkdir_in(uint32_t parent_cluster, const char *dirname)
 {
-    if (!dirname || dirname[0] == '\0')
+    fat16_dir_entry_t existing;
+    if (fat16_find_entry(parent_cluster, dirname, &existing))
         return 0;
 
-    fat16_dir_entry_t existing;
-    if (fat16_find_entry(current_dir_cluster, dirname, &existing))
+    if (!fat16_name_valid(dirname))
         return 0;
 
-    uint16_t new_cluster = fat16_alloc_cluster();
+    uint32_t new_cluster = fat16_alloc_cluster();
     if (new_cluster == 0)
         return 0;
 
     fat16_clear_cluster(new_cluster);
 
     uint8_t sector[512];
-    ata_read_sector(fat16_cluster_to_sector(new_cluster), sector);
+    bcache_read(fat16_cluster_to_sector(new_cluster), sector);
 
     fat16_dir_entry_t *dot = (fat16_dir_entry_t *)&sector[0];
     fat16_dir_entry_t *dotdot = (fat16_dir_entry_t *)&sector[32];
 
-    for (int i = 0; i < 32; i++)
-        ((uint8_t *)dot)[i] = 0;
-    for (int i = 0; i < 32; i++)
-        ((uint8_t *)dotdot)[i] = 0;
-
+    fat16_entry_template(dot, 0x10, new_cluster, 0);
     for (int i = 0; i < 11; i++)
         ((uint8_t *)dot)[i] = ' ';
     dot->name[0] = '.';
-    dot->attr = 0x10;
-    dot->first_cluster_low = new_cluster;
 
+    fat16_entry_template(dotdot, 0x10, parent_cluster, 0);
     for (int i = 0; i < 11; i++)
         ((uint8_t *)dotdot)[i] = ' ';
     dotdot->name[0] = '.';
     dotdot->name[1] = '.';
-    dotdot->attr = 0x10;
-    dotdot->first_cluster_low = current_dir_cluster;
 
-    ata_write_sector(fat16_cluster_to_sector(new_cluster), sector);
+    bcache_write(fat16_cluster_to_sector(new_cluster), sector);
 
-    uint32_t free_sector;
-    uint32_t free_offset;
+    fat16_dir_entry_t tmpl;
+    fat16_entry_template(&tmpl, 0x10, new_cluster, 0);
 
-    if (!fat16_find_free_dir_entry(current_dir_cluster, &free_sector, &free_offset))
+    if (!fat16_dir_create(parent_cluster, dirname, &tmpl, 0))
+    {
+        fat16_free_cluster_chain(new_cluster);
+        fat16_commit();
         return 0;
+    }
 
-    ata_read_sector(free_sector, sector);
-
-    fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[free_offset];
-
-    char fatname[11];
-    fat16_format_filename(dirname, fatname);
-
-    for (int j = 0; j < 8; j++)
-        entry->name[j] = fatname[j];
-    for (int j = 0; j < 3; j++)
-        entry->ext[j] = fatname[8 + j];
+    fat16_commit();
+    return 1;
+}
 
-    entry->attr = 0x10;
-    entry->first_cluster_low = new_cluster;
-    entry->file_size = 0;
+int fat16_mkdir(const char *path)
+{
+    uint32_t parent_cluster;
+    char dirname[FAT16_NAME_MAX + 1];
 
-    ata_write_sector(free_sector, sector);
+    if (!fat16_resolve_parent(path, &parent_cluster, dirname))
+        return 0;
 
-    return 1;
+    return fat16_mkdir_in(parent_cluster, dirname);
 }
 
 int fat16_mkdir_p(const char *path)
@@ -1035,10 +2268,10 @@ int fat16_mkdir_p(const char *path)
         return 0;
 
     char abs[128];
-    fat16_normalize_path(current_path, path, abs);
+    fat16_normalize_path(path, abs);
 
-    uint16_t cluster = 0;
-    char part[32];
+    uint32_t cluster = 0;
+    char part[FAT16_NAME_MAX + 1];
     int pi = 0;
 
     const char *p = abs + 1;
@@ -1055,1077 +2288,1491 @@ int fat16_mkdir_p(const char *path)
             {
                 fat16_dir_entry_t entry;
 
-                if (fat16_find_entry(cluster, part, &entry))
+                if (!fat16_find_entry(cluster, part, &entry))
                 {
-                    if (!(entry.attr & 0x10))
+                    if (!fat16_mkdir_in(cluster, part) ||
+                        !fat16_find_entry(cluster, part, &entry))
                         return 0;
-
-                    cluster = entry.first_cluster_low;
                 }
-                else
-                {
-                    uint16_t old = current_dir_cluster;
-                    current_dir_cluster = cluster;
 
-                    if (!fat16_mkdir(part))
-                    {
-                        current_dir_cluster = old;
-                        return 0;
-                    }
-
-                    current_dir_cluster = old;
-
-                    if (!fat16_find_entry(cluster, part, &entry))
-                        return 0;
+                if (!(entry.attr & 0x10))
+                    return 0;
 
-                    cluster = entry.first_cluster_low;
-                }
+                cluster = fat16_entry_cluster(&entry);
             }
 
             pi = 0;
             if (c == '\0')
                 break;
         }
-        else
+        else
+        {
+            if (pi < FAT16_NAME_MAX)
+                part[pi++] = c;
+        }
+    }
+
+    return 1;
+}
+
+/* ---------------- rm / rmdir ---------------- */
+
+int fat16_rm(const char *path)
+{
+    uint32_t parent_cluster;
+    char filename[FAT16_NAME_MAX + 1];
+
+    if (!fat16_resolve_parent(path, &parent_cluster, filename))
+        return 0;
+
+    // Pending entry updates must land before the entry is rewritten.
+    fat16_flush_open_files();
+
+    fat16_dirent_t d;
+    if (!fat16_dir_lookup(parent_cluster, filename, &d))
+        return 0;
+
+    if (d.entry.attr & 0x10)
+        return -1;
+
+    if (fat16_entry_cluster(&d.entry) != 0)
+        fat16_free_cluster_chain(fat16_entry_cluster(&d.entry));
+
+    fat16_dir_remove(parent_cluster, &d);
+
+    fat16_commit();
+    return 1;
+}
+
+static int fat16_is_dir_empty(uint32_t dir_cluster)
+{
+    fat16_dir_iter_t it;
+    fat16_dirent_t d;
+    fat16_iter_start(&it, dir_cluster);
+
+    while (fat16_dir_next(&it, &d))
+    {
+        if (!fat16_is_dot_entry(&d.entry))
+            return 0;
+    }
+
+    return 1;
+}
+
+int fat16_rmdir(const char *path)
+{
+    uint32_t parent_cluster;
+    char dirname[FAT16_NAME_MAX + 1];
+
+    if (!fat16_resolve_parent(path, &parent_cluster, dirname))
+        return 0;
+
+    fat16_dirent_t d;
+    if (!fat16_dir_lookup(parent_cluster, dirname, &d))
+        return 0;
+
+    if (!(d.entry.attr & 0x10))
+        return -1;
+
+    uint32_t dir_cluster = fat16_entry_cluster(&d.entry);
+
+    if (dir_cluster == 0)
+        return 0;
+
+    if (!fat16_is_dir_empty(dir_cluster))
+        return -2;
+
+    fat16_free_cluster_chain(dir_cluster);
+    fat16_dindex_drop(dir_cluster);
+
+    fat16_dir_remove(parent_cluster, &d);
+
+    fat16_commit();
+    return 1;
+}
+
+/* -------- recursive delete helper -------- */
+
+static int fat16_delete_dir_recursive(uint32_t dir_cluster)
+{
+    fat16_slot_t pos;
+    int done = 0;
+    fat16_dirent_t d;
+
+    fat16_dir_start_pos(dir_cluster, &pos);
+
+    while (fat16_dir_next_at(dir_cluster, &pos, &done, &d))
+    {
+        if (fat16_is_dot_entry(&d.entry))
+            continue;
+
+        if (d.entry.attr & 0x10)
+        {
+            uint32_t sub = fat16_entry_cluster(&d.entry);
+            if (sub >= 2)
+                fat16_delete_dir_recursive(sub);
+        }
+        else if (fat16_entry_cluster(&d.entry) != 0)
         {
-            if (pi < 31)
-                part[pi++] = c;
+            fat16_free_cluster_chain(fat16_entry_cluster(&d.entry));
         }
+
+        fat16_dir_remove(dir_cluster, &d);
     }
 
+    fat16_free_cluster_chain(dir_cluster);
     return 1;
 }
 
-/* ---------------- rm / rmdir ---------------- */
-
-int fat16_rm(const char *filename)
+int fat16_rm_rf(const char *path)
 {
-    if (!filename || filename[0] == '\0')
+    if (!path || path[0] == '\0')
         return 0;
 
-    uint32_t entry_sector;
-    uint32_t entry_offset;
-    fat16_dir_entry_t entry;
+    // Pending entry updates must land before the entry is rewritten.
+    fat16_flush_open_files();
 
-    if (!fat16_find_entry_location(current_dir_cluster, filename,
-                                   &entry_sector, &entry_offset, &entry))
-    {
+    char abs[128];
+    fat16_normalize_path(path, abs);
+
+    if (strcmp(abs, "/") == 0)
         return 0;
-    }
 
-    if (entry.attr & 0x10)
-        return -1;
+    char parent_path[128];
+    char target_name[FAT16_NAME_MAX + 1];
 
-    if (entry.first_cluster_low != 0)
-        fat16_free_cluster_chain(entry.first_cluster_low);
+    if (!fat16_split_path(abs, parent_path, target_name))
+        return 0;
 
-    uint8_t sector[512];
-    ata_read_sector(entry_sector, sector);
+    uint32_t parent_cluster;
+    if (!fat16_resolve_absolute(parent_path, &parent_cluster))
+        return 0;
+
+    fat16_dirent_t d;
+    if (!fat16_dir_lookup(parent_cluster, target_name, &d))
+        return 0;
+
+    if (!(d.entry.attr & 0x10))
+    {
+        if (fat16_entry_cluster(&d.entry) != 0)
+            fat16_free_cluster_chain(fat16_entry_cluster(&d.entry));
+
+        fat16_dir_remove(parent_cluster, &d);
+        fat16_commit();
+        return 1;
+    }
 
-    fat16_dir_entry_t *disk_entry = (fat16_dir_entry_t *)&sector[entry_offset];
-    disk_entry->name[0] = 0xE5;
+    uint32_t dir_cluster = fat16_entry_cluster(&d.entry);
+    if (dir_cluster < 2)
+        return 0;
+
+    fat16_delete_dir_recursive(dir_cluster);
+    fat16_dir_remove(parent_cluster, &d);
 
-    ata_write_sector(entry_sector, sector);
+    // Any of the freed directory clusters may come back as a new directory.
+    fat16_dindex_flush();
 
+    fat16_commit();
     return 1;
 }
 
-static int fat16_is_dir_empty(uint16_t dir_cluster)
+/* ---------------- WRITE FILE ---------------- */
+
+int fat16_write_file(const char *path, const uint8_t *data, uint32_t size)
 {
-    uint8_t sector[512];
-    uint16_t cluster = dir_cluster;
+    if (!path || path[0] == '\0')
+        return 0;
 
-    while (cluster < 0xFFF8)
-    {
-        uint32_t start_sector = fat16_cluster_to_sector(cluster);
+    // Pending entry updates must land before the entry is rewritten.
+    fat16_flush_open_files();
 
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
-        {
-            ata_read_sector(start_sector + s, sector);
+    char abs[128];
+    fat16_normalize_path(path, abs);
 
-            for (int i = 0; i < 512; i += 32)
-            {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
+    char parent_path[128];
+    char filename[FAT16_NAME_MAX + 1];
 
-                if (entry->name[0] == 0x00)
-                    return 1;
+    if (!fat16_split_path(abs, parent_path, filename))
+        return 0;
 
-                if ((uint8_t)entry->name[0] == 0xE5)
-                    continue;
+    uint32_t parent_cluster;
+    if (!fat16_resolve_absolute(parent_path, &parent_cluster))
+        return 0;
 
-                if (entry->attr == 0x0F)
-                    continue;
+    uint32_t entry_sector = 0;
+    uint32_t entry_offset = 0;
+    fat16_dir_entry_t entry;
+    int exists = fat16_find_entry_location(parent_cluster, filename,
+                                           &entry_sector, &entry_offset, &entry);
 
-                if (entry->name[0] == '.' &&
-                    (entry->name[1] == ' ' || entry->name[1] == '.'))
-                    continue;
+    if (exists)
+    {
+        if (entry.attr & 0x10)
+            return 0;
 
-                return 0;
-            }
-        }
+        if (fat16_entry_cluster(&entry) != 0)
+            fat16_free_cluster_chain(fat16_entry_cluster(&entry));
+    }
+    else
+    {
+        fat16_dir_entry_t tmpl;
+        fat16_entry_template(&tmpl, 0x20, 0, 0);
 
-        cluster = fat16_get_fat_entry(cluster);
+        fat16_dirent_t d;
+        if (!fat16_dir_create(parent_cluster, filename, &tmpl, &d))
+            return 0;
+
+        entry_sector = d.slot.lba;
+        entry_offset = d.slot.offset;
     }
 
-    return 1;
-}
+    uint32_t first_cluster = 0;
+    uint32_t prev_cluster = 0;
 
-int fat16_rmdir(const char *dirname)
-{
-    if (!dirname || dirname[0] == '\0')
-        return 0;
+    uint32_t remaining = size;
+    uint32_t written = 0;
+    int ok = 1;
 
-    uint32_t entry_sector;
-    uint32_t entry_offset;
-    fat16_dir_entry_t entry;
+    // Queue the whole chain's data and let the block layer merge
+    // neighbouring clusters into multi-sector commands.
+    blk_plug();
 
-    if (!fat16_find_entry_location(current_dir_cluster, dirname,
-                                   &entry_sector, &entry_offset, &entry))
+    while (ok && remaining > 0)
     {
-        return 0;
-    }
+        // Ask for the whole remainder as one run, continuing the chain
+        // in place when the next cluster is free.
+        uint32_t want = (remaining + vol.cluster_bytes - 1) / vol.cluster_bytes;
+        uint32_t got = 0;
 
-    if (!(entry.attr & 0x10))
-        return -1;
+        uint32_t run = fat16_alloc_run(want, prev_cluster ? prev_cluster + 1 : 0, &got);
+        if (run == 0)
+        {
+            // Disk full: the entry keeps what fit, so it never points at
+            // the chain freed above.
+            ok = 0;
+            break;
+        }
 
-    uint16_t dir_cluster = entry.first_cluster_low;
+        if (first_cluster == 0)
+            first_cluster = run;
 
-    if (dir_cluster == 0)
-        return 0;
+        if (prev_cluster != 0)
+            fat16_set_fat_entry(prev_cluster, run);
 
-    if (!fat16_is_dir_empty(dir_cluster))
-        return -2;
+        prev_cluster = (uint32_t)(run + got - 1);
 
-    fat16_free_cluster_chain(dir_cluster);
+        uint32_t n = fat16_fill_run(run, got, data + written, remaining);
+        if (n == 0)
+        {
+            ok = 0;
+            break;
+        }
 
-    uint8_t sector[512];
-    ata_read_sector(entry_sector, sector);
+        written += n;
+        remaining -= n;
+    }
 
-    fat16_dir_entry_t *disk_entry = (fat16_dir_entry_t *)&sector[entry_offset];
-    disk_entry->name[0] = 0xE5;
+    if (!blk_unplug())
+        ok = 0;
 
-    ata_write_sector(entry_sector, sector);
+    uint8_t secbuf[512];
+    bcache_read(entry_sector, secbuf);
 
-    return 1;
+    fat16_dir_entry_t *disk_entry = (fat16_dir_entry_t *)&secbuf[entry_offset];
+    fat16_entry_set_cluster(disk_entry, first_cluster);
+    disk_entry->file_size = written;
+
+    bcache_write(entry_sector, secbuf);
+
+    // Files open on the old chain now see the new one.
+    fat16_open_files_reload(entry_sector, entry_offset);
+
+    fat16_commit();
+    return ok;
 }
 
-/* -------- recursive delete helper -------- */
+/* ---------------- APPEND FILE ---------------- */
 
-static int fat16_delete_dir_recursive(uint16_t dir_cluster)
+int fat16_append_file(const char *path, const uint8_t *data, uint32_t size)
 {
-    uint8_t sector[512];
-    uint16_t cluster = dir_cluster;
-
-    while (cluster < 0xFFF8)
-    {
-        uint32_t start_sector = fat16_cluster_to_sector(cluster);
+    fat16_file_t file;
 
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
-        {
-            ata_read_sector(start_sector + s, sector);
+    if (!fat16_open(path, &file))
+        return fat16_write_file(path, data, size);
 
-            for (int i = 0; i < 512; i += 32)
-            {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
+    // Extends the chain with a contiguous run right after the current tail.
+    uint32_t written;
+    int ok = fat16_file_write(&file, file.size, data, size, &written);
 
-                if (entry->name[0] == 0x00)
-                    goto done;
+    fat16_file_close(&file);
+    return ok;
+}
 
-                if ((uint8_t)entry->name[0] == 0xE5)
-                    continue;
+static int fat16_get_file_size_internal(const char *path, uint32_t *out_size)
+{
+    if (!path || path[0] == '\0')
+        return 0;
 
-                if (entry->attr == 0x0F)
-                    continue;
+    char abs[128];
+    fat16_normalize_path(path, abs);
 
-                if (entry->name[0] == '.' &&
-                    (entry->name[1] == ' ' || entry->name[1] == '.'))
-                    continue;
+    char parent_path[128];
+    char filename[FAT16_NAME_MAX + 1];
 
-                if (entry->attr & 0x10)
-                {
-                    uint16_t sub = entry->first_cluster_low;
-                    if (sub >= 2)
-                        fat16_delete_dir_recursive(sub);
+    if (!fat16_split_path(abs, parent_path, filename))
+        return 0;
 
-                    entry->name[0] = 0xE5;
-                    ata_write_sector(start_sector + s, sector);
-                }
-                else
-                {
-                    if (entry->first_cluster_low != 0)
-                        fat16_free_cluster_chain(entry->first_cluster_low);
+    uint32_t parent_cluster;
+    if (!fat16_resolve_absolute(parent_path, &parent_cluster))
+        return 0;
 
-                    entry->name[0] = 0xE5;
-                    ata_write_sector(start_sector + s, sector);
-                }
-            }
-        }
+    fat16_dir_entry_t entry;
+    if (!fat16_find_entry(parent_cluster, filename, &entry))
+        return 0;
 
-        cluster = fat16_get_fat_entry(cluster);
-    }
+    if (entry.attr & 0x10)
+        return 0;
 
-done:
-    fat16_free_cluster_chain(dir_cluster);
+    *out_size = entry.file_size;
     return 1;
 }
 
-int fat16_rm_rf(const char *path)
+static int fat16_is_directory(const char *path)
 {
     if (!path || path[0] == '\0')
         return 0;
 
     char abs[128];
-    fat16_normalize_path(current_path, path, abs);
+    fat16_normalize_path(path, abs);
 
+    // root is directory
     if (strcmp(abs, "/") == 0)
-        return 0;
+        return 1;
 
     char parent_path[128];
-    char target_name[32];
+    char filename[FAT16_NAME_MAX + 1];
 
-    if (!fat16_split_path(abs, parent_path, target_name))
+    if (!fat16_split_path(abs, parent_path, filename))
         return 0;
 
-    uint16_t parent_cluster;
+    uint32_t parent_cluster;
     if (!fat16_resolve_absolute(parent_path, &parent_cluster))
         return 0;
 
-    uint32_t entry_sector;
-    uint32_t entry_offset;
     fat16_dir_entry_t entry;
+    if (!fat16_find_entry(parent_cluster, filename, &entry))
+        return 0;
 
-    if (!fat16_find_entry_location(parent_cluster, target_name,
-                                   &entry_sector, &entry_offset, &entry))
+    return (entry.attr & 0x10) ? 1 : 0;
+}
+
+/* ---------------- COPY + MOVE ---------------- */
+
+// Copy one file through `buf` (FAT16_CP_CHUNK bytes): each chunk is read
+// with multi-sector transfers and written back in place, so memory use
+// doesn't depend on the file size.
+static int fat16_cp_file(const char *src_abs, const char *dst_abs, uint8_t *buf)
+{
+    fat16_file_t in;
+    if (!fat16_open(src_abs, &in))
         return 0;
 
-    if (!(entry.attr & 0x10))
+    // Create or truncate the destination, then stream into it.
+    fat16_file_t out;
+    if (!fat16_write_file(dst_abs, (const uint8_t *)"", 0) || !fat16_open(dst_abs, &out))
     {
-        if (entry.first_cluster_low != 0)
-            fat16_free_cluster_chain(entry.first_cluster_low);
+        fat16_file_close(&in);
+        return 0;
+    }
+
+    uint32_t offset = 0;
+    int ok = 1;
 
-        uint8_t sector[512];
-        ata_read_sector(entry_sector, sector);
+    while (ok && offset < in.size)
+    {
+        uint32_t n = 0;
+        uint32_t written = 0;
 
-        fat16_dir_entry_t *disk_entry = (fat16_dir_entry_t *)&sector[entry_offset];
-        disk_entry->name[0] = 0xE5;
+        if (!fat16_file_read(&in, offset, buf, FAT16_CP_CHUNK, &n) || n == 0 ||
+            !fat16_file_write_nocommit(&out, offset, buf, n, &written))
+            ok = 0;
 
-        ata_write_sector(entry_sector, sector);
-        return 1;
+        offset += n;
     }
 
-    uint16_t dir_cluster = entry.first_cluster_low;
-    if (dir_cluster < 2)
+    // Both live on this stack frame: take them off the open and dirty
+    // lists on every path out.
+    fat16_file_sync(&out);
+    fat16_file_close(&out);
+    fat16_file_close(&in);
+    return ok;
+}
+
+static int fat16_cp_dir(const char *src_abs, const char *dst_abs, uint8_t *buf)
+{
+    uint32_t src_cluster;
+    if (!fat16_resolve_absolute(src_abs, &src_cluster))
         return 0;
 
-    fat16_delete_dir_recursive(dir_cluster);
+    if (!fat16_mkdir_p(dst_abs))
+        return 0;
 
-    uint8_t sector[512];
-    ata_read_sector(entry_sector, sector);
+    fat16_slot_t pos;
+    int done = 0;
+    fat16_dirent_t d;
+
+    fat16_dir_start_pos(src_cluster, &pos);
 
-    fat16_dir_entry_t *disk_entry = (fat16_dir_entry_t *)&sector[entry_offset];
-    disk_entry->name[0] = 0xE5;
+    while (fat16_dir_next_at(src_cluster, &pos, &done, &d))
+    {
+        if (fat16_is_dot_entry(&d.entry))
+            continue;
+
+        char child_src[128];
+        char child_dst[128];
+
+        if (strlen(src_abs) + strlen(d.name) + 2 > 128 || strlen(dst_abs) + strlen(d.name) + 2 > 128)
+            return 0;
+
+        strcpy(child_src, src_abs);
+        if (strcmp(child_src, "/") != 0)
+            strcat(child_src, "/");
+        strcat(child_src, d.name);
 
-    ata_write_sector(entry_sector, sector);
+        strcpy(child_dst, dst_abs);
+        if (strcmp(child_dst, "/") != 0)
+            strcat(child_dst, "/");
+        strcat(child_dst, d.name);
+
+        int ok = (d.entry.attr & 0x10) ? fat16_cp_dir(child_src, child_dst, buf)
+                                       : fat16_cp_file(child_src, child_dst, buf);
+        if (!ok)
+            return 0;
+    }
 
     return 1;
 }
 
-/* ---------------- WRITE FILE ---------------- */
-
-int fat16_write_file(const char *path, const uint8_t *data, uint32_t size)
+// Whether two absolute paths name the same directory entry, however they
+// are spelt (case, 8.3 alias).
+static int fat16_same_entry(const char *a, const char *b)
 {
-    if (!path || path[0] == '\0')
+    uint32_t parent_a, parent_b;
+    char name_a[FAT16_NAME_MAX + 1];
+    char name_b[FAT16_NAME_MAX + 1];
+    fat16_dirent_t da, db;
+
+    if (!fat16_resolve_parent(a, &parent_a, name_a) || !fat16_resolve_parent(b, &parent_b, name_b))
         return 0;
 
-    char abs[128];
-    fat16_normalize_path(current_path, path, abs);
+    if (!fat16_dir_lookup(parent_a, name_a, &da) || !fat16_dir_lookup(parent_b, name_b, &db))
+        return 0;
 
-    char parent_path[128];
-    char filename[32];
+    return fat16_slot_equal(&da.slot, &db.slot);
+}
 
-    if (!fat16_split_path(abs, parent_path, filename))
-        return 0;
+// Whether the absolute `path` leads through the directory starting at
+// `dir_cluster`, i.e. some existing prefix of it is that directory.
+static int fat16_path_within(const char *path, uint32_t dir_cluster)
+{
+    // Everything is under the root.
+    if (dir_cluster == 0)
+        return 1;
 
-    uint16_t parent_cluster;
-    if (!fat16_resolve_absolute(parent_path, &parent_cluster))
+    uint32_t cluster = 0;
+    char part[FAT16_NAME_MAX + 1];
+    int pi = 0;
+
+    for (int i = 1;; i++)
+    {
+        char c = path[i];
+
+        if (c == '/' || c == '\0')
+        {
+            part[pi] = '\0';
+
+            if (pi > 0)
+            {
+                fat16_dir_entry_t entry;
+
+                if (!fat16_find_entry(cluster, part, &entry) || !(entry.attr & 0x10))
+                    return 0;
+
+                cluster = fat16_entry_cluster(&entry);
+                if (cluster == dir_cluster)
+                    return 1;
+            }
+
+            pi = 0;
+
+            if (c == '\0')
+                return 0;
+        }
+        else if (pi < FAT16_NAME_MAX)
+            part[pi++] = c;
+    }
+}
+
+int fat16_cp(const char *src, const char *dst)
+{
+    if (!src || !dst)
         return 0;
 
-    uint32_t entry_sector = 0;
-    uint32_t entry_offset = 0;
-    fat16_dir_entry_t entry;
-    int exists = fat16_find_entry_location(parent_cluster, filename,
-                                           &entry_sector, &entry_offset, &entry);
+    char abs_src[128];
+    fat16_normalize_path(src, abs_src);
 
-    if (exists)
+    char abs_dst[128];
+    fat16_normalize_path(dst, abs_dst);
+
+    int src_is_dir = fat16_is_directory(abs_src);
+
+    if (!src_is_dir)
     {
-        if (entry.attr & 0x10)
+        uint32_t file_size;
+        if (!fat16_get_file_size_internal(abs_src, &file_size))
             return 0;
+    }
+
+    // If dst is a directory, copy inside it
+    if (fat16_is_directory(abs_dst))
+    {
+        char parent_src[128];
+        char src_name[FAT16_NAME_MAX + 1];
+
+        if (!fat16_split_path(abs_src, parent_src, src_name))
+            return 0;
+
+        if (strlen(abs_dst) + strlen(src_name) + 2 > 128)
+            return 0;
+
+        if (strcmp(abs_dst, "/") != 0)
+            strcat(abs_dst, "/");
+
+        strcat(abs_dst, src_name);
+    }
+
+    // Lookups fold case and match 8.3 aliases, so compare entries, not
+    // spellings: copying a file onto itself would truncate it.
+    if (fat16_same_entry(abs_src, abs_dst))
+        return 0;
 
-        if (entry.first_cluster_low != 0)
-            fat16_free_cluster_chain(entry.first_cluster_low);
-    }
-    else
+    // Refuse to copy a directory into its own subtree.
+    if (src_is_dir)
     {
-        if (!fat16_find_free_dir_entry(parent_cluster, &entry_sector, &entry_offset))
+        uint32_t src_cluster;
+
+        if (!fat16_resolve_absolute(abs_src, &src_cluster) || fat16_path_within(abs_dst, src_cluster))
             return 0;
+    }
 
-        uint8_t secbuf[512];
-        ata_read_sector(entry_sector, secbuf);
+    uint8_t *buf = (uint8_t *)kmalloc(FAT16_CP_CHUNK);
+    if (!buf)
+        return 0;
 
-        fat16_dir_entry_t *newent = (fat16_dir_entry_t *)&secbuf[entry_offset];
+    int result = src_is_dir ? fat16_cp_dir(abs_src, abs_dst, buf)
+                            : fat16_cp_file(abs_src, abs_dst, buf);
 
-        for (int i = 0; i < 32; i++)
-            ((uint8_t *)newent)[i] = 0;
+    kfree(buf);
 
-        char fatname[11];
-        fat16_format_filename(filename, fatname);
+    fat16_commit();
+    return result;
+}
 
-        for (int j = 0; j < 8; j++)
-            newent->name[j] = fatname[j];
+int fat16_mv(const char *src, const char *dst)
+{
+    if (!src || !dst)
+        return 0;
 
-        for (int j = 0; j < 3; j++)
-            newent->ext[j] = fatname[8 + j];
+    if (fat16_is_directory(src))
+        return 0; // directory mv not supported yet
 
-        newent->attr = 0x20;
-        newent->first_cluster_low = 0;
-        newent->file_size = 0;
+    fat16_flush_open_files();
 
-        ata_write_sector(entry_sector, secbuf);
-    }
+    char abs_src[128];
+    fat16_normalize_path(src, abs_src);
 
-    uint16_t first_cluster = 0;
-    uint16_t prev_cluster = 0;
+    // split src -> parent + filename
+    char src_parent[128];
+    char src_name[FAT16_NAME_MAX + 1];
 
-    uint32_t remaining = size;
-    uint32_t written = 0;
+    if (!fat16_split_path(abs_src, src_parent, src_name))
+        return 0;
 
-    while (remaining > 0)
+    uint32_t src_parent_cluster;
+    if (!fat16_resolve_absolute(src_parent, &src_parent_cluster))
+        return 0;
+
+    fat16_dirent_t src_d;
+    if (!fat16_dir_lookup(src_parent_cluster, src_name, &src_d))
+        return 0;
+
+    if (src_d.entry.attr & 0x10)
+        return 0;
+
+    // normalize destination
+    char abs_dst[128];
+    fat16_normalize_path(dst, abs_dst);
+
+    // if dst is directory -> put file inside dst
+    if (fat16_is_directory(abs_dst))
     {
-        uint16_t new_cluster = fat16_alloc_cluster();
-        if (new_cluster == 0)
+        if (strlen(abs_dst) + strlen(src_name) + 2 > 128)
             return 0;
 
-        fat16_clear_cluster(new_cluster);
-
-        if (first_cluster == 0)
-            first_cluster = new_cluster;
+        char final_dst[128];
+        strcpy(final_dst, abs_dst);
 
-        if (prev_cluster != 0)
-            fat16_set_fat_entry(prev_cluster, new_cluster);
+        if (strcmp(final_dst, "/") != 0)
+            strcat(final_dst, "/");
 
-        fat16_set_fat_entry(new_cluster, 0xFFFF);
-        prev_cluster = new_cluster;
+        strcat(final_dst, src_name);
 
-        uint32_t sector_start = fat16_cluster_to_sector(new_cluster);
+        strcpy(abs_dst, final_dst);
+    }
 
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
-        {
-            uint8_t buf[512];
-            for (int i = 0; i < 512; i++)
-                buf[i] = 0;
+    // split dst -> parent + new filename
+    char dst_parent[128];
+    char dst_name[FAT16_NAME_MAX + 1];
 
-            for (int i = 0; i < 512 && remaining > 0; i++)
-            {
-                buf[i] = data[written++];
-                remaining--;
-            }
+    if (!fat16_split_path(abs_dst, dst_parent, dst_name))
+        return 0;
 
-            ata_write_sector(sector_start + s, buf);
+    uint32_t dst_parent_cluster;
+    if (!fat16_resolve_absolute(dst_parent, &dst_parent_cluster))
+        return 0;
 
-            if (remaining == 0)
-                break;
-        }
-    }
+    // check if dst already exists
+    fat16_dir_entry_t existing;
+    if (fat16_find_entry(dst_parent_cluster, dst_name, &existing))
+        return 0; // destination already exists
 
-    uint8_t secbuf[512];
-    ata_read_sector(entry_sector, secbuf);
+    // write new entry into destination directory, keeping attributes,
+    // times, cluster and size
+    fat16_dirent_t dst_d;
+    if (!fat16_dir_create(dst_parent_cluster, dst_name, &src_d.entry, &dst_d))
+        return 0;
 
-    fat16_dir_entry_t *disk_entry = (fat16_dir_entry_t *)&secbuf[entry_offset];
-    disk_entry->first_cluster_low = first_cluster;
-    disk_entry->file_size = size;
+    // Open files follow the entry to its new slot.
+    fat16_open_files_move(src_d.slot.lba, src_d.slot.offset, &dst_d);
 
-    ata_write_sector(entry_sector, secbuf);
+    // delete old entry
+    fat16_dir_remove(src_parent_cluster, &src_d);
 
+    fat16_commit();
     return 1;
 }
 
-/* ---------------- APPEND FILE ---------------- */
+int fat16_filesize(const char *path, uint32_t *out_size)
+{
+    return fat16_get_file_size_internal(path, out_size);
+}
 
-int fat16_append_file(const char *path, const uint8_t *data, uint32_t size)
+int fat16_stat(const char *path, fat16_dir_entry_t *out)
 {
-    if (!path || path[0] == '\0')
+    if (!path || path[0] == '\0' || !out)
         return 0;
 
     char abs[128];
-    fat16_normalize_path(current_path, path, abs);
-
-    char parent_path[128];
-    char filename[32];
-
-    if (!fat16_split_path(abs, parent_path, filename))
-        return 0;
-
-    uint16_t parent_cluster;
-    if (!fat16_resolve_absolute(parent_path, &parent_cluster))
-        return 0;
-
-    uint32_t entry_sector;
-    uint32_t entry_offset;
-    fat16_dir_entry_t entry;
+    fat16_normalize_path(path, abs);
 
-    if (!fat16_find_entry_location(parent_cluster, filename,
-                                   &entry_sector, &entry_offset, &entry))
+    if (strcmp(abs, "/") == 0)
     {
-        return fat16_write_file(path, data, size);
+        memset(out, 0, sizeof(*out));
+        out->attr = 0x10;
+        return 1;
     }
 
-    if (entry.attr & 0x10)
-        return 0;
+    uint32_t parent_cluster;
+    char name[FAT16_NAME_MAX + 1];
 
-    uint32_t old_size = entry.file_size;
-    uint32_t new_size = old_size + size;
+    if (!fat16_resolve_parent(abs, &parent_cluster, name))
+        return 0;
 
-    // read whole file not supported yet, so we just rewrite by simple method
-    // for now: append is implemented as "rewrite + old data lost" is WRONG
-    // so we must implement real append properly later
+    return fat16_find_entry(parent_cluster, name, out);
+}
 
-    // TEMP SIMPLE IMPLEMENTATION:
-    // Just call write_file (overwrites) -> Not real append
-    // return fat16_write_file(path, data, size);
+int fat16_readdir(const char *path, fat16_readdir_fn fn, void *ctx)
+{
+    if (!path || path[0] == '\0' || !fn)
+        return 0;
 
-    // REAL append implementation below:
+    char abs[128];
+    fat16_normalize_path(path, abs);
 
-    uint32_t cluster_size_bytes = bpb.sectors_per_cluster * 512;
+    uint32_t dir_cluster;
+    if (!fat16_resolve_absolute(abs, &dir_cluster))
+        return 0;
 
-    uint16_t cluster = entry.first_cluster_low;
-    uint16_t last_cluster = cluster;
+    fat16_dir_iter_t it;
+    fat16_dirent_t d;
+    fat16_iter_start(&it, dir_cluster);
 
-    if (cluster == 0)
+    while (fat16_dir_next(&it, &d))
     {
-        // file empty, just write new data
-        return fat16_write_file(path, data, size);
-    }
+        if (fat16_is_dot_entry(&d.entry))
+            continue;
 
-    while (cluster < 0xFFF8)
-    {
-        last_cluster = cluster;
-        uint16_t next = fat16_get_fat_entry(cluster);
-        if (next >= 0xFFF8)
+        if (!fn(ctx, d.name, &d.entry))
             break;
-        cluster = next;
     }
 
-    uint32_t offset_in_cluster = old_size % cluster_size_bytes;
-    uint32_t remaining = size;
-    uint32_t written = 0;
+    return 1;
+}
 
-    // fill remaining space in last cluster
-    if (offset_in_cluster != 0)
-    {
-        uint32_t sector_start = fat16_cluster_to_sector(last_cluster);
+/* ---------------- OPEN FILES ---------------- */
 
-        uint32_t sector_index = offset_in_cluster / 512;
-        uint32_t sector_offset = offset_in_cluster % 512;
+static void fat16_file_from_entry(fat16_file_t *file, const fat16_dir_entry_t *entry,
+                                  uint32_t entry_sector, uint32_t entry_offset)
+{
+    file->first_cluster = fat16_entry_cluster(entry);
+    file->size = entry->file_size;
+    file->attr = entry->attr;
+    file->entry_sector = entry_sector;
+    file->entry_offset = entry_offset;
+    file->cursor_index = 0;
+    file->cursor_cluster = 0;
+    file->tail_index = 0;
+    file->tail_cluster = 0;
+    file->ra_next = 0;
+    file->ra_end = 0;
+    file->ra_window = 0;
+    file->dirty = 0;
+    file->next_dirty = 0;
+
+    for (int i = 0; i < 8; i++)
+        file->name[i] = entry->name[i];
+    for (int i = 0; i < 3; i++)
+        file->name[8 + i] = entry->ext[i];
+}
 
-        uint8_t buf[512];
-        ata_read_sector(sector_start + sector_index, buf);
+// Open files whose size or first cluster changed since the directory
+// entry was last written.
+static fat16_file_t *dirty_files = 0;
 
-        for (uint32_t i = sector_offset; i < 512 && remaining > 0; i++)
-        {
-            buf[i] = data[written++];
-            remaining--;
-        }
+static void fat16_file_mark_dirty(fat16_file_t *file)
+{
+    if (file->dirty)
+        return;
 
-        ata_write_sector(sector_start + sector_index, buf);
+    file->dirty = 1;
+    file->next_dirty = dirty_files;
+    dirty_files = file;
+}
 
-        sector_index++;
+// Write size and first cluster back to the directory entry, unless the
+// slot no longer holds this file (deleted, or reused by another name).
+static void fat16_file_write_entry(fat16_file_t *file)
+{
+    if (file->entry_sector == 0)
+        return;
 
-        while (sector_index < bpb.sectors_per_cluster && remaining > 0)
-        {
-            for (int i = 0; i < 512; i++)
-                buf[i] = 0;
+    uint8_t sector[512];
+    bcache_read(file->entry_sector, sector);
 
-            for (int i = 0; i < 512 && remaining > 0; i++)
-            {
-                buf[i] = data[written++];
-                remaining--;
-            }
+    fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[file->entry_offset];
 
-            ata_write_sector(sector_start + sector_index, buf);
-            sector_index++;
-        }
-    }
+    if ((uint8_t)entry->name[0] == 0xE5 || !fat16_name_matches(entry, file->name))
+        return;
 
-    uint16_t prev = last_cluster;
+    fat16_entry_set_cluster(entry, file->first_cluster);
+    entry->file_size = file->size;
 
-    while (remaining > 0)
+    bcache_write(file->entry_sector, sector);
+}
+
+// Write back every pending directory entry update.
+static void fat16_flush_open_files()
+{
+    fat16_file_t *file = dirty_files;
+    dirty_files = 0;
+
+    while (file)
     {
-        uint16_t new_cluster = fat16_alloc_cluster();
-        if (new_cluster == 0)
-            return 0;
+        fat16_file_t *next = file->next_dirty;
 
-        fat16_clear_cluster(new_cluster);
+        fat16_file_write_entry(file);
+        file->dirty = 0;
+        file->next_dirty = 0;
 
-        fat16_set_fat_entry(prev, new_cluster);
-        fat16_set_fat_entry(new_cluster, 0xFFFF);
+        file = next;
+    }
+}
 
-        uint32_t sector_start = fat16_cluster_to_sector(new_cluster);
+int fat16_file_sync(fat16_file_t *file)
+{
+    if (!file || !file->dirty)
+        return 1;
 
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
-        {
-            uint8_t buf[512];
-            for (int i = 0; i < 512; i++)
-                buf[i] = 0;
+    fat16_file_t **link = &dirty_files;
+    while (*link && *link != file)
+        link = &(*link)->next_dirty;
 
-            for (int i = 0; i < 512 && remaining > 0; i++)
-            {
-                buf[i] = data[written++];
-                remaining--;
-            }
+    if (*link)
+        *link = file->next_dirty;
 
-            ata_write_sector(sector_start + s, buf);
+    fat16_file_write_entry(file);
+    file->dirty = 0;
+    file->next_dirty = 0;
+    return 1;
+}
 
-            if (remaining == 0)
-                break;
-        }
+// Every open file object, from fat16_open() to fat16_file_close().
+static fat16_file_t *open_files = 0;
 
-        prev = new_cluster;
+static void fat16_file_track(fat16_file_t *file)
+{
+    for (fat16_file_t *f = open_files; f; f = f->next_open)
+    {
+        if (f == file)
+            return;
     }
 
-    uint8_t secbuf[512];
-    ata_read_sector(entry_sector, secbuf);
+    file->next_open = open_files;
+    open_files = file;
+}
 
-    fat16_dir_entry_t *disk_entry = (fat16_dir_entry_t *)&secbuf[entry_offset];
-    disk_entry->file_size = new_size;
+static void fat16_file_untrack(fat16_file_t *file)
+{
+    fat16_file_t **link = &open_files;
+    while (*link && *link != file)
+        link = &(*link)->next_open;
 
-    ata_write_sector(entry_sector, secbuf);
+    if (*link)
+        *link = file->next_open;
 
-    return 1;
+    file->next_open = 0;
 }
 
-static int fat16_get_file_size_internal(const char *path, uint32_t *out_size)
+// Handles on the same entry share its size and chain: copy them, and the
+// cached tail, from `from` to `to`.
+static void fat16_file_share(fat16_file_t *to, const fat16_file_t *from)
 {
-    if (!path || path[0] == '\0')
-        return 0;
-
-    char abs[128];
-    fat16_normalize_path(current_path, path, abs);
+    to->first_cluster = from->first_cluster;
+    to->size = from->size;
+    to->tail_index = from->tail_index;
+    to->tail_cluster = from->tail_cluster;
+}
 
-    char parent_path[128];
-    char filename[32];
+// A new handle starts from one already open on the entry, whose writes
+// may not have reached the directory entry yet.
+static void fat16_file_adopt(fat16_file_t *file)
+{
+    for (fat16_file_t *f = open_files; f; f = f->next_open)
+    {
+        if (f != file && f->entry_sector == file->entry_sector && f->entry_offset == file->entry_offset)
+        {
+            fat16_file_share(file, f);
+            return;
+        }
+    }
+}
 
-    if (!fat16_split_path(abs, parent_path, filename))
-        return 0;
+// After a write through `file`, the other handles on its entry see the
+// new size and chain, so none of them writes back a stale entry or
+// allocates a second chain.
+static void fat16_open_files_update(const fat16_file_t *file)
+{
+    for (fat16_file_t *f = open_files; f; f = f->next_open)
+    {
+        if (f != file && f->entry_sector == file->entry_sector && f->entry_offset == file->entry_offset)
+            fat16_file_share(f, file);
+    }
+}
 
-    uint16_t parent_cluster;
-    if (!fat16_resolve_absolute(parent_path, &parent_cluster))
-        return 0;
+// The entry's chain was replaced (truncate, overwrite): pick up the new
+// first cluster and size and forget positions in the old chain.
+static void fat16_open_files_reload(uint32_t entry_sector, uint32_t entry_offset)
+{
+    for (fat16_file_t *f = open_files; f; f = f->next_open)
+    {
+        if (f->entry_sector == entry_sector && f->entry_offset == entry_offset)
+            fat16_file_refresh(f);
+    }
+}
 
-    fat16_dir_entry_t entry;
-    if (!fat16_find_entry(parent_cluster, filename, &entry))
-        return 0;
+static void fat16_open_files_move(uint32_t entry_sector, uint32_t entry_offset, const fat16_dirent_t *to)
+{
+    for (fat16_file_t *f = open_files; f; f = f->next_open)
+    {
+        if (f->entry_sector != entry_sector || f->entry_offset != entry_offset)
+            continue;
 
-    if (entry.attr & 0x10)
-        return 0;
+        f->entry_sector = to->slot.lba;
+        f->entry_offset = to->slot.offset;
 
-    *out_size = entry.file_size;
-    return 1;
+        for (int i = 0; i < 8; i++)
+            f->name[i] = to->entry.name[i];
+        for (int i = 0; i < 3; i++)
+            f->name[8 + i] = to->entry.ext[i];
+    }
 }
 
-static int fat16_is_directory(const char *path)
+// The entry is going away and its chain with it: the files read as empty
+// and refuse writes, which would otherwise land in freed clusters.
+static void fat16_open_files_detach(uint32_t entry_sector, uint32_t entry_offset)
 {
-    if (!path || path[0] == '\0')
-        return 0;
+    for (fat16_file_t *f = open_files; f; f = f->next_open)
+    {
+        if (f->entry_sector != entry_sector || f->entry_offset != entry_offset)
+            continue;
 
-    char abs[128];
-    fat16_normalize_path(current_path, path, abs);
+        fat16_file_sync(f);
+
+        f->entry_sector = 0;
+        f->entry_offset = 0;
+        f->first_cluster = 0;
+        f->size = 0;
+        f->cursor_index = 0;
+        f->cursor_cluster = 0;
+        f->tail_index = 0;
+        f->tail_cluster = 0;
+        f->ra_next = 0;
+        f->ra_end = 0;
+        f->ra_window = 0;
+    }
+}
 
-    // root is directory
-    if (strcmp(abs, "/") == 0)
-        return 1;
+void fat16_file_close(fat16_file_t *file)
+{
+    if (!file)
+        return;
 
-    char parent_path[128];
-    char filename[32];
+    fat16_file_untrack(file);
 
-    if (!fat16_split_path(abs, parent_path, filename))
-        return 0;
+    if (!file->dirty)
+        return;
 
-    uint16_t parent_cluster;
-    if (!fat16_resolve_absolute(parent_path, &parent_cluster))
-        return 0;
+    fat16_file_sync(file);
+    fat16_commit();
+}
 
-    fat16_dir_entry_t entry;
-    if (!fat16_find_entry(parent_cluster, filename, &entry))
-        return 0;
+// Pick the closest known point at or before cluster-index `index`: the
+// cursor, the tail, or the head of the chain.
+static void fat16_file_walk_start(fat16_file_t *file, uint32_t index, uint32_t *cluster, uint32_t *at)
+{
+    *cluster = file->first_cluster;
+    *at = 0;
 
-    return (entry.attr & 0x10) ? 1 : 0;
+    if (file->cursor_cluster >= 2 && file->cursor_index <= index)
+    {
+        *cluster = file->cursor_cluster;
+        *at = file->cursor_index;
+    }
+
+    if (file->tail_cluster >= 2 && file->tail_index <= index && file->tail_index > *at)
+    {
+        *cluster = file->tail_cluster;
+        *at = file->tail_index;
+    }
 }
 
-static int fat16_read_file(const char *path, uint8_t *out_buf, uint32_t max_size, uint32_t *out_size)
+int fat16_open(const char *path, fat16_file_t *file)
 {
-    if (!path || path[0] == '\0')
+    if (!path || path[0] == '\0' || !file)
         return 0;
 
     char abs[128];
-    fat16_normalize_path(current_path, path, abs);
+    fat16_normalize_path(path, abs);
+
+    // root is a directory, not a readable file
+    if (strcmp(abs, "/") == 0)
+        return 0;
 
     char parent_path[128];
-    char filename[32];
+    char filename[FAT16_NAME_MAX + 1];
 
     if (!fat16_split_path(abs, parent_path, filename))
         return 0;
 
-    uint16_t parent_cluster;
+    uint32_t parent_cluster;
     if (!fat16_resolve_absolute(parent_path, &parent_cluster))
         return 0;
 
+    uint32_t entry_sector;
+    uint32_t entry_offset;
     fat16_dir_entry_t entry;
-    if (!fat16_find_entry(parent_cluster, filename, &entry))
-        return 0;
-
-    if (entry.attr & 0x10)
-        return 0;
-
-    uint32_t remaining = entry.file_size;
 
-    if (remaining > max_size)
+    if (!fat16_find_entry_location(parent_cluster, filename,
+                                   &entry_sector, &entry_offset, &entry))
         return 0;
 
-    uint16_t cluster = entry.first_cluster_low;
-    uint32_t read = 0;
-
-    if (remaining == 0)
-    {
-        *out_size = 0;
-        return 1;
-    }
-
-    // Non-empty file must have a valid data cluster (>= 2).
-    if (cluster < 2)
+    if (entry.attr & 0x10)
         return 0;
 
-    uint8_t sector[512];
-
-    while (cluster < 0xFFF8)
-    {
-        uint32_t sector_start = fat16_cluster_to_sector(cluster);
-
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
-        {
-            ata_read_sector(sector_start + s, sector);
-
-            for (int i = 0; i < 512; i++)
-            {
-                if (remaining == 0)
-                {
-                    *out_size = read;
-                    return 1;
-                }
-
-                out_buf[read++] = sector[i];
-                remaining--;
-            }
-        }
-
-        cluster = fat16_get_fat_entry(cluster);
-    }
-
-    *out_size = read;
+    fat16_file_from_entry(file, &entry, entry_sector, entry_offset);
+    fat16_file_adopt(file);
+    fat16_file_track(file);
     return 1;
 }
 
-/* ---------------- COPY + MOVE ---------------- */
-
-int fat16_cp(const char *src, const char *dst)
+int fat16_file_refresh(fat16_file_t *file)
 {
-    if (!src || !dst)
+    fat16_file_sync(file);
+
+    if (file->entry_sector == 0)
         return 0;
 
-    if (fat16_is_directory(src))
-        return 0; // directory copy not supported yet
+    uint8_t sector[512];
+    bcache_read(file->entry_sector, sector);
 
-    uint32_t file_size;
-    if (!fat16_get_file_size_internal(src, &file_size))
-        return 0;
+    fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[file->entry_offset];
 
-    uint8_t *buf = (uint8_t *)kmalloc(file_size + 4);
-    if (!buf)
+    if ((uint8_t)entry->name[0] == 0xE5 || entry->name[0] == 0x00)
         return 0;
 
-    uint32_t read_size;
-    if (!fat16_read_file(src, buf, file_size + 4, &read_size))
+    fat16_file_from_entry(file, entry, file->entry_sector, file->entry_offset);
+    return 1;
+}
+
+// Cluster holding cluster-index `index` of the file, or 0 past the end.
+// Walks forward from the cached cursor when possible, so sequential
+// access costs one FAT lookup per cluster.
+static uint32_t fat16_file_cluster(fat16_file_t *file, uint32_t index)
+{
+    uint32_t cluster;
+    uint32_t at;
+    fat16_file_walk_start(file, index, &cluster, &at);
+
+    while (at < index)
     {
-        kfree(buf);
-        return 0;
+        if (cluster < 2 || cluster >= vol.eoc_min)
+            return 0;
+
+        uint32_t next = fat16_get_fat_entry(cluster);
+        if (next >= vol.eoc_min)
+        {
+            file->tail_cluster = cluster;
+            file->tail_index = at;
+            return 0;
+        }
+
+        cluster = next;
+        at++;
     }
 
-    if (read_size != file_size)
-    {
-        kfree(buf);
+    if (cluster < 2 || cluster >= vol.eoc_min)
         return 0;
-    }
 
-    int result = 0;
+    file->cursor_index = index;
+    file->cursor_cluster = cluster;
+    return cluster;
+}
 
-    // If dst is a directory, copy inside it
-    if (fat16_is_directory(dst))
+// Queue the sectors holding bytes [from, to) of the file into the sector
+// cache. Walks the chain on its own so the read cursor stays put.
+static void fat16_file_prefetch(fat16_file_t *file, uint32_t from, uint32_t to)
+{
+    uint32_t cluster_bytes = vol.cluster_bytes;
+    uint32_t index = from / cluster_bytes;
+
+    uint32_t cluster;
+    uint32_t at;
+    fat16_file_walk_start(file, index, &cluster, &at);
+
+    while (at < index && cluster >= 2 && cluster < vol.eoc_min)
     {
-        char abs_dst[128];
-        fat16_normalize_path(current_path, dst, abs_dst);
+        cluster = fat16_get_fat_entry(cluster);
+        at++;
+    }
 
-        char abs_src[128];
-        fat16_normalize_path(current_path, src, abs_src);
+    uint32_t pos = from - from % 512;
+    uint32_t run_lba = 0;
+    uint32_t run_count = 0;
 
-        char parent_src[128];
-        char src_name[32];
+    // Physically contiguous clusters are prefetched as one run.
+    blk_plug();
+    while (pos < to && cluster >= 2 && cluster < vol.eoc_min)
+    {
+        uint32_t skip = pos % cluster_bytes;
+        uint32_t lba = fat16_cluster_to_sector(cluster) + skip / 512;
+        uint32_t n = (cluster_bytes - skip) / 512;
+        uint32_t left = (to - pos + 511) / 512;
 
-        if (!fat16_split_path(abs_src, parent_src, src_name))
+        if (n > left)
+            n = left;
+
+        if (run_count && run_lba + run_count == lba)
         {
-            kfree(buf);
-            return 0;
+            run_count += n;
+        }
+        else
+        {
+            if (run_count)
+                bcache_prefetch(run_lba, run_count);
+            run_lba = lba;
+            run_count = n;
         }
 
-        char final_dst[128];
-        strcpy(final_dst, abs_dst);
+        pos += n * 512;
+        if (pos < to)
+            cluster = fat16_get_fat_entry(cluster);
+    }
 
-        if (strcmp(final_dst, "/") != 0)
-            strcat(final_dst, "/");
+    if (run_count)
+        bcache_prefetch(run_lba, run_count);
+    blk_unplug();
+}
 
-        strcat(final_dst, src_name);
+// Called after each read of [offset, offset + len). A read that starts
+// where the previous one ended counts as streaming: once the reader gets
+// within half a window of what has been fetched, the window doubles (up
+// to FAT16_RA_MAX) and the next stretch is prefetched. A seek resets it.
+// Reads of a whole window or more already go to the disk as one transfer
+// and are left alone.
+static void fat16_file_readahead(fat16_file_t *file, uint32_t offset, uint32_t len)
+{
+    uint32_t end = offset + len;
+    int sequential = (offset == file->ra_next);
 
-        result = fat16_write_file(final_dst, buf, file_size);
-    }
-    else
+    file->ra_next = end;
+
+    if (!sequential || len >= FAT16_RA_MAX * 512)
     {
-        result = fat16_write_file(dst, buf, file_size);
+        file->ra_window = 0;
+        file->ra_end = end;
+        return;
     }
 
-    kfree(buf);
-    return result;
-}
+    if (file->ra_window && end + file->ra_window * 512 / 2 < file->ra_end)
+        return;
 
-int fat16_mv(const char *src, const char *dst)
-{
-    if (!src || !dst)
-        return 0;
+    file->ra_window = file->ra_window ? file->ra_window * 2 : FAT16_RA_MIN;
+    if (file->ra_window > FAT16_RA_MAX)
+        file->ra_window = FAT16_RA_MAX;
 
-    if (fat16_is_directory(src))
-        return 0; // directory mv not supported yet
+    uint32_t from = (file->ra_end > end) ? file->ra_end : end;
+    uint32_t to = end + file->ra_window * 512;
 
-    char abs_src[128];
-    fat16_normalize_path(current_path, src, abs_src);
+    if (to > file->size)
+        to = file->size;
 
-    // split src -> parent + filename
-    char src_parent[128];
-    char src_name[32];
+    if (from >= to)
+        return;
 
-    if (!fat16_split_path(abs_src, src_parent, src_name))
-        return 0;
+    file->ra_end = to;
+    fat16_file_prefetch(file, from, to);
+}
 
-    uint16_t src_parent_cluster;
-    if (!fat16_resolve_absolute(src_parent, &src_parent_cluster))
+int fat16_file_read(fat16_file_t *file, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read)
+{
+    if (!out_read)
         return 0;
+    *out_read = 0;
 
-    // find src entry location
-    uint32_t src_sector;
-    uint32_t src_offset;
-    fat16_dir_entry_t src_entry;
-
-    if (!fat16_find_entry_location(src_parent_cluster, src_name,
-                                   &src_sector, &src_offset, &src_entry))
+    if (!file)
         return 0;
 
-    if (src_entry.attr & 0x10)
+    // len==0 is allowed (existence check)
+    if (len > 0 && !out)
         return 0;
 
-    // normalize destination
-    char abs_dst[128];
-    fat16_normalize_path(current_path, dst, abs_dst);
-
-    // if dst is directory -> put file inside dst
-    if (fat16_is_directory(abs_dst))
-    {
-        char final_dst[128];
-        strcpy(final_dst, abs_dst);
-
-        if (strcmp(final_dst, "/") != 0)
-            strcat(final_dst, "/");
-
-        strcat(final_dst, src_name);
+    uint32_t file_size = file->size;
+    if (offset >= file_size)
+        return 1;
 
-        strcpy(abs_dst, final_dst);
-    }
+    uint32_t remaining = file_size - offset;
+    if (len < remaining)
+        remaining = len;
 
-    // split dst -> parent + new filename
-    char dst_parent[128];
-    char dst_name[32];
+    if (remaining == 0)
+        return 1;
 
-    if (!fat16_split_path(abs_dst, dst_parent, dst_name))
-        return 0;
+    uint32_t cluster_size_bytes = vol.cluster_bytes;
 
-    uint16_t dst_parent_cluster;
-    if (!fat16_resolve_absolute(dst_parent, &dst_parent_cluster))
+    uint32_t index = offset / cluster_size_bytes;
+    uint32_t cluster = fat16_file_cluster(file, index);
+    if (cluster == 0)
         return 0;
 
-    // check if dst already exists
-    fat16_dir_entry_t existing;
-    if (fat16_find_entry(dst_parent_cluster, dst_name, &existing))
-        return 0; // destination already exists
-
-    // find free entry in dst parent
-    uint32_t free_sector;
-    uint32_t free_offset;
+    uint32_t copied = 0;
+    uint8_t sector[512];
 
-    if (!fat16_find_free_dir_entry(dst_parent_cluster, &free_sector, &free_offset))
-        return 0;
+    // `skip` is the byte position inside `cluster`.
+    uint32_t skip = offset % cluster_size_bytes;
 
-    // write new entry into destination directory
-    uint8_t buf[512];
-    ata_read_sector(free_sector, buf);
+    while (remaining > 0)
+    {
+        uint32_t lba = fat16_cluster_to_sector(cluster) + skip / 512;
+        uint32_t in_sector = skip % 512;
+        uint32_t n;
 
-    fat16_dir_entry_t *new_entry = (fat16_dir_entry_t *)&buf[free_offset];
+        if (in_sector == 0 && remaining >= 512)
+        {
+            // Whole sectors go straight into `out` with one multi-sector
+            // transfer, extended across physically contiguous clusters.
+            uint32_t want = remaining / 512;
+            uint32_t avail = (cluster_size_bytes - skip) / 512;
+            uint32_t last = cluster;
 
-    fat16_copy_entry(new_entry, &src_entry);
+            while (avail < want)
+            {
+                uint32_t next = fat16_get_fat_entry(last);
+                if (next != last + 1)
+                    break;
+                last = next;
+                avail += vol.bpb.sectors_per_cluster;
+            }
 
-    // update filename
-    char fatname[11];
-    fat16_format_filename(dst_name, fatname);
+            uint32_t count = (avail < want) ? avail : want;
+            bcache_read_range(lba, count, out + copied);
+            n = count * 512;
+        }
+        else
+        {
+            bcache_read(lba, sector);
 
-    for (int j = 0; j < 8; j++)
-        new_entry->name[j] = fatname[j];
+            n = 512 - in_sector;
+            if (n > remaining)
+                n = remaining;
 
-    for (int j = 0; j < 3; j++)
-        new_entry->ext[j] = fatname[8 + j];
+            for (uint32_t i = 0; i < n; i++)
+                out[copied + i] = sector[in_sector + i];
+        }
 
-    ata_write_sector(free_sector, buf);
+        copied += n;
+        remaining -= n;
+        skip += n;
 
-    // delete old entry
-    uint8_t secbuf[512];
-    ata_read_sector(src_sector, secbuf);
+        if (remaining > 0 && skip >= cluster_size_bytes)
+        {
+            index += skip / cluster_size_bytes;
+            skip %= cluster_size_bytes;
 
-    fat16_dir_entry_t *old_entry = (fat16_dir_entry_t *)&secbuf[src_offset];
-    old_entry->name[0] = 0xE5;
+            cluster = fat16_file_cluster(file, index);
+            if (cluster == 0)
+                break;
+        }
+    }
 
-    ata_write_sector(src_sector, secbuf);
+    if (copied > 0)
+        fat16_file_readahead(file, offset, copied);
 
+    *out_read = copied;
     return 1;
 }
 
-int fat16_filesize(const char *path, uint32_t *out_size)
-{
-    return fat16_get_file_size_internal(path, out_size);
-}
-
-int fat16_list_dir(const char *path, char *out, uint32_t out_size, uint32_t *out_written)
+// Like fat16_file_cluster(), but grows the chain when the file doesn't
+// reach cluster-index `index` yet. `last_index` is the last cluster the
+// current write needs, so the growth is reserved as one contiguous run
+// placed right after the file's tail when possible.
+static uint32_t fat16_file_cluster_alloc(fat16_file_t *file, uint32_t index, uint32_t last_index)
 {
-    if (!out || out_size == 0 || !out_written)
-        return 0;
-
-    out[0] = '\0';
-    *out_written = 0;
-
-    if (!path || path[0] == '\0')
-        return 0;
+    uint32_t got;
 
-    char abs[128];
-    fat16_normalize_path(current_path, path, abs);
-
-    uint16_t dir_cluster;
-    if (!fat16_resolve_absolute(abs, &dir_cluster))
-        return 0;
+    if (file->first_cluster < 2)
+    {
+        uint32_t first = fat16_alloc_run(last_index + 1, 0, &got);
+        if (first == 0)
+            return 0;
 
-    uint8_t sector[512];
-    uint32_t written = 0;
+        file->first_cluster = first;
+        file->cursor_index = 0;
+        file->cursor_cluster = first;
+        file->tail_index = got - 1;
+        file->tail_cluster = (uint32_t)(first + got - 1);
+    }
 
-    // Append "name\n" if it fits; keeps output NUL terminated.
-    #define APPEND_LINE(name_buf)                                                     \
-        do                                                                            \
-        {                                                                             \
-            const char *s__ = (name_buf);                                             \
-            uint32_t i__ = 0;                                                         \
-            while (s__[i__] != '\0')                                                  \
-            {                                                                         \
-                if (written + 2 >= out_size)                                          \
-                    goto done;                                                        \
-                out[written++] = s__[i__++];                                          \
-            }                                                                         \
-            if (written + 2 >= out_size)                                              \
-                goto done;                                                            \
-            out[written++] = '\n';                                                    \
-            out[written] = '\0';                                                      \
-        } while (0)
+    uint32_t cluster;
+    uint32_t at;
+    fat16_file_walk_start(file, index, &cluster, &at);
 
-    if (dir_cluster == 0)
+    while (at < index)
     {
-        uint32_t root_start = fat16_root_start_sector();
-        uint32_t root_sectors = fat16_root_dir_sectors();
+        uint32_t next = fat16_get_fat_entry(cluster);
 
-        for (uint32_t s = 0; s < root_sectors; s++)
+        if (next >= vol.eoc_min)
         {
-            ata_read_sector(root_start + s, sector);
-
-            for (int i = 0; i < 512; i += 32)
+            next = fat16_alloc_run(last_index - at, cluster + 1, &got);
+            if (next == 0)
             {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
+                file->tail_cluster = cluster;
+                file->tail_index = at;
+                return 0;
+            }
 
-                if (entry->name[0] == 0x00)
-                    goto done;
-                if ((uint8_t)entry->name[0] == 0xE5)
-                    continue;
-                if (entry->attr == 0x0F)
-                    continue;
+            fat16_set_fat_entry(cluster, next);
 
-                char filename[13];
-                fat16_entry_to_name(entry, filename);
-                APPEND_LINE(filename);
-            }
+            file->tail_index = at + got;
+            file->tail_cluster = (uint32_t)(next + got - 1);
         }
+        else if (next < 2)
+            return 0; // broken chain
 
-        goto done;
+        cluster = next;
+        at++;
     }
 
-    uint16_t cluster = dir_cluster;
-    while (cluster < 0xFFF8)
+    file->cursor_index = index;
+    file->cursor_cluster = cluster;
+    return cluster;
+}
+
+// Write `len` bytes at `offset`, touching only the sectors involved.
+// Returns the number of bytes written: short when the disk is full, 0 when
+// a write to the disk failed.
+static uint32_t fat16_file_write_span(fat16_file_t *file, uint32_t offset, const uint8_t *data, uint32_t len)
+{
+    uint32_t cluster_size_bytes = vol.cluster_bytes;
+    uint32_t last_index = (offset + len - 1) / cluster_size_bytes;
+    uint32_t done = 0;
+    int ok = 1;
+
+    blk_plug();
+
+    while (done < len)
     {
-        uint32_t start_sector = fat16_cluster_to_sector(cluster);
+        uint32_t pos = offset + done;
+
+        uint32_t cluster = fat16_file_cluster_alloc(file, pos / cluster_size_bytes, last_index);
+        if (cluster == 0)
+            break;
 
-        for (int s = 0; s < bpb.sectors_per_cluster; s++)
+        uint32_t skip = pos % cluster_size_bytes;
+        uint32_t lba = fat16_cluster_to_sector(cluster) + skip / 512;
+        uint32_t in_sector = skip % 512;
+        uint32_t n;
+
+        if (in_sector == 0 && len - done >= 512)
         {
-            ata_read_sector(start_sector + s, sector);
+            // Whole sectors: no need to read the old contents.
+            uint32_t count = (len - done) / 512;
+            uint32_t avail = (cluster_size_bytes - skip) / 512;
+            if (count > avail)
+                count = avail;
 
-            for (int i = 0; i < 512; i += 32)
+            if (!bcache_write_range(lba, count, data + done))
             {
-                fat16_dir_entry_t *entry = (fat16_dir_entry_t *)&sector[i];
+                ok = 0;
+                break;
+            }
+            n = count * 512;
+        }
+        else
+        {
+            uint8_t sector[512];
 
-                if (entry->name[0] == 0x00)
-                    goto done;
-                if ((uint8_t)entry->name[0] == 0xE5)
-                    continue;
-                if (entry->attr == 0x0F)
-                    continue;
+            n = 512 - in_sector;
+            if (n > len - done)
+                n = len - done;
 
-                char filename[13];
-                fat16_entry_to_name(entry, filename);
-                APPEND_LINE(filename);
+            // A sector that starts past the end holds no file data yet.
+            if (pos - in_sector >= file->size)
+            {
+                for (int i = 0; i < 512; i++)
+                    sector[i] = 0;
             }
+            else
+                bcache_read(lba, sector);
+
+            for (uint32_t i = 0; i < n; i++)
+                sector[in_sector + i] = data[done + i];
+
+            bcache_write(lba, sector);
         }
 
-        cluster = fat16_get_fat_entry(cluster);
+        done += n;
+
+        if (pos + n > file->size)
+            file->size = pos + n;
     }
 
-done:
-    #undef APPEND_LINE
-    *out_written = written;
-    return 1;
+    // Queued writes only report their errors here, and could have hit
+    // any part of the span.
+    if (!blk_unplug())
+        ok = 0;
+
+    return ok ? done : 0;
 }
 
-int fat16_read_at(const char *path, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read)
+// fat16_file_write() without the sync point, for callers that issue many
+// writes and commit once at the end.
+static int fat16_file_write_nocommit(fat16_file_t *file, uint32_t offset, const uint8_t *data,
+                                     uint32_t len, uint32_t *out_written)
 {
-    if (!out_read)
-        return 0;
-    *out_read = 0;
-
-    if (!path || path[0] == '\0')
-        return 0;
-
-    // len==0 is allowed (existence check)
-    if (len > 0 && !out)
-        return 0;
-
-    char abs[128];
-    fat16_normalize_path(current_path, path, abs);
+    *out_written = 0;
 
-    // root is a directory, not a readable file
-    if (strcmp(abs, "/") == 0)
+    if (!file || (file->attr & 0x10) || file->entry_sector == 0)
         return 0;
 
-    char parent_path[128];
-    char filename[32];
+    if (len == 0)
+        return 1;
 
-    if (!fat16_split_path(abs, parent_path, filename))
+    if (!data || offset + len < offset)
         return 0;
 
-    uint16_t parent_cluster;
-    if (!fat16_resolve_absolute(parent_path, &parent_cluster))
-        return 0;
+    uint32_t old_first = file->first_cluster;
+    uint32_t old_size = file->size;
 
-    fat16_dir_entry_t entry;
-    if (!fat16_find_entry(parent_cluster, filename, &entry))
-        return 0;
+    // Writing past the end leaves a hole that must read back as zeros.
+    if (offset > file->size)
+    {
+        static const uint8_t zero[512];
 
-    if (entry.attr & 0x10)
-        return 0;
+        while (file->size < offset)
+        {
+            uint32_t n = 512 - (file->size % 512);
+            if (n > offset - file->size)
+                n = offset - file->size;
 
-    uint32_t file_size = entry.file_size;
-    if (offset >= file_size)
-    {
-        *out_read = 0;
-        return 1;
+            if (fat16_file_write_span(file, file->size, zero, n) != n)
+                break;
+        }
     }
 
-    uint32_t remaining = file_size - offset;
-    if (len < remaining)
-        remaining = len;
+    uint32_t written = 0;
+    if (file->size >= offset)
+        written = fat16_file_write_span(file, offset, data, len);
 
-    if (remaining == 0)
+    // The directory entry is updated on close or sync, not per write.
+    if (file->first_cluster != old_first || file->size != old_size)
     {
-        *out_read = 0;
-        return 1;
+        fat16_file_mark_dirty(file);
+        fat16_open_files_update(file);
     }
 
-    uint16_t cluster = entry.first_cluster_low;
-    if (cluster < 2)
+    *out_written = written;
+    return written == len;
+}
+
+int fat16_file_write(fat16_file_t *file, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written)
+{
+    if (!out_written)
         return 0;
 
-    uint32_t cluster_size_bytes = (uint32_t)bpb.sectors_per_cluster * 512;
+    int ok = fat16_file_write_nocommit(file, offset, data, len, out_written);
 
-    // Skip clusters until we reach the offset.
-    uint32_t skip = offset;
-    while (skip >= cluster_size_bytes)
-    {
-        uint16_t next = fat16_get_fat_entry(cluster);
-        if (next >= 0xFFF8)
-            return 0;
-        cluster = next;
-        skip -= cluster_size_bytes;
-    }
+    fat16_commit();
+    return ok;
+}
 
-    uint32_t copied = 0;
-    uint8_t sector[512];
+int fat16_write_at(const char *path, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written)
+{
+    if (!out_written)
+        return 0;
+    *out_written = 0;
 
-    while (cluster < 0xFFF8 && remaining > 0)
-    {
-        uint32_t sector_start = fat16_cluster_to_sector(cluster);
+    fat16_file_t file;
+    if (!fat16_open(path, &file))
+        return 0;
 
-        for (int s = 0; s < bpb.sectors_per_cluster && remaining > 0; s++)
-        {
-            ata_read_sector(sector_start + (uint32_t)s, sector);
+    int ok = fat16_file_write(&file, offset, data, len, out_written);
 
-            uint32_t start_i = 0;
-            if (skip > 0)
-            {
-                start_i = skip;
-                if (start_i >= 512)
-                {
-                    skip -= 512;
-                    continue;
-                }
-                skip = 0;
-            }
+    fat16_file_close(&file);
+    return ok;
+}
 
-            for (uint32_t i = start_i; i < 512 && remaining > 0; i++)
-            {
-                out[copied++] = sector[i];
-                remaining--;
-            }
-        }
+int fat16_read_at(const char *path, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read)
+{
+    if (!out_read)
+        return 0;
+    *out_read = 0;
 
-        if (remaining == 0)
-            break;
+    fat16_file_t file;
+    if (!fat16_open(path, &file))
+        return 0;
 
-        cluster = fat16_get_fat_entry(cluster);
-    }
+    int ok = fat16_file_read(&file, offset, out, len, out_read);
 
-    *out_read = copied;
-    return 1;
+    fat16_file_close(&file);
+    return ok;
 }
@@ -0,0 +1,198 @@
+#include "fs/fat16.h"
+#include "fs/vfs.h"
+#include "memory/slab.h"
+
+// VFS glue for the FAT volume on the primary disk. The driver already
+// works on absolute paths, so most operations map one to one; open files
+// are a vnode wrapped around a fat16_file_t.
+
+typedef struct
+{
+    vfs_node_t node;
+    fat16_file_t file;
+} fat16_vnode_t;
+
+static kmem_cache_t *vnode_cache = 0;
+
+static void fat16_vfs_stat_entry(const fat16_dir_entry_t *entry, vfs_stat_t *out)
+{
+    out->type = (entry->attr & 0x10) ? VFS_DIR : VFS_FILE;
+    out->size = (entry->attr & 0x10) ? 0 : entry->file_size;
+}
+
+/* -------------------- Namespace -------------------- */
+
+static int fat16_vfs_open(vfs_mount_t *mnt, const char *path, uint32_t flags, vfs_node_t **out)
+{
+    (void)mnt;
+
+    if (!fat16_init())
+        return 0;
+
+    if (!vnode_cache)
+        vnode_cache = kmem_cache_create("fat16-vnode", sizeof(fat16_vnode_t));
+
+    fat16_vnode_t *vn = (fat16_vnode_t *)kmem_cache_alloc(vnode_cache);
+    if (!vn)
+        return 0;
+
+    int ok;
+    int opened = fat16_open(path, &vn->file);
+
+    if (opened)
+    {
+        // Truncating reloads every open file on the entry, this one too.
+        if ((flags & VFS_O_CREAT) && (flags & VFS_O_EXCL))
+            ok = 0;
+        else if (flags & VFS_O_TRUNC)
+            ok = fat16_write_file(path, (const uint8_t *)"", 0);
+        else
+            ok = 1;
+    }
+    else
+    {
+        ok = (flags & VFS_O_CREAT) && fat16_touch(path) && (opened = fat16_open(path, &vn->file));
+    }
+
+    if (!ok)
+    {
+        if (opened)
+            fat16_file_close(&vn->file);
+
+        kmem_cache_free(vnode_cache, vn);
+        return 0;
+    }
+
+    vn->node.size = vn->file.size;
+    vn->node.data = &vn->file;
+    *out = &vn->node;
+    return 1;
+}
+
+static int fat16_vfs_stat(vfs_mount_t *mnt, const char *path, vfs_stat_t *out)
+{
+    (void)mnt;
+
+    fat16_dir_entry_t entry;
+    if (!fat16_init() || !fat16_stat(path, &entry))
+        return 0;
+
+    fat16_vfs_stat_entry(&entry, out);
+    return 1;
+}
+
+typedef struct
+{
+    vfs_readdir_fn fn;
+    void *ctx;
+} fat16_vfs_readdir_ctx_t;
+
+static int fat16_vfs_readdir_entry(void *ctx, const char *name, const fat16_dir_entry_t *entry)
+{
+    fat16_vfs_readdir_ctx_t *rc = (fat16_vfs_readdir_ctx_t *)ctx;
+
+    vfs_stat_t st;
+    fat16_vfs_stat_entry(entry, &st);
+    return rc->fn(rc->ctx, name, &st);
+}
+
+static int fat16_vfs_readdir(vfs_mount_t *mnt, const char *path, vfs_readdir_fn fn, void *ctx)
+{
+    (void)mnt;
+
+    if (!fat16_init())
+        return 0;
+
+    fat16_vfs_readdir_ctx_t rc;
+    rc.fn = fn;
+    rc.ctx = ctx;
+
+    return fat16_readdir(path, fat16_vfs_readdir_entry, &rc);
+}
+
+static int fat16_vfs_mkdir(vfs_mount_t *mnt, const char *path)
+{
+    (void)mnt;
+    return fat16_init() && fat16_mkdir(path);
+}
+
+static int fat16_vfs_remove(vfs_mount_t *mnt, const char *path, int dir)
+{
+    (void)mnt;
+
+    if (!fat16_init())
+        return 0;
+
+    return dir ? fat16_rmdir(path) : fat16_rm(path);
+}
+
+static int fat16_vfs_remove_tree(vfs_mount_t *mnt, const char *path)
+{
+    (void)mnt;
+    return fat16_init() && fat16_rm_rf(path);
+}
+
+static int fat16_vfs_rename(vfs_mount_t *mnt, const char *src, const char *dst)
+{
+    (void)mnt;
+    return fat16_init() && fat16_mv(src, dst);
+}
+
+static int fat16_vfs_copy(vfs_mount_t *mnt, const char *src, const char *dst)
+{
+    (void)mnt;
+    return fat16_init() && fat16_cp(src, dst);
+}
+
+static int fat16_vfs_sync(vfs_mount_t *mnt)
+{
+    (void)mnt;
+
+    if (!fat16_get_volume()->mounted)
+        return 1;
+
+    return fat16_sync();
+}
+
+/* -------------------- Open files -------------------- */
+
+static int fat16_vfs_read(vfs_node_t *node, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read)
+{
+    fat16_file_t *file = (fat16_file_t *)node->data;
+
+    // The size may have changed through a path (truncate, delete).
+    int ok = fat16_file_read(file, offset, out, len, out_read);
+    node->size = file->size;
+    return ok;
+}
+
+static int fat16_vfs_write(vfs_node_t *node, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written)
+{
+    fat16_file_t *file = (fat16_file_t *)node->data;
+
+    int ok = fat16_file_write(file, offset, data, len, out_written);
+    node->size = file->size;
+    return ok;
+}
+
+static void fat16_vfs_close(vfs_node_t *node)
+{
+    fat16_file_close((fat16_file_t *)node->data);
+    kmem_cache_free(vnode_cache, node);
+}
+
+const vfs_ops_t fat16_vfs_ops = {
+    .name = "fat",
+    .open = fat16_vfs_open,
+    .stat = fat16_vfs_stat,
+    .readdir = fat16_vfs_readdir,
+    .mkdir = fat16_vfs_mkdir,
+    .remove = fat16_vfs_remove,
+    .remove_tree = fat16_vfs_remove_tree,
+    .rename = fat16_vfs_rename,
+    .copy = fat16_vfs_copy,
+    .sync = fat16_vfs_sync,
+    .read = fat16_vfs_read,
+    .write = fat16_vfs_write,
+    .close = fat16_vfs_close,
+};
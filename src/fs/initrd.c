@@ -0,0 +1,432 @@
+#include "fs/initrd.h"
+#include "memory/kmalloc.h"
+#include "string.h"
+
+// ustar header fields (offsets into the 512-byte header block).
+#define TAR_BLOCK 512
+#define TAR_NAME 0
+#define TAR_SIZE 124
+#define TAR_TYPE 156
+#define TAR_MAGIC 257
+#define TAR_PREFIX 345
+
+typedef struct
+{
+    char *name; // path inside the archive, no leading or trailing '/'
+    const uint8_t *data;
+    uint32_t size;
+    uint8_t type; // VFS_FILE or VFS_DIR
+} initrd_entry_t;
+
+typedef struct
+{
+    initrd_entry_t *entries;
+    uint32_t count;
+} initrd_t;
+
+/* -------------------- Archive parsing -------------------- */
+
+static uint32_t initrd_octal(const uint8_t *field, int len)
+{
+    uint32_t value = 0;
+
+    for (int i = 0; i < len && field[i] >= '0' && field[i] <= '7'; i++)
+        value = value * 8 + (field[i] - '0');
+
+    return value;
+}
+
+static int initrd_zero_block(const uint8_t *block)
+{
+    for (int i = 0; i < TAR_BLOCK; i++)
+    {
+        if (block[i] != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+int initrd_probe(const uint8_t *base, uint32_t size)
+{
+    if (!base || size < TAR_BLOCK)
+        return 0;
+
+    const uint8_t *m = base + TAR_MAGIC;
+    return m[0] == 'u' && m[1] == 's' && m[2] == 't' && m[3] == 'a' && m[4] == 'r';
+}
+
+// Copy a NUL-padded header field of up to `len` bytes.
+static int initrd_field(char *out, int at, const uint8_t *field, int len)
+{
+    for (int i = 0; i < len && field[i] != '\0'; i++)
+    {
+        if (at >= VFS_PATH_MAX - 1)
+            return -1;
+
+        out[at++] = (char)field[i];
+    }
+
+    return at;
+}
+
+// Header name (with the ustar prefix) without "./", leading or trailing
+// slashes. Returns 0 for names that don't fit or are empty.
+static char *initrd_entry_name(const uint8_t *hdr)
+{
+    char raw[VFS_PATH_MAX];
+    int n = 0;
+
+    if (hdr[TAR_PREFIX] != '\0')
+    {
+        n = initrd_field(raw, 0, hdr + TAR_PREFIX, 155);
+        if (n < 0 || n + 1 >= VFS_PATH_MAX)
+            return 0;
+
+        raw[n++] = '/';
+    }
+
+    n = initrd_field(raw, n, hdr + TAR_NAME, 100);
+    if (n < 0 || n >= VFS_PATH_MAX)
+        return 0;
+
+    raw[n] = '\0';
+
+    const char *s = raw;
+    while (*s == '/' || (s[0] == '.' && s[1] == '/'))
+        s += (*s == '/') ? 1 : 2;
+
+    int len = strlen(s);
+    while (len > 0 && s[len - 1] == '/')
+        len--;
+
+    if (len == 0 || (len == 1 && s[0] == '.'))
+        return 0;
+
+    char *name = (char *)kmalloc(len + 1);
+    if (!name)
+        return 0;
+
+    for (int i = 0; i < len; i++)
+        name[i] = s[i];
+    name[len] = '\0';
+
+    return name;
+}
+
+// Walk the headers; with `fs` unset only count the entries.
+static int initrd_scan(const uint8_t *base, uint32_t size, initrd_t *fs, uint32_t *count)
+{
+    uint32_t off = 0;
+    uint32_t n = 0;
+
+    while (off + TAR_BLOCK <= size)
+    {
+        const uint8_t *hdr = base + off;
+
+        if (initrd_zero_block(hdr))
+            break;
+
+        if (!initrd_probe(hdr, TAR_BLOCK))
+            return 0;
+
+        uint32_t fsize = initrd_octal(hdr + TAR_SIZE, 12);
+        uint32_t data = off + TAR_BLOCK;
+
+        if (fsize > size - data)
+            return 0;
+
+        char type = (char)hdr[TAR_TYPE];
+
+        // Regular files and directories; links and specials are skipped.
+        if (type == '0' || type == '\0' || type == '5')
+        {
+            if (fs)
+            {
+                char *name = initrd_entry_name(hdr);
+
+                if (name)
+                {
+                    initrd_entry_t *e = &fs->entries[fs->count++];
+                    e->name = name;
+                    e->data = base + data;
+                    e->size = (type == '5') ? 0 : fsize;
+                    e->type = (type == '5') ? VFS_DIR : VFS_FILE;
+                }
+            }
+
+            n++;
+        }
+
+        off = data + ((fsize + TAR_BLOCK - 1) / TAR_BLOCK) * TAR_BLOCK;
+    }
+
+    *count = n;
+    return 1;
+}
+
+void *initrd_create(const uint8_t *base, uint32_t size)
+{
+    uint32_t count;
+
+    if (!initrd_probe(base, size) || !initrd_scan(base, size, 0, &count))
+        return 0;
+
+    initrd_t *fs = (initrd_t *)kmalloc(sizeof(initrd_t));
+    if (!fs)
+        return 0;
+
+    fs->count = 0;
+    fs->entries = (initrd_entry_t *)kmalloc(sizeof(initrd_entry_t) * (count ? count : 1));
+
+    if (!fs->entries)
+    {
+        kfree(fs);
+        return 0;
+    }
+
+    initrd_scan(base, size, fs, &count);
+    return fs;
+}
+
+uint32_t initrd_count(void *fs)
+{
+    return ((initrd_t *)fs)->count;
+}
+
+/* -------------------- Lookup -------------------- */
+
+static char initrd_fold(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        return c - 32;
+    return c;
+}
+
+// Compare `len` bytes ignoring case.
+static int initrd_prefix_is(const char *a, const char *b, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        if (a[i] == '\0' || b[i] == '\0' || initrd_fold(a[i]) != initrd_fold(b[i]))
+            return 0;
+    }
+
+    return 1;
+}
+
+// Entry strictly below directory `dir` (no slashes at either end, "" for
+// the root): the first path component after it, or 0.
+static const char *initrd_child(const initrd_entry_t *e, const char *dir, int dir_len, int *child_len)
+{
+    const char *rest = e->name;
+
+    if (dir_len > 0)
+    {
+        if (!initrd_prefix_is(e->name, dir, dir_len) || e->name[dir_len] != '/')
+            return 0;
+
+        rest = e->name + dir_len + 1;
+    }
+
+    int len = 0;
+    while (rest[len] != '\0' && rest[len] != '/')
+        len++;
+
+    *child_len = len;
+    return rest;
+}
+
+// Look `path` up as an entry or an implied directory. Returns the entry
+// (0 for a directory that only exists through its contents).
+static int initrd_lookup(initrd_t *fs, const char *path, initrd_entry_t **out, vfs_stat_t *st)
+{
+    while (*path == '/')
+        path++;
+
+    int len = strlen(path);
+    *out = 0;
+
+    st->type = VFS_DIR;
+    st->size = 0;
+
+    if (len == 0)
+        return 1;
+
+    int found = 0;
+
+    for (uint32_t i = 0; i < fs->count; i++)
+    {
+        initrd_entry_t *e = &fs->entries[i];
+
+        if (!initrd_prefix_is(e->name, path, len))
+            continue;
+
+        if (e->name[len] == '\0')
+        {
+            *out = e;
+            st->type = e->type;
+            st->size = e->size;
+            return 1;
+        }
+
+        if (e->name[len] == '/')
+            found = 1;
+    }
+
+    return found;
+}
+
+/* -------------------- VFS operations -------------------- */
+
+static int initrd_open(vfs_mount_t *mnt, const char *path, uint32_t flags, vfs_node_t **out)
+{
+    initrd_entry_t *e;
+    vfs_stat_t st;
+
+    if ((flags & (VFS_O_TRUNC | VFS_O_EXCL)) ||
+        !initrd_lookup((initrd_t *)mnt->data, path, &e, &st) || st.type != VFS_FILE)
+        return 0;
+
+    vfs_node_t *vn = (vfs_node_t *)kmalloc(sizeof(vfs_node_t));
+    if (!vn)
+        return 0;
+
+    vn->size = e->size;
+    vn->data = e;
+    *out = vn;
+    return 1;
+}
+
+static int initrd_stat(vfs_mount_t *mnt, const char *path, vfs_stat_t *out)
+{
+    initrd_entry_t *e;
+    return initrd_lookup((initrd_t *)mnt->data, path, &e, out);
+}
+
+static int initrd_readdir(vfs_mount_t *mnt, const char *path, vfs_readdir_fn fn, void *ctx)
+{
+    initrd_t *fs = (initrd_t *)mnt->data;
+
+    initrd_entry_t *dir_entry;
+    vfs_stat_t st;
+
+    if (!initrd_lookup(fs, path, &dir_entry, &st) || st.type != VFS_DIR)
+        return 0;
+
+    while (*path == '/')
+        path++;
+
+    int dir_len = strlen(path);
+
+    for (uint32_t i = 0; i < fs->count; i++)
+    {
+        int len;
+        const char *child = initrd_child(&fs->entries[i], path, dir_len, &len);
+        if (!child || len == 0)
+            continue;
+
+        // Report each child once, even when several entries imply it.
+        int seen = 0;
+        for (uint32_t j = 0; j < i && !seen; j++)
+        {
+            int other_len;
+            const char *other = initrd_child(&fs->entries[j], path, dir_len, &other_len);
+            seen = other && other_len == len && initrd_prefix_is(other, child, len);
+        }
+
+        if (seen)
+            continue;
+
+        char name[VFS_NAME_MAX + 1];
+        for (int k = 0; k < len && k < VFS_NAME_MAX; k++)
+            name[k] = child[k];
+        name[len < VFS_NAME_MAX ? len : VFS_NAME_MAX] = '\0';
+
+        if (child[len] == '/')
+        {
+            st.type = VFS_DIR;
+            st.size = 0;
+        }
+        else
+        {
+            st.type = fs->entries[i].type;
+            st.size = fs->entries[i].size;
+        }
+
+        if (!fn(ctx, name, &st))
+            break;
+    }
+
+    return 1;
+}
+
+static int initrd_read_only(vfs_mount_t *mnt, const char *path)
+{
+    (void)mnt;
+    (void)path;
+    return 0;
+}
+
+static int initrd_remove(vfs_mount_t *mnt, const char *path, int dir)
+{
+    (void)mnt;
+    (void)path;
+    (void)dir;
+    return 0;
+}
+
+static int initrd_rename(vfs_mount_t *mnt, const char *src, const char *dst)
+{
+    (void)mnt;
+    (void)src;
+    (void)dst;
+    return 0;
+}
+
+static int initrd_read(vfs_node_t *vn, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read)
+{
+    initrd_entry_t *e = (initrd_entry_t *)vn->data;
+
+    if (offset >= e->size)
+        return 1;
+
+    if (len > e->size - offset)
+        len = e->size - offset;
+
+    for (uint32_t i = 0; i < len; i++)
+        out[i] = e->data[offset + i];
+
+    *out_read = len;
+    return 1;
+}
+
+static int initrd_write(vfs_node_t *vn, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written)
+{
+    (void)vn;
+    (void)offset;
+    (void)data;
+    (void)out_written;
+    return len == 0;
+}
+
+static void initrd_close(vfs_node_t *vn)
+{
+    kfree(vn);
+}
+
+const vfs_ops_t initrd_vfs_ops = {
+    .name = "initrd",
+    .open = initrd_open,
+    .stat = initrd_stat,
+    .readdir = initrd_readdir,
+    .mkdir = initrd_read_only,
+    .remove = initrd_remove,
+    .remove_tree = initrd_read_only,
+    .rename = initrd_rename,
+    .copy = 0,
+    .sync = 0,
+    .read = initrd_read,
+    .write = initrd_write,
+    .close = initrd_close,
+};
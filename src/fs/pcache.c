@@ -0,0 +1,329 @@
+#include "fs/pcache.h"
+#include "memory/layout.h"
+#include "memory/pmm.h"
+#include "string.h"
+
+struct pcache_file
+{
+    uint8_t used;
+    uint8_t stale; // superseded: lookups no longer find it
+    vfs_mount_t *mount;
+    uint32_t generation; // mount generation the pages were read at
+    uint32_t size;
+    uint32_t refs;  // pcache_file_get() holders
+    uint32_t pages; // pages cached for it
+    char path[VFS_PATH_MAX];
+};
+
+typedef struct pcache_page
+{
+    uint8_t *data;       // frame from the page allocator
+    pcache_file_t *file; // 0 = free
+    uint32_t index;      // page index within the file
+    uint32_t maps;
+
+    struct pcache_page *lru_prev;
+    struct pcache_page *lru_next;
+} pcache_page_t;
+
+static pcache_page_t pages[PCACHE_PAGES];
+static pcache_file_t files[PCACHE_FILES];
+
+// LRU list: head = most recently used, tail = reuse candidate.
+static pcache_page_t *lru_head = 0;
+static pcache_page_t *lru_tail = 0;
+
+static pcache_stats_t stats;
+
+/* -------------------- Helpers -------------------- */
+
+static void lru_unlink(pcache_page_t *p)
+{
+    if (p->lru_prev)
+        p->lru_prev->lru_next = p->lru_next;
+    else
+        lru_head = p->lru_next;
+
+    if (p->lru_next)
+        p->lru_next->lru_prev = p->lru_prev;
+    else
+        lru_tail = p->lru_prev;
+
+    p->lru_prev = 0;
+    p->lru_next = 0;
+}
+
+static void lru_push_front(pcache_page_t *p)
+{
+    p->lru_prev = 0;
+    p->lru_next = lru_head;
+
+    if (lru_head)
+        lru_head->lru_prev = p;
+    lru_head = p;
+
+    if (!lru_tail)
+        lru_tail = p;
+}
+
+static void lru_push_back(pcache_page_t *p)
+{
+    p->lru_next = 0;
+    p->lru_prev = lru_tail;
+
+    if (lru_tail)
+        lru_tail->lru_next = p;
+    lru_tail = p;
+
+    if (!lru_head)
+        lru_head = p;
+}
+
+static char pcache_fold(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        return c - 32;
+    return c;
+}
+
+static int pcache_path_eq(const char *a, const char *b)
+{
+    while (*a && pcache_fold(*a) == pcache_fold(*b))
+    {
+        a++;
+        b++;
+    }
+
+    return *a == *b;
+}
+
+// Release the slot of a retired file once nothing refers to it.
+static void pcache_file_reap(pcache_file_t *f)
+{
+    if (f->used && f->stale && f->refs == 0 && f->pages == 0)
+        f->used = 0;
+}
+
+static void pcache_page_free(pcache_page_t *p)
+{
+    if (p->file)
+    {
+        pcache_file_t *f = p->file;
+
+        p->file = 0;
+        f->pages--;
+        stats.cached--;
+        pcache_file_reap(f);
+    }
+
+    lru_unlink(p);
+    lru_push_back(p);
+}
+
+// Stop handing out this copy of the file. Mapped pages stay with their
+// mappings and are freed when the last one goes.
+static void pcache_file_retire(pcache_file_t *f)
+{
+    f->stale = 1;
+
+    for (int i = 0; i < PCACHE_PAGES; i++)
+    {
+        if (pages[i].file == f && pages[i].maps == 0)
+            pcache_page_free(&pages[i]);
+    }
+
+    pcache_file_reap(f);
+}
+
+/* ------------------- Public API ------------------- */
+
+void pcache_init()
+{
+    lru_head = 0;
+    lru_tail = 0;
+
+    // Pages the allocator can't back stay off the LRU list for good.
+    for (int i = 0; i < PCACHE_PAGES; i++)
+    {
+        pages[i].data = (uint8_t *)pmm_alloc_page();
+        pages[i].file = 0;
+        pages[i].index = 0;
+        pages[i].maps = 0;
+        pages[i].lru_prev = 0;
+        pages[i].lru_next = 0;
+
+        if (pages[i].data)
+            lru_push_back(&pages[i]);
+    }
+
+    for (int i = 0; i < PCACHE_FILES; i++)
+        files[i].used = 0;
+
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.cached = 0;
+    stats.mapped = 0;
+}
+
+pcache_file_t *pcache_file_get(vfs_node_t *node, const char *path)
+{
+    if (!node || !path)
+        return 0;
+
+    vfs_mount_t *m = node->mount;
+
+    for (int i = 0; i < PCACHE_FILES; i++)
+    {
+        pcache_file_t *f = &files[i];
+
+        if (!f->used || f->stale || f->mount != m || !pcache_path_eq(f->path, path))
+            continue;
+
+        if (f->generation == m->generation && f->size == node->size)
+        {
+            f->refs++;
+            return f;
+        }
+
+        pcache_file_retire(f);
+    }
+
+    pcache_file_t *slot = 0;
+
+    for (int i = 0; i < PCACHE_FILES && !slot; i++)
+    {
+        if (!files[i].used)
+            slot = &files[i];
+    }
+
+    // Out of slots: give up the cached pages of a file nobody holds.
+    for (int i = 0; i < PCACHE_FILES && !slot; i++)
+    {
+        if (files[i].refs == 0)
+        {
+            pcache_file_retire(&files[i]);
+            if (!files[i].used)
+                slot = &files[i];
+        }
+    }
+
+    if (!slot || strlen(path) >= VFS_PATH_MAX)
+        return 0;
+
+    slot->used = 1;
+    slot->stale = 0;
+    slot->mount = m;
+    slot->generation = m->generation;
+    slot->size = node->size;
+    slot->refs = 1;
+    slot->pages = 0;
+    strcpy(slot->path, path);
+
+    return slot;
+}
+
+void pcache_file_put(pcache_file_t *file)
+{
+    if (!file)
+        return;
+
+    if (file->refs > 0)
+        file->refs--;
+
+    pcache_file_reap(file);
+}
+
+int pcache_page_get(pcache_file_t *file, vfs_node_t *node, uint32_t index, uint32_t *frame)
+{
+    if (!file || !node || !frame)
+        return 0;
+
+    if (index >= (file->size + PAGE_SIZE - 1) / PAGE_SIZE)
+        return 0;
+
+    for (int i = 0; i < PCACHE_PAGES; i++)
+    {
+        pcache_page_t *p = &pages[i];
+
+        if (p->file != file || p->index != index)
+            continue;
+
+        if (p->maps++ == 0)
+            stats.mapped++;
+
+        stats.hits++;
+        lru_unlink(p);
+        lru_push_front(p);
+
+        *frame = (uint32_t)p->data;
+        return 1;
+    }
+
+    // Reuse the least recently used page that nobody has mapped.
+    pcache_page_t *p = lru_tail;
+    while (p && p->maps)
+        p = p->lru_prev;
+
+    if (!p)
+        return -1;
+
+    pcache_page_free(p);
+
+    uint8_t *data = p->data;
+    uint32_t got = 0;
+
+    if (!vfs_read(node, index * PAGE_SIZE, data, PAGE_SIZE, &got) || got == 0)
+        return 0;
+
+    // The tail of the last page reads as zeros.
+    if (got < PAGE_SIZE)
+        memset(data + got, 0, PAGE_SIZE - got);
+
+    p->file = file;
+    p->index = index;
+    p->maps = 1;
+    file->pages++;
+
+    stats.misses++;
+    stats.cached++;
+    stats.mapped++;
+
+    lru_unlink(p);
+    lru_push_front(p);
+
+    *frame = (uint32_t)data;
+    return 1;
+}
+
+void pcache_page_put(uint32_t frame)
+{
+    pcache_page_t *p = 0;
+
+    for (int i = 0; i < PCACHE_PAGES && !p; i++)
+    {
+        if (pages[i].data && (uint32_t)pages[i].data == frame)
+            p = &pages[i];
+    }
+
+    if (!p || p->maps == 0 || --p->maps > 0)
+        return;
+
+    stats.mapped--;
+
+    if (p->file && p->file->stale)
+        pcache_page_free(p);
+}
+
+void pcache_drop()
+{
+    for (int i = 0; i < PCACHE_FILES; i++)
+    {
+        if (files[i].used && !files[i].stale)
+            pcache_file_retire(&files[i]);
+    }
+}
+
+pcache_stats_t pcache_get_stats()
+{
+    return stats;
+}
@@ -0,0 +1,518 @@
+#include "fs/tmpfs.h"
+#include "memory/kmalloc.h"
+#include "memory/slab.h"
+#include "string.h"
+
+// A tree of heap nodes. File data is one contiguous buffer that grows by
+// doubling. A node removed while open stays allocated (unlinked) until
+// its last vnode is closed.
+
+typedef struct tmpfs_node
+{
+    char name[VFS_NAME_MAX + 1];
+    uint8_t type; // VFS_FILE or VFS_DIR
+    uint8_t unlinked;
+    uint32_t opens;
+
+    uint8_t *data;
+    uint32_t size;
+    uint32_t capacity;
+
+    struct tmpfs_node *parent;
+    struct tmpfs_node *children;
+    struct tmpfs_node *next; // sibling
+} tmpfs_node_t;
+
+typedef struct
+{
+    tmpfs_node_t root;
+    tmpfs_stats_t stats;
+} tmpfs_t;
+
+static kmem_cache_t *node_cache = 0;
+
+#define TMPFS_MIN_CAPACITY 64
+
+/* -------------------- Helpers -------------------- */
+
+static char tmpfs_fold(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        return c - 32;
+    return c;
+}
+
+// Compare `len` bytes of `name` against a node name, ignoring case.
+static int tmpfs_name_is(const tmpfs_node_t *node, const char *name, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        if (node->name[i] == '\0' || tmpfs_fold(node->name[i]) != tmpfs_fold(name[i]))
+            return 0;
+    }
+
+    return node->name[len] == '\0';
+}
+
+static tmpfs_node_t *tmpfs_child(tmpfs_node_t *dir, const char *name, int len)
+{
+    for (tmpfs_node_t *n = dir->children; n; n = n->next)
+    {
+        if (tmpfs_name_is(n, name, len))
+            return n;
+    }
+
+    return 0;
+}
+
+// Walk an absolute path from the root.
+static tmpfs_node_t *tmpfs_lookup(tmpfs_t *fs, const char *path)
+{
+    tmpfs_node_t *node = &fs->root;
+    int i = 0;
+
+    while (path[i] != '\0')
+    {
+        while (path[i] == '/')
+            i++;
+
+        if (path[i] == '\0')
+            break;
+
+        int start = i;
+        while (path[i] != '\0' && path[i] != '/')
+            i++;
+
+        if (node->type != VFS_DIR)
+            return 0;
+
+        node = tmpfs_child(node, path + start, i - start);
+        if (!node)
+            return 0;
+    }
+
+    return node;
+}
+
+// Resolve the parent directory of `path` and point `name` at the last
+// component.
+static tmpfs_node_t *tmpfs_lookup_parent(tmpfs_t *fs, const char *path, const char **name)
+{
+    char parent[VFS_PATH_MAX];
+    int slash = -1;
+    int len = strlen(path);
+
+    for (int i = len - 1; i >= 0; i--)
+    {
+        if (path[i] == '/')
+        {
+            slash = i;
+            break;
+        }
+    }
+
+    if (slash < 0 || slash == len - 1 || len >= VFS_PATH_MAX)
+        return 0;
+
+    for (int i = 0; i < slash; i++)
+        parent[i] = path[i];
+    parent[slash] = '\0';
+
+    *name = path + slash + 1;
+
+    tmpfs_node_t *dir = tmpfs_lookup(fs, parent);
+    if (!dir || dir->type != VFS_DIR)
+        return 0;
+
+    return dir;
+}
+
+static int tmpfs_name_valid(const char *name)
+{
+    int len = strlen(name);
+
+    if (len == 0 || len > VFS_NAME_MAX)
+        return 0;
+
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        return 0;
+
+    return 1;
+}
+
+static tmpfs_node_t *tmpfs_create_node(tmpfs_t *fs, tmpfs_node_t *dir, const char *name, uint8_t type)
+{
+    if (!tmpfs_name_valid(name) || tmpfs_child(dir, name, strlen(name)))
+        return 0;
+
+    if (!node_cache)
+        node_cache = kmem_cache_create("tmpfs-node", sizeof(tmpfs_node_t));
+
+    tmpfs_node_t *node = (tmpfs_node_t *)kmem_cache_alloc(node_cache);
+    if (!node)
+        return 0;
+
+    memset(node, 0, sizeof(tmpfs_node_t));
+    strcpy(node->name, name);
+    node->type = type;
+    node->parent = dir;
+    node->next = dir->children;
+    dir->children = node;
+
+    if (type == VFS_DIR)
+        fs->stats.dirs++;
+    else
+        fs->stats.files++;
+
+    return node;
+}
+
+static void tmpfs_unlink(tmpfs_node_t *node)
+{
+    tmpfs_node_t **link = &node->parent->children;
+
+    while (*link && *link != node)
+        link = &(*link)->next;
+
+    if (*link)
+        *link = node->next;
+
+    node->next = 0;
+    node->parent = 0;
+}
+
+static void tmpfs_free_data(tmpfs_t *fs, tmpfs_node_t *node)
+{
+    if (node->data)
+    {
+        fs->stats.bytes -= node->capacity;
+        kfree(node->data);
+    }
+
+    node->data = 0;
+    node->size = 0;
+    node->capacity = 0;
+}
+
+// Drop a node that is no longer linked into the tree. Open files are
+// released by their last close instead.
+static void tmpfs_release(tmpfs_t *fs, tmpfs_node_t *node)
+{
+    if (node->opens > 0)
+    {
+        node->unlinked = 1;
+        return;
+    }
+
+    if (node->type == VFS_DIR)
+        fs->stats.dirs--;
+    else
+        fs->stats.files--;
+
+    tmpfs_free_data(fs, node);
+    kmem_cache_free(node_cache, node);
+}
+
+static void tmpfs_release_tree(tmpfs_t *fs, tmpfs_node_t *node)
+{
+    while (node->children)
+    {
+        tmpfs_node_t *child = node->children;
+        tmpfs_unlink(child);
+        tmpfs_release_tree(fs, child);
+    }
+
+    tmpfs_release(fs, node);
+}
+
+// Make room for `need` bytes of file data, doubling to keep appends
+// cheap. Fails when the instance limit or the heap runs out.
+static int tmpfs_reserve(tmpfs_t *fs, tmpfs_node_t *node, uint32_t need)
+{
+    if (need <= node->capacity)
+        return 1;
+
+    uint32_t cap = node->capacity ? node->capacity : TMPFS_MIN_CAPACITY;
+    while (cap < need && cap < 0x80000000u)
+        cap *= 2;
+
+    if (cap < need)
+        cap = need;
+
+    uint32_t room = fs->stats.max_bytes - fs->stats.bytes + node->capacity;
+
+    if (cap > room)
+        cap = need;
+
+    if (cap > room)
+        return 0;
+
+    uint8_t *data = (uint8_t *)kmalloc(cap);
+    if (!data)
+        return 0;
+
+    for (uint32_t i = 0; i < node->size; i++)
+        data[i] = node->data[i];
+
+    if (node->data)
+        kfree(node->data);
+
+    fs->stats.bytes += cap - node->capacity;
+    node->data = data;
+    node->capacity = cap;
+    return 1;
+}
+
+/* -------------------- Namespace -------------------- */
+
+static int tmpfs_open(vfs_mount_t *mnt, const char *path, uint32_t flags, vfs_node_t **out)
+{
+    tmpfs_t *fs = (tmpfs_t *)mnt->data;
+    tmpfs_node_t *node = tmpfs_lookup(fs, path);
+
+    if (node)
+    {
+        if ((flags & VFS_O_CREAT) && (flags & VFS_O_EXCL))
+            return 0;
+    }
+    else
+    {
+        const char *name;
+        tmpfs_node_t *dir;
+
+        if (!(flags & VFS_O_CREAT) || !(dir = tmpfs_lookup_parent(fs, path, &name)))
+            return 0;
+
+        node = tmpfs_create_node(fs, dir, name, VFS_FILE);
+        if (!node)
+            return 0;
+    }
+
+    if (node->type != VFS_FILE)
+        return 0;
+
+    vfs_node_t *vn = (vfs_node_t *)kmalloc(sizeof(vfs_node_t));
+    if (!vn)
+        return 0;
+
+    if (flags & VFS_O_TRUNC)
+        tmpfs_free_data(fs, node);
+
+    node->opens++;
+
+    vn->size = node->size;
+    vn->data = node;
+    *out = vn;
+    return 1;
+}
+
+static int tmpfs_stat(vfs_mount_t *mnt, const char *path, vfs_stat_t *out)
+{
+    tmpfs_node_t *node = tmpfs_lookup((tmpfs_t *)mnt->data, path);
+    if (!node)
+        return 0;
+
+    out->type = node->type;
+    out->size = node->size;
+    return 1;
+}
+
+static int tmpfs_readdir(vfs_mount_t *mnt, const char *path, vfs_readdir_fn fn, void *ctx)
+{
+    tmpfs_node_t *dir = tmpfs_lookup((tmpfs_t *)mnt->data, path);
+    if (!dir || dir->type != VFS_DIR)
+        return 0;
+
+    for (tmpfs_node_t *n = dir->children; n; n = n->next)
+    {
+        vfs_stat_t st;
+        st.type = n->type;
+        st.size = n->size;
+
+        if (!fn(ctx, n->name, &st))
+            break;
+    }
+
+    return 1;
+}
+
+static int tmpfs_mkdir(vfs_mount_t *mnt, const char *path)
+{
+    tmpfs_t *fs = (tmpfs_t *)mnt->data;
+
+    const char *name;
+    tmpfs_node_t *dir = tmpfs_lookup_parent(fs, path, &name);
+    if (!dir)
+        return 0;
+
+    return tmpfs_create_node(fs, dir, name, VFS_DIR) != 0;
+}
+
+static int tmpfs_remove(vfs_mount_t *mnt, const char *path, int dir)
+{
+    tmpfs_t *fs = (tmpfs_t *)mnt->data;
+    tmpfs_node_t *node = tmpfs_lookup(fs, path);
+
+    if (!node || node == &fs->root)
+        return 0;
+
+    if ((node->type == VFS_DIR) != (dir != 0))
+        return -1;
+
+    if (node->children)
+        return -2;
+
+    tmpfs_unlink(node);
+    tmpfs_release(fs, node);
+    return 1;
+}
+
+static int tmpfs_remove_tree(vfs_mount_t *mnt, const char *path)
+{
+    tmpfs_t *fs = (tmpfs_t *)mnt->data;
+    tmpfs_node_t *node = tmpfs_lookup(fs, path);
+
+    if (!node || node == &fs->root)
+        return 0;
+
+    tmpfs_unlink(node);
+    tmpfs_release_tree(fs, node);
+    return 1;
+}
+
+static int tmpfs_rename(vfs_mount_t *mnt, const char *src, const char *dst)
+{
+    tmpfs_t *fs = (tmpfs_t *)mnt->data;
+    tmpfs_node_t *node = tmpfs_lookup(fs, src);
+
+    if (!node || node == &fs->root || tmpfs_lookup(fs, dst))
+        return 0;
+
+    const char *name;
+    tmpfs_node_t *dir = tmpfs_lookup_parent(fs, dst, &name);
+    if (!dir || !tmpfs_name_valid(name))
+        return 0;
+
+    // A directory can't move below itself.
+    for (tmpfs_node_t *p = dir; p; p = p->parent)
+    {
+        if (p == node)
+            return 0;
+    }
+
+    tmpfs_unlink(node);
+    strcpy(node->name, name);
+    node->parent = dir;
+    node->next = dir->children;
+    dir->children = node;
+    return 1;
+}
+
+/* -------------------- Open files -------------------- */
+
+static int tmpfs_read(vfs_node_t *vn, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read)
+{
+    tmpfs_node_t *node = (tmpfs_node_t *)vn->data;
+
+    if (offset >= node->size)
+        return 1;
+
+    if (len > node->size - offset)
+        len = node->size - offset;
+
+    for (uint32_t i = 0; i < len; i++)
+        out[i] = node->data[offset + i];
+
+    *out_read = len;
+    return 1;
+}
+
+static int tmpfs_write(vfs_node_t *vn, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written)
+{
+    tmpfs_node_t *node = (tmpfs_node_t *)vn->data;
+    tmpfs_t *fs = (tmpfs_t *)vn->mount->data;
+
+    if (len == 0)
+        return 1;
+
+    if (offset + len < offset)
+        return 0;
+
+    // Out of room: write as much as still fits.
+    uint32_t n = len;
+    if (!tmpfs_reserve(fs, node, offset + len))
+    {
+        uint32_t end = node->capacity + (fs->stats.max_bytes - fs->stats.bytes);
+
+        if (end <= offset || !tmpfs_reserve(fs, node, end))
+            end = node->capacity;
+
+        n = (end > offset) ? end - offset : 0;
+    }
+
+    if (n == 0)
+        return 0;
+
+    // A gap past the old end reads back as zeros.
+    for (uint32_t i = node->size; i < offset; i++)
+        node->data[i] = 0;
+
+    for (uint32_t i = 0; i < n; i++)
+        node->data[offset + i] = data[i];
+
+    if (offset + n > node->size)
+        node->size = offset + n;
+
+    vn->size = node->size;
+    *out_written = n;
+    return n == len;
+}
+
+static void tmpfs_close(vfs_node_t *vn)
+{
+    tmpfs_node_t *node = (tmpfs_node_t *)vn->data;
+    tmpfs_t *fs = (tmpfs_t *)vn->mount->data;
+
+    if (node->opens > 0)
+        node->opens--;
+
+    if (node->unlinked && node->opens == 0)
+        tmpfs_release(fs, node);
+
+    kfree(vn);
+}
+
+/* -------------------- Public API -------------------- */
+
+void *tmpfs_create(uint32_t max_bytes)
+{
+    tmpfs_t *fs = (tmpfs_t *)kmalloc(sizeof(tmpfs_t));
+    if (!fs)
+        return 0;
+
+    memset(fs, 0, sizeof(tmpfs_t));
+    fs->root.type = VFS_DIR;
+    fs->stats.max_bytes = max_bytes;
+    return fs;
+}
+
+tmpfs_stats_t tmpfs_get_stats(void *fs)
+{
+    return ((tmpfs_t *)fs)->stats;
+}
+
+const vfs_ops_t tmpfs_vfs_ops = {
+    .name = "tmpfs",
+    .open = tmpfs_open,
+    .stat = tmpfs_stat,
+    .readdir = tmpfs_readdir,
+    .mkdir = tmpfs_mkdir,
+    .remove = tmpfs_remove,
+    .remove_tree = tmpfs_remove_tree,
+    .rename = tmpfs_rename,
+    .copy = 0,
+    .sync = 0,
+    .read = tmpfs_read,
+    .write = tmpfs_write,
+    .close = tmpfs_close,
+};
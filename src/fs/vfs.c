@@ -0,0 +1,777 @@
+#include "fs/vfs.h"
+#include "memory/kmalloc.h"
+#include "string.h"
+
+static vfs_mount_t mounts[VFS_MAX_MOUNTS];
+
+static char cwd[VFS_PATH_MAX] = "/";
+
+// Staging buffer size for copies that cross filesystems.
+#define VFS_COPY_CHUNK (32 * 1024)
+
+/* -------------------- Paths -------------------- */
+
+static char vfs_fold(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        return c - 32;
+    return c;
+}
+
+// Does `prefix` (length `len`) name `path` or one of its ancestors?
+static int vfs_path_under(const char *path, const char *prefix, uint32_t len)
+{
+    if (len == 1)
+        return 1; // "/"
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        if (path[i] == '\0' || vfs_fold(path[i]) != vfs_fold(prefix[i]))
+            return 0;
+    }
+
+    return path[len] == '\0' || path[len] == '/';
+}
+
+// Do two absolute paths name the same place, ignoring case?
+static int vfs_path_eq(const char *a, const char *b)
+{
+    uint32_t len = strlen(a);
+    return (uint32_t)strlen(b) == len && (len == 1 ? a[0] == b[0] : vfs_path_under(a, b, len));
+}
+
+static int vfs_join(char *out, const char *dir, const char *name)
+{
+    if (strlen(dir) + strlen(name) + 2 > VFS_PATH_MAX)
+        return 0;
+
+    strcpy(out, dir);
+    if (strcmp(out, "/") != 0)
+        strcat(out, "/");
+    strcat(out, name);
+    return 1;
+}
+
+// Last component of a normalized path ("" for the root).
+static const char *vfs_basename(const char *path)
+{
+    const char *name = path;
+
+    for (const char *p = path; *p; p++)
+    {
+        if (*p == '/')
+            name = p + 1;
+    }
+
+    return name;
+}
+
+void vfs_normalize(const char *path, char *out)
+{
+    char temp[VFS_PATH_MAX];
+    int ti = 0;
+
+    if (path[0] != '/')
+    {
+        for (int i = 0; cwd[i] != '\0' && ti < VFS_PATH_MAX - 1; i++)
+            temp[ti++] = cwd[i];
+    }
+
+    if (ti < VFS_PATH_MAX - 1)
+        temp[ti++] = '/';
+
+    for (int i = 0; path[i] != '\0' && ti < VFS_PATH_MAX - 1; i++)
+        temp[ti++] = path[i];
+
+    temp[ti] = '\0';
+
+    // Components as (start, length) pairs into `temp`.
+    int part_start[64];
+    int part_len[64];
+    int top = 0;
+
+    int i = 0;
+    while (temp[i] != '\0')
+    {
+        while (temp[i] == '/')
+            i++;
+
+        if (temp[i] == '\0')
+            break;
+
+        int start = i;
+        while (temp[i] != '\0' && temp[i] != '/')
+            i++;
+
+        int len = i - start;
+
+        if (len == 1 && temp[start] == '.')
+            continue;
+
+        if (len == 2 && temp[start] == '.' && temp[start + 1] == '.')
+        {
+            if (top > 0)
+                top--;
+            continue;
+        }
+
+        if (top < 64)
+        {
+            part_start[top] = start;
+            part_len[top] = len;
+            top++;
+        }
+    }
+
+    int oi = 0;
+    out[oi++] = '/';
+
+    for (int j = 0; j < top; j++)
+    {
+        for (int k = 0; k < part_len[j]; k++)
+            out[oi++] = temp[part_start[j] + k];
+
+        if (j != top - 1)
+            out[oi++] = '/';
+    }
+
+    out[oi] = '\0';
+}
+
+// Find the mount holding `abs` (longest prefix wins) and the path inside
+// it. `sub` holds VFS_PATH_MAX bytes.
+static vfs_mount_t *vfs_lookup_mount(const char *abs, char *sub)
+{
+    vfs_mount_t *best = 0;
+
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++)
+    {
+        vfs_mount_t *m = &mounts[i];
+
+        if (!m->used || !vfs_path_under(abs, m->path, m->path_len))
+            continue;
+
+        if (!best || m->path_len > best->path_len)
+            best = m;
+    }
+
+    if (!best)
+        return 0;
+
+    const char *rest = (best->path_len == 1) ? abs : abs + best->path_len;
+
+    if (rest[0] == '\0')
+        strcpy(sub, "/");
+    else
+        strcpy(sub, rest);
+
+    return best;
+}
+
+static void vfs_changed(vfs_mount_t *m)
+{
+    m->generation++;
+}
+
+static vfs_mount_t *vfs_resolve(const char *path, char *abs, char *sub)
+{
+    if (!path || path[0] == '\0')
+        return 0;
+
+    vfs_normalize(path, abs);
+    return vfs_lookup_mount(abs, sub);
+}
+
+/* -------------------- Mounts -------------------- */
+
+void vfs_init()
+{
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++)
+        mounts[i].used = 0;
+
+    strcpy(cwd, "/");
+}
+
+int vfs_mount(const char *path, const vfs_ops_t *ops, void *data)
+{
+    if (!path || path[0] != '/' || !ops)
+        return 0;
+
+    char abs[VFS_PATH_MAX];
+    vfs_normalize(path, abs);
+
+    vfs_mount_t *slot = 0;
+
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++)
+    {
+        vfs_mount_t *m = &mounts[i];
+
+        if (m->used && m->path_len == (uint32_t)strlen(abs) && vfs_path_under(abs, m->path, m->path_len))
+            return 0; // already a mount point
+
+        if (!m->used && !slot)
+            slot = m;
+    }
+
+    if (!slot)
+        return 0;
+
+    strcpy(slot->path, abs);
+    slot->path_len = strlen(abs);
+    slot->ops = ops;
+    slot->data = data;
+    slot->generation = 0;
+    slot->used = 1;
+    return 1;
+}
+
+const vfs_mount_t *vfs_get_mount(int index)
+{
+    int n = 0;
+
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++)
+    {
+        if (!mounts[i].used)
+            continue;
+
+        if (n++ == index)
+            return &mounts[i];
+    }
+
+    return 0;
+}
+
+/* -------------------- Working directory -------------------- */
+
+int vfs_chdir(const char *path)
+{
+    char abs[VFS_PATH_MAX];
+    char sub[VFS_PATH_MAX];
+
+    vfs_mount_t *m = vfs_resolve(path, abs, sub);
+    if (!m)
+        return 0;
+
+    vfs_stat_t st;
+    if (!m->ops->stat(m, sub, &st) || st.type != VFS_DIR)
+        return 0;
+
+    strcpy(cwd, abs);
+    return 1;
+}
+
+const char *vfs_getcwd()
+{
+    return cwd;
+}
+
+/* -------------------- Namespace -------------------- */
+
+int vfs_stat(const char *path, vfs_stat_t *out)
+{
+    char abs[VFS_PATH_MAX];
+    char sub[VFS_PATH_MAX];
+
+    vfs_mount_t *m = vfs_resolve(path, abs, sub);
+    if (!m || !out)
+        return 0;
+
+    return m->ops->stat(m, sub, out);
+}
+
+typedef struct
+{
+    vfs_readdir_fn fn;
+    void *ctx;
+    const char *dir;
+    uint32_t shown; // bit per mount already listed by the filesystem
+    int stopped;
+} vfs_readdir_ctx_t;
+
+// Mount table index of a mount point named `name` directly inside `dir`.
+static int vfs_mount_in_dir(const char *dir, const char *name)
+{
+    char child[VFS_PATH_MAX];
+    if (!vfs_join(child, dir, name))
+        return -1;
+
+    uint32_t len = strlen(child);
+
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++)
+    {
+        if (mounts[i].used && mounts[i].path_len == len && vfs_path_under(child, mounts[i].path, len))
+            return i;
+    }
+
+    return -1;
+}
+
+static int vfs_readdir_entry(void *ctx, const char *name, const vfs_stat_t *st)
+{
+    vfs_readdir_ctx_t *rc = (vfs_readdir_ctx_t *)ctx;
+
+    // A directory covered by a mount lists as the mounted root.
+    int m = vfs_mount_in_dir(rc->dir, name);
+    if (m >= 0)
+        rc->shown |= 1u << m;
+
+    if (!rc->fn(rc->ctx, name, st))
+    {
+        rc->stopped = 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+int vfs_readdir(const char *path, vfs_readdir_fn fn, void *ctx)
+{
+    char abs[VFS_PATH_MAX];
+    char sub[VFS_PATH_MAX];
+
+    vfs_mount_t *m = vfs_resolve(path, abs, sub);
+    if (!m || !fn)
+        return 0;
+
+    vfs_readdir_ctx_t rc;
+    rc.fn = fn;
+    rc.ctx = ctx;
+    rc.dir = abs;
+    rc.shown = 0;
+    rc.stopped = 0;
+
+    if (!m->ops->readdir(m, sub, vfs_readdir_entry, &rc))
+        return 0;
+
+    // Mount points the parent filesystem doesn't have an entry for.
+    for (int i = 0; i < VFS_MAX_MOUNTS && !rc.stopped; i++)
+    {
+        vfs_mount_t *mm = &mounts[i];
+
+        if (!mm->used || (rc.shown & (1u << i)) || mm->path_len == 1)
+            continue;
+
+        const char *name = vfs_basename(mm->path);
+        if (vfs_mount_in_dir(abs, name) != i)
+            continue;
+
+        vfs_stat_t st;
+        st.type = VFS_DIR;
+        st.size = 0;
+
+        if (!fn(ctx, name, &st))
+            break;
+    }
+
+    return 1;
+}
+
+typedef struct
+{
+    char *out;
+    uint32_t size;
+    uint32_t written;
+} vfs_list_ctx_t;
+
+static int vfs_list_entry(void *ctx, const char *name, const vfs_stat_t *st)
+{
+    vfs_list_ctx_t *lc = (vfs_list_ctx_t *)ctx;
+    uint32_t len = strlen(name);
+
+    (void)st;
+
+    // Room for the name, the newline and the terminator.
+    if (lc->written + len + 2 > lc->size)
+        return 0;
+
+    for (uint32_t i = 0; i < len; i++)
+        lc->out[lc->written++] = name[i];
+
+    lc->out[lc->written++] = '\n';
+    lc->out[lc->written] = '\0';
+    return 1;
+}
+
+int vfs_list_dir(const char *path, char *out, uint32_t out_size, uint32_t *out_written)
+{
+    if (!out || out_size == 0 || !out_written)
+        return 0;
+
+    out[0] = '\0';
+    *out_written = 0;
+
+    vfs_list_ctx_t lc;
+    lc.out = out;
+    lc.size = out_size;
+    lc.written = 0;
+
+    if (!vfs_readdir(path, vfs_list_entry, &lc))
+        return 0;
+
+    *out_written = lc.written;
+    return 1;
+}
+
+int vfs_mkdir(const char *path)
+{
+    char abs[VFS_PATH_MAX];
+    char sub[VFS_PATH_MAX];
+
+    vfs_mount_t *m = vfs_resolve(path, abs, sub);
+    if (!m || strcmp(sub, "/") == 0)
+        return 0;
+
+    return m->ops->mkdir(m, sub);
+}
+
+int vfs_mkdir_p(const char *path)
+{
+    if (!path || path[0] == '\0')
+        return 0;
+
+    char abs[VFS_PATH_MAX];
+    vfs_normalize(path, abs);
+
+    // Walk the components through the VFS so the tree may cross mounts.
+    char prefix[VFS_PATH_MAX];
+
+    for (int i = 1;; i++)
+    {
+        if (abs[i] != '/' && abs[i] != '\0')
+            continue;
+
+        for (int k = 0; k < i; k++)
+            prefix[k] = abs[k];
+        prefix[i] = '\0';
+
+        vfs_stat_t st;
+        if (vfs_stat(prefix, &st))
+        {
+            if (st.type != VFS_DIR)
+                return 0;
+        }
+        else if (!vfs_mkdir(prefix))
+        {
+            return 0;
+        }
+
+        if (abs[i] == '\0')
+            break;
+    }
+
+    return 1;
+}
+
+int vfs_remove(const char *path, int dir)
+{
+    char abs[VFS_PATH_MAX];
+    char sub[VFS_PATH_MAX];
+
+    vfs_mount_t *m = vfs_resolve(path, abs, sub);
+    if (!m || strcmp(sub, "/") == 0)
+        return 0;
+
+    vfs_changed(m);
+    return m->ops->remove(m, sub, dir);
+}
+
+int vfs_remove_tree(const char *path)
+{
+    char abs[VFS_PATH_MAX];
+    char sub[VFS_PATH_MAX];
+
+    vfs_mount_t *m = vfs_resolve(path, abs, sub);
+    if (!m || strcmp(sub, "/") == 0)
+        return 0;
+
+    vfs_changed(m);
+    return m->ops->remove_tree(m, sub);
+}
+
+/* -------------------- Copy / rename -------------------- */
+
+// Resolve a cp/mv destination: an existing directory receives the source
+// under its own name.
+static int vfs_target(const char *src_abs, const char *dst, char *dst_abs)
+{
+    vfs_normalize(dst, dst_abs);
+
+    vfs_stat_t st;
+    if (vfs_stat(dst_abs, &st) && st.type == VFS_DIR)
+    {
+        char dir[VFS_PATH_MAX];
+        strcpy(dir, dst_abs);
+
+        if (!vfs_join(dst_abs, dir, vfs_basename(src_abs)))
+            return 0;
+    }
+
+    return 1;
+}
+
+static int vfs_copy_file(const char *src, const char *dst, uint8_t *buf)
+{
+    vfs_node_t *in;
+    if (!vfs_open(src, 0, &in))
+        return 0;
+
+    // Open without truncating first: if both names reach the same file,
+    // truncating the destination would empty the source.
+    vfs_node_t *out;
+    if (!vfs_open(dst, VFS_O_CREAT, &out))
+    {
+        vfs_close(in);
+        return 0;
+    }
+
+    int same = out->ops == in->ops && out->data == in->data;
+    vfs_close(out);
+
+    if (same || !vfs_open(dst, VFS_O_CREAT | VFS_O_TRUNC, &out))
+    {
+        vfs_close(in);
+        return 0;
+    }
+
+    uint32_t offset = 0;
+    int ok = 1;
+
+    while (ok && offset < in->size)
+    {
+        uint32_t n = 0;
+        if (!vfs_read(in, offset, buf, VFS_COPY_CHUNK, &n) || n == 0)
+        {
+            ok = 0;
+            break;
+        }
+
+        uint32_t written = 0;
+        ok = vfs_write(out, offset, buf, n, &written);
+        offset += n;
+    }
+
+    vfs_close(out);
+    vfs_close(in);
+    return ok;
+}
+
+static int vfs_copy_tree(const char *src, const char *dst, uint8_t *buf);
+
+typedef struct
+{
+    const char *src;
+    const char *dst;
+    uint8_t *buf;
+    int ok;
+} vfs_copy_ctx_t;
+
+static int vfs_copy_entry(void *ctx, const char *name, const vfs_stat_t *st)
+{
+    vfs_copy_ctx_t *cc = (vfs_copy_ctx_t *)ctx;
+
+    char child_src[VFS_PATH_MAX];
+    char child_dst[VFS_PATH_MAX];
+
+    if (!vfs_join(child_src, cc->src, name) || !vfs_join(child_dst, cc->dst, name))
+    {
+        cc->ok = 0;
+        return 0;
+    }
+
+    cc->ok = (st->type == VFS_DIR) ? vfs_copy_tree(child_src, child_dst, cc->buf)
+                                   : vfs_copy_file(child_src, child_dst, cc->buf);
+    return cc->ok;
+}
+
+static int vfs_copy_tree(const char *src, const char *dst, uint8_t *buf)
+{
+    if (!vfs_mkdir_p(dst))
+        return 0;
+
+    vfs_copy_ctx_t cc;
+    cc.src = src;
+    cc.dst = dst;
+    cc.buf = buf;
+    cc.ok = 1;
+
+    if (!vfs_readdir(src, vfs_copy_entry, &cc))
+        return 0;
+
+    return cc.ok;
+}
+
+int vfs_copy(const char *src, const char *dst)
+{
+    char src_abs[VFS_PATH_MAX];
+    char src_sub[VFS_PATH_MAX];
+    char dst_abs[VFS_PATH_MAX];
+    char dst_sub[VFS_PATH_MAX];
+
+    vfs_mount_t *sm = vfs_resolve(src, src_abs, src_sub);
+    if (!sm || !dst || dst[0] == '\0')
+        return 0;
+
+    vfs_stat_t st;
+    if (!vfs_stat(src_abs, &st))
+        return 0;
+
+    if (!vfs_target(src_abs, dst, dst_abs))
+        return 0;
+
+    if (vfs_path_eq(src_abs, dst_abs))
+        return 0;
+
+    // Refuse to copy a directory into its own subtree.
+    if (st.type == VFS_DIR && vfs_path_under(dst_abs, src_abs, strlen(src_abs)))
+        return 0;
+
+    vfs_mount_t *dm = vfs_lookup_mount(dst_abs, dst_sub);
+    if (!dm)
+        return 0;
+
+    if (sm == dm && sm->ops->copy)
+    {
+        vfs_changed(dm);
+        return sm->ops->copy(sm, src_sub, dst_sub);
+    }
+
+    uint8_t *buf = (uint8_t *)kmalloc(VFS_COPY_CHUNK);
+    if (!buf)
+        return 0;
+
+    int ok = (st.type == VFS_DIR) ? vfs_copy_tree(src_abs, dst_abs, buf)
+                                  : vfs_copy_file(src_abs, dst_abs, buf);
+
+    kfree(buf);
+    return ok;
+}
+
+int vfs_rename(const char *src, const char *dst)
+{
+    char src_abs[VFS_PATH_MAX];
+    char src_sub[VFS_PATH_MAX];
+    char dst_abs[VFS_PATH_MAX];
+    char dst_sub[VFS_PATH_MAX];
+
+    vfs_mount_t *sm = vfs_resolve(src, src_abs, src_sub);
+    if (!sm || !dst || dst[0] == '\0' || strcmp(src_sub, "/") == 0)
+        return 0;
+
+    if (!vfs_target(src_abs, dst, dst_abs))
+        return 0;
+
+    vfs_mount_t *dm = vfs_lookup_mount(dst_abs, dst_sub);
+    if (!dm)
+        return 0;
+
+    if (sm == dm)
+    {
+        vfs_changed(sm);
+        return sm->ops->rename(sm, src_sub, dst_sub);
+    }
+
+    // Across filesystems: copy the file, then drop the original.
+    vfs_stat_t st;
+    if (!vfs_stat(src_abs, &st) || st.type != VFS_FILE)
+        return 0;
+
+    if (vfs_stat(dst_abs, &st))
+        return 0; // destination already exists
+
+    if (!vfs_copy(src_abs, dst_abs))
+        return 0;
+
+    return vfs_remove(src_abs, 0) == 1;
+}
+
+int vfs_sync()
+{
+    int ok = 1;
+
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++)
+    {
+        vfs_mount_t *m = &mounts[i];
+
+        if (m->used && m->ops->sync && !m->ops->sync(m))
+            ok = 0;
+    }
+
+    return ok;
+}
+
+/* -------------------- Open files -------------------- */
+
+int vfs_open(const char *path, uint32_t flags, vfs_node_t **out)
+{
+    char abs[VFS_PATH_MAX];
+    char sub[VFS_PATH_MAX];
+
+    vfs_mount_t *m = vfs_resolve(path, abs, sub);
+    if (!m || !out)
+        return 0;
+
+    if (flags & (VFS_O_CREAT | VFS_O_TRUNC))
+        vfs_changed(m);
+
+    vfs_node_t *node = 0;
+    if (!m->ops->open(m, sub, flags, &node))
+        return 0;
+
+    node->ops = m->ops;
+    node->mount = m;
+    *out = node;
+    return 1;
+}
+
+int vfs_read(vfs_node_t *node, uint32_t offset, uint8_t *out, uint32_t len, uint32_t *out_read)
+{
+    *out_read = 0;
+
+    if (!node || !out)
+        return 0;
+
+    return node->ops->read(node, offset, out, len, out_read);
+}
+
+int vfs_write(vfs_node_t *node, uint32_t offset, const uint8_t *data, uint32_t len, uint32_t *out_written)
+{
+    *out_written = 0;
+
+    if (!node || !data)
+        return 0;
+
+    vfs_changed(node->mount);
+    return node->ops->write(node, offset, data, len, out_written);
+}
+
+void vfs_close(vfs_node_t *node)
+{
+    if (node)
+        node->ops->close(node);
+}
+
+int vfs_write_file(const char *path, const uint8_t *data, uint32_t size)
+{
+    vfs_node_t *node;
+    if (!vfs_open(path, VFS_O_CREAT | VFS_O_TRUNC, &node))
+        return 0;
+
+    uint32_t written = 0;
+    int ok = vfs_write(node, 0, data, size, &written);
+
+    vfs_close(node);
+    return ok;
+}
+
+int vfs_append_file(const char *path, const uint8_t *data, uint32_t size)
+{
+    vfs_node_t *node;
+    if (!vfs_open(path, VFS_O_CREAT, &node))
+        return 0;
+
+    uint32_t written = 0;
+    int ok = vfs_write(node, node->size, data, size, &written);
+
+    vfs_close(node);
+    return ok;
+}
@@ -1,11 +1,31 @@
 #include "kernel/elf32.h"
-#include "fs/fat16.h"
+#include "fs/vfs.h"
 #include "kernel/print.h"
+#include "memory/vmm.h"
 #include "string.h"
 
-// Kernel is linked at 0x00100000, so keep user ET_EXEC images away from it.
-#define USER_MIN_VADDR 0x00200000u
-#define USER_MAX_VADDR 0x003F0000u
+// User ET_EXEC images go in the upper part of user space, clear of the
+// mmap window below and the stack above.
+#define USER_MIN_VADDR 0x80000000u
+#define USER_MAX_VADDR 0xBF000000u
+
+#define PAGE_FLOOR(a) ((a) & ~(PAGE_SIZE - 1))
+#define PAGE_CEIL(a) (((a) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+// Does any writable PT_LOAD segment touch the page at `page`?
+static int elf32_page_writable(const elf32_phdr_t *phdrs, uint32_t n, uint32_t page)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const elf32_phdr_t *ph = &phdrs[i];
+
+        if (ph->p_type == PT_LOAD && ph->p_memsz && (ph->p_flags & PF_W) &&
+            PAGE_FLOOR(ph->p_vaddr) <= page && page < PAGE_CEIL(ph->p_vaddr + ph->p_memsz))
+            return 1;
+    }
+
+    return 0;
+}
 
 static int elf32_check_ident(const elf32_ehdr_t *eh)
 {
@@ -25,21 +45,9 @@ static int elf32_check_ident(const elf32_ehdr_t *eh)
     return 1;
 }
 
-int elf32_load_from_fat16(const char *path, uint32_t *out_entry, uint32_t *out_low, uint32_t *out_high)
+static int elf32_load_file(vfs_node_t *file, uint32_t *out_entry, uint32_t *out_low, uint32_t *out_high)
 {
-    if (!path || !out_entry || !out_low || !out_high)
-        return 0;
-
-    *out_entry = 0;
-    *out_low = 0;
-    *out_high = 0;
-
-    if (!fat16_init())
-        return 0;
-
-    uint32_t size = 0;
-    if (!fat16_filesize(path, &size))
-        return 0;
+    uint32_t size = file->size;
 
     if (size < sizeof(elf32_ehdr_t))
         return 0;
@@ -47,7 +55,7 @@ int elf32_load_from_fat16(const char *path, uint32_t *out_entry, uint32_t *out_l
     // Read ELF header.
     elf32_ehdr_t eh;
     uint32_t rd = 0;
-    if (!fat16_read_at(path, 0, (uint8_t *)&eh, sizeof(eh), &rd) || rd != sizeof(eh))
+    if (!vfs_read(file, 0, (uint8_t *)&eh, sizeof(eh), &rd) || rd != sizeof(eh))
         return 0;
 
     if (!elf32_check_ident(&eh))
@@ -69,7 +77,7 @@ int elf32_load_from_fat16(const char *path, uint32_t *out_entry, uint32_t *out_l
         return 0;
 
     rd = 0;
-    if (!fat16_read_at(path, eh.e_phoff, (uint8_t *)phdrs, ph_table_bytes, &rd) || rd != ph_table_bytes)
+    if (!vfs_read(file, eh.e_phoff, (uint8_t *)phdrs, ph_table_bytes, &rd) || rd != ph_table_bytes)
         return 0;
 
     uint32_t low = 0xFFFFFFFFu;
@@ -99,11 +107,15 @@ int elf32_load_from_fat16(const char *path, uint32_t *out_entry, uint32_t *out_l
         if (seg_end > high)
             high = seg_end;
 
+        // Writable while loading; read-only segments lose that below.
+        if (!vmm_alloc(vmm_current(), seg_start, seg_end, PAGE_USER | PAGE_RW))
+            return 0;
+
         // Read file bytes directly into destination memory.
         if (ph->p_filesz > 0)
         {
             uint32_t got = 0;
-            if (!fat16_read_at(path, ph->p_offset, (uint8_t *)ph->p_vaddr, ph->p_filesz, &got) || got != ph->p_filesz)
+            if (!vfs_read(file, ph->p_offset, (uint8_t *)ph->p_vaddr, ph->p_filesz, &got) || got != ph->p_filesz)
                 return 0;
         }
 
@@ -117,6 +129,20 @@ int elf32_load_from_fat16(const char *path, uint32_t *out_entry, uint32_t *out_l
     if (low == 0xFFFFFFFFu || high == 0)
         return 0;
 
+    for (uint32_t i = 0; i < eh.e_phnum; i++)
+    {
+        const elf32_phdr_t *ph = &phdrs[i];
+
+        if (ph->p_type != PT_LOAD || ph->p_memsz == 0 || (ph->p_flags & PF_W))
+            continue;
+
+        for (uint32_t page = PAGE_FLOOR(ph->p_vaddr); page < ph->p_vaddr + ph->p_memsz; page += PAGE_SIZE)
+        {
+            if (!elf32_page_writable(phdrs, eh.e_phnum, page))
+                vmm_protect(vmm_current(), page, page + PAGE_SIZE, PAGE_USER);
+        }
+    }
+
     // Entry must land within loaded region.
     if (eh.e_entry < low || eh.e_entry >= high)
         return 0;
@@ -127,3 +153,22 @@ int elf32_load_from_fat16(const char *path, uint32_t *out_entry, uint32_t *out_l
 
     return 1;
 }
+
+int elf32_load(const char *path, uint32_t *out_entry, uint32_t *out_low, uint32_t *out_high)
+{
+    if (!path || !out_entry || !out_low || !out_high)
+        return 0;
+
+    *out_entry = 0;
+    *out_low = 0;
+    *out_high = 0;
+
+    vfs_node_t *file;
+    if (!vfs_open(path, 0, &file))
+        return 0;
+
+    int ok = elf32_load_file(file, out_entry, out_low, out_high);
+
+    vfs_close(file);
+    return ok;
+}
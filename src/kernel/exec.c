@@ -1,12 +1,14 @@
 #include "kernel/exec.h"
 #include "kernel/elf32.h"
+#include "kernel/mmap.h"
 #include "kernel/print.h"
-#include "memory/paging.h"
+#include "memory/vmm.h"
 #include "cpu/usermode.h"
 #include "string.h"
 
-#define USER_STACK_BASE 0x003FC000u
-#define USER_STACK_TOP  0x00400000u
+// 64KB stack at the top of user space.
+#define USER_STACK_BASE 0xBFFF0000u
+#define USER_STACK_TOP  0xC0000000u
 
 static uint32_t push_bytes(uint32_t sp, const void *src, uint32_t n)
 {
@@ -80,27 +82,29 @@ int kernel_exec_elf_argv(const char *path, int argc, const char *argv[])
     uint32_t low = 0;
     uint32_t high = 0;
 
-    if (!elf32_load_from_fat16(path, &entry, &low, &high))
+    // Each program runs in an address space of its own; the kernel half
+    // is shared and stays supervisor-only.
+    vmm_space_t *space = vmm_space_create();
+    if (!space)
         return -1;
 
-    // Remove user access from the whole user region and stack, then enable it only
-    // for the new program's segments + stack.
-    paging_clear_user(0x00200000u, 0x003F0000u);
-    paging_clear_user(USER_STACK_BASE, USER_STACK_TOP);
+    vmm_space_t *prev = vmm_switch(space);
+    int code = -1;
 
-    paging_mark_user(low, high);
-    paging_mark_user(USER_STACK_BASE, USER_STACK_TOP);
-
-    memset((void *)USER_STACK_BASE, 0, USER_STACK_TOP - USER_STACK_BASE);
-
-    // Keep kernel supervisor-only (paging_init defaults to supervisor-only; this is extra safety).
-    paging_protect_kernel();
+    if (elf32_load(path, &entry, &low, &high) &&
+        vmm_alloc(space, USER_STACK_BASE, USER_STACK_TOP, PAGE_USER | PAGE_RW))
+    {
+        uint32_t user_sp = build_user_stack(argc, argv, USER_STACK_TOP);
+        if (user_sp >= USER_STACK_BASE && user_sp < USER_STACK_TOP)
+            code = switch_to_user_mode(entry, user_sp);
+    }
 
-    uint32_t user_sp = build_user_stack(argc, argv, USER_STACK_TOP);
-    if (user_sp < USER_STACK_BASE || user_sp >= USER_STACK_TOP)
-        return -1;
+    // Mappings die with the program; their pages stay in the page cache.
+    mmap_unmap_all();
 
-    return switch_to_user_mode(entry, user_sp);
+    vmm_switch(prev);
+    vmm_space_destroy(space);
+    return code;
 }
 
 int kernel_exec_elf(const char *path)
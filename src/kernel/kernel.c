@@ -8,7 +8,8 @@
 #include "cpu/timer.h"
 #include "shell.h"
 #include "memory/kmalloc.h"
-#include "memory/paging.h"
+#include "memory/vmm.h"
+#include "memory/pmm.h"
 #include "kernel/syscall.h"
 #include "cpu/tss.h"
 #include "cpu/usermode.h"
@@ -16,8 +17,55 @@
 #include "kernel/elf32.h"
 #include "string.h"
 #include "kernel/exec.h"
+#include "drivers/ata.h"
+#include "drivers/blk.h"
+#include "fs/bcache.h"
+#include "fs/pcache.h"
+#include "fs/fat16.h"
+#include "fs/vfs.h"
+#include "fs/tmpfs.h"
+#include "fs/initrd.h"
+#include "kernel/multiboot.h"
 
-void kernel_main()
+// Scratch space mounted at /TMP.
+#define TMPFS_MAX_BYTES (256 * 1024)
+
+// Boot modules must lie in the kernel's identity map.
+#define MODULE_LIMIT LAYOUT_USER_BASE
+
+// The first boot module holding a ustar archive; mounted at /BIN. Copied,
+// since the boot loader's module list isn't reserved.
+static multiboot_module_t initrd_module;
+
+// Find the initrd among the boot modules and return the end of the
+// highest module, so the page allocator leaves them alone.
+static uint32_t boot_scan_modules(uint32_t magic, const multiboot_info_t *mbi)
+{
+    uint32_t end = 0;
+
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !(mbi->flags & MULTIBOOT_INFO_MODS))
+        return 0;
+
+    const multiboot_module_t *mods = (const multiboot_module_t *)mbi->mods_addr;
+
+    for (uint32_t i = 0; i < mbi->mods_count; i++)
+    {
+        const multiboot_module_t *m = &mods[i];
+
+        if (m->mod_end <= m->mod_start || m->mod_end > MODULE_LIMIT)
+            continue;
+
+        if (m->mod_end > end)
+            end = m->mod_end;
+
+        if (!initrd_module.mod_end && initrd_probe((const uint8_t *)m->mod_start, m->mod_end - m->mod_start))
+            initrd_module = *m;
+    }
+
+    return end;
+}
+
+void kernel_main(uint32_t magic, const multiboot_info_t *mbi)
 {
     clear_screen();
     print("Booting AstraOS...\n");
@@ -31,15 +79,69 @@ void kernel_main()
     timer_init(100);
     keyboard_init();
 
+    extern uint32_t kernel_start;
     extern uint32_t kernel_end;
-    kmalloc_init((uint32_t)&kernel_end + 0x1000);
 
+    // Ring 0 stack for entries from user mode, right after the image.
     uint32_t kernel_stack_top = (uint32_t)&kernel_end + 0x4000;
+
+    uint32_t boot_end = boot_scan_modules(magic, mbi);
+    if (boot_end < kernel_stack_top)
+        boot_end = kernel_stack_top;
+
+    pmm_range_t reserved[] = {
+        {(uint32_t)&kernel_start, boot_end}, // image, stack, boot modules
+    };
+
+    if (!pmm_init(magic == MULTIBOOT_BOOTLOADER_MAGIC ? mbi : 0, reserved, 1))
+        print("No usable memory found!\n");
+
+    vmm_init(pmm_get_top());
+    kmalloc_init();
+
+    pmm_stats_t mem = pmm_get_stats();
+    print("Memory: ");
+    print_uint(mem.free_pages * (PAGE_SIZE / 1024));
+    print(" KB free of ");
+    print_uint(mem.total_pages * (PAGE_SIZE / 1024));
+    print(" KB\n");
+
     tss_install(kernel_stack_top);
 
-    paging_init();
     syscall_init();
 
+    ata_init();
+    blk_init();
+    bcache_init();
+    pcache_init();
+
+    if (!fat16_mount())
+        print("FAT16 mount failed.\n");
+
+    vfs_init();
+    vfs_mount("/", &fat16_vfs_ops, 0);
+
+    void *tmp = tmpfs_create(TMPFS_MAX_BYTES);
+    if (!tmp || !vfs_mount("/TMP", &tmpfs_vfs_ops, tmp))
+        print("tmpfs mount failed.\n");
+
+    // The boot archive replaces the disk's /BIN, so the core programs
+    // run from RAM without touching the disk.
+    if (initrd_module.mod_end)
+    {
+        void *rd = initrd_create((const uint8_t *)initrd_module.mod_start,
+                                 initrd_module.mod_end - initrd_module.mod_start);
+
+        if (rd && vfs_mount("/BIN", &initrd_vfs_ops, rd))
+        {
+            print("initrd: ");
+            print_uint(initrd_count(rd));
+            print(" entries at /BIN\n");
+        }
+        else
+            print("initrd mount failed.\n");
+    }
+
     enable_interrupts();
 
     int exit_code = kernel_exec_elf("/BIN/INIT.ELF");
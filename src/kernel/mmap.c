@@ -0,0 +1,220 @@
+#include "kernel/mmap.h"
+#include "memory/vmm.h"
+#include "fs/pcache.h"
+#include "fs/vfs.h"
+
+// Page-fault error code bits.
+#define FAULT_PRESENT 0x1
+#define FAULT_WRITE 0x2
+
+typedef struct
+{
+    uint8_t used;
+    uint32_t start;
+    uint32_t pages;
+    uint32_t first_page; // file page mapped at `start`
+    vfs_node_t *node;    // the mapping's own open file
+    pcache_file_t *file;
+} mmap_region_t;
+
+static mmap_region_t regions[MMAP_MAX_REGIONS];
+
+// Clock hand over the window for taking frames back from mappings when
+// every page-cache frame is mapped.
+static uint32_t reclaim_hand = LAYOUT_MMAP_BASE;
+
+static mmap_region_t *mmap_find(uint32_t addr)
+{
+    for (int i = 0; i < MMAP_MAX_REGIONS; i++)
+    {
+        mmap_region_t *r = &regions[i];
+
+        if (r->used && addr >= r->start && addr - r->start < r->pages * PAGE_SIZE)
+            return r;
+    }
+
+    return 0;
+}
+
+// Lowest stretch of the window with room for `pages` pages, or 0.
+static uint32_t mmap_place(uint32_t pages)
+{
+    uint32_t start = LAYOUT_MMAP_BASE;
+    uint32_t bytes = pages * PAGE_SIZE;
+    int moved;
+
+    do
+    {
+        if (bytes > LAYOUT_MMAP_END - start)
+            return 0;
+
+        moved = 0;
+
+        for (int i = 0; i < MMAP_MAX_REGIONS; i++)
+        {
+            mmap_region_t *r = &regions[i];
+            uint32_t end = r->start + r->pages * PAGE_SIZE;
+
+            if (r->used && start < end && r->start < start + bytes)
+            {
+                start = end;
+                moved = 1;
+            }
+        }
+    } while (moved);
+
+    return start;
+}
+
+static void mmap_release(mmap_region_t *r)
+{
+    for (uint32_t i = 0; i < r->pages; i++)
+    {
+        uint32_t frame = vmm_unmap(vmm_current(), r->start + i * PAGE_SIZE);
+        if (frame)
+            pcache_page_put(frame);
+    }
+
+    pcache_file_put(r->file);
+    vfs_close(r->node);
+    r->used = 0;
+}
+
+// Unmap one page so the page cache can reuse its frame; it faults back
+// in when touched again.
+static int mmap_reclaim()
+{
+    uint32_t window = (LAYOUT_MMAP_END - LAYOUT_MMAP_BASE) / PAGE_SIZE;
+
+    for (uint32_t n = 0; n < window; n++)
+    {
+        uint32_t vaddr = reclaim_hand;
+
+        reclaim_hand += PAGE_SIZE;
+        if (reclaim_hand >= LAYOUT_MMAP_END)
+            reclaim_hand = LAYOUT_MMAP_BASE;
+
+        uint32_t frame = vmm_unmap(vmm_current(), vaddr);
+        if (frame)
+        {
+            pcache_page_put(frame);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+uint32_t mmap_file(const char *path, uint32_t offset, uint32_t length)
+{
+    if (!path || length == 0 || (offset & (PAGE_SIZE - 1)))
+        return 0;
+
+    if (length > LAYOUT_MMAP_END - LAYOUT_MMAP_BASE)
+        return 0;
+
+    mmap_region_t *slot = 0;
+    for (int i = 0; i < MMAP_MAX_REGIONS && !slot; i++)
+    {
+        if (!regions[i].used)
+            slot = &regions[i];
+    }
+
+    if (!slot)
+        return 0;
+
+    uint32_t pages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t start = mmap_place(pages);
+    if (!start)
+        return 0;
+
+    vfs_node_t *node;
+    if (!vfs_open(path, 0, &node))
+        return 0;
+
+    if (offset >= node->size)
+    {
+        vfs_close(node);
+        return 0;
+    }
+
+    pcache_file_t *file = pcache_file_get(node, path);
+    if (!file)
+    {
+        vfs_close(node);
+        return 0;
+    }
+
+    slot->start = start;
+    slot->pages = pages;
+    slot->first_page = offset / PAGE_SIZE;
+    slot->node = node;
+    slot->file = file;
+    slot->used = 1;
+
+    return start;
+}
+
+int mmap_unmap(uint32_t addr, uint32_t length)
+{
+    for (int i = 0; i < MMAP_MAX_REGIONS; i++)
+    {
+        mmap_region_t *r = &regions[i];
+
+        if (!r->used || r->start != addr)
+            continue;
+
+        // Partial unmaps aren't supported.
+        if ((length + PAGE_SIZE - 1) / PAGE_SIZE < r->pages)
+            return 0;
+
+        mmap_release(r);
+        return 1;
+    }
+
+    return 0;
+}
+
+void mmap_unmap_all()
+{
+    for (int i = 0; i < MMAP_MAX_REGIONS; i++)
+    {
+        if (regions[i].used)
+            mmap_release(&regions[i]);
+    }
+}
+
+int mmap_handle_fault(uint32_t addr, uint32_t err_code)
+{
+    // Mappings are read-only: a write, or a fault on a present page, is
+    // a real error.
+    if (err_code & (FAULT_PRESENT | FAULT_WRITE))
+        return 0;
+
+    mmap_region_t *r = mmap_find(addr);
+    if (!r)
+        return 0;
+
+    uint32_t page = addr & ~(PAGE_SIZE - 1);
+    uint32_t index = r->first_page + (page - r->start) / PAGE_SIZE;
+    uint32_t frame;
+    int rc;
+
+    while ((rc = pcache_page_get(r->file, r->node, index, &frame)) == -1)
+    {
+        if (!mmap_reclaim())
+            return 0;
+    }
+
+    // Past the end of the file, or the read failed.
+    if (rc != 1)
+        return 0;
+
+    if (!vmm_map(vmm_current(), page, frame, PAGE_USER))
+    {
+        pcache_page_put(frame);
+        return 0;
+    }
+
+    return 1;
+}
@@ -5,8 +5,15 @@
 #include "cpu/timer.h"
 #include "keys.h"
 #include "drivers/ata.h"
+#include "drivers/blk.h"
 #include "memory/kmalloc.h"
+#include "memory/pmm.h"
+#include "memory/slab.h"
 #include "fs/fat16.h"
+#include "fs/vfs.h"
+#include "fs/tmpfs.h"
+#include "fs/bcache.h"
+#include "fs/pcache.h"
 #include "kernel/print.h"
 #include "kernel/syscall.h"
 #include "kernel/syscall_api.h"
@@ -41,7 +48,7 @@ static void shell_execute(char *cmd);
 static void shell_prompt()
 {
     print("\nAstraOS@");
-    print(fat16_get_path());
+    print(vfs_getcwd());
     print("$ ");
 
     prompt_x = get_cursor_x();
@@ -105,6 +112,65 @@ static int shell_tokenize(char *input, char *argv[], int max_args)
     return argc;
 }
 
+/* ---------- Filesystem Helpers ---------- */
+
+static int shell_ls_entry(void *ctx, const char *name, const vfs_stat_t *st)
+{
+    (void)ctx;
+
+    if (st->type == VFS_DIR)
+    {
+        print("DIR   ");
+        print(name);
+        print("\n");
+    }
+    else
+    {
+        print("FILE  ");
+        print(name);
+        print("  ");
+        print_uint(st->size);
+        print(" bytes\n");
+    }
+
+    return 1;
+}
+
+// Print a file, with non-printable bytes shown as '.'.
+static int shell_cat(const char *path)
+{
+    vfs_node_t *file;
+    if (!vfs_open(path, 0, &file))
+        return 0;
+
+    uint8_t buf[512];
+    uint32_t offset = 0;
+    uint32_t n;
+
+    print("\n");
+
+    while (vfs_read(file, offset, buf, sizeof(buf), &n) && n > 0)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            char c = (char)buf[i];
+
+            if (c == '\n' || c == '\r' || (c >= 32 && c <= 126))
+                print_char(c);
+            else
+                print_char('.');
+        }
+
+        offset += n;
+    }
+
+    if (file->size > 0)
+        print("\n");
+
+    vfs_close(file);
+    return 1;
+}
+
 /* ---------- Shell Execute ---------- */
 
 static void shell_execute(char *cmd)
@@ -132,6 +198,7 @@ static void shell_execute(char *cmd)
         print("  version           Show OS version\n");
         print("  uname             Kernel information\n");
         print("  uptime            Show system uptime\n");
+        print("  meminfo [caches|sites] Show memory, heap, slab, leak stats\n");
         print("  sleep <sec>       Sleep for N seconds\n");
         print("  halt              Halt the CPU\n");
         print("  reboot            Reboot the system\n\n");
@@ -144,11 +211,17 @@ static void shell_execute(char *cmd)
         print("  run <elf>         Run an ELF32 program (e.g. /BIN/INIT.ELF)\n\n");
 
         print("Disk:\n");
+        print("  diskinfo          Show ATA disk / DMA info\n");
         print("  diskread          Read disk sector 0 (test)\n");
         print("  disktest          Write + read test sector\n");
-        print("  fatinfo           Show FAT16 boot sector info\n\n");
-
-        print("Filesystem (FAT16):\n");
+        print("  fatinfo           Show FAT16/FAT32 boot sector info\n");
+        print("  remount           Re-read the FAT16 boot sector\n");
+        print("  cachestat         Show sector cache, dir index, queue stats\n");
+        print("  sync              Flush cached writes to disk\n");
+        print("  durability [mode] Show/set lazy | writeback | flush\n\n");
+
+        print("Filesystem:\n");
+        print("  mounts            Show mounted filesystems\n");
         print("  ls [path]         List directory\n");
         print("  pwd               Print working directory\n");
         print("  cd <path>         Change directory\n");
@@ -156,8 +229,8 @@ static void shell_execute(char *cmd)
         print("  touch <file>      Create empty file\n");
         print("  write             Write text to file \n");
         print("  append            Append text to file \n");
-        print("  cp <src> <dst>    Copy file\n");
-        print("  mv <src> <dst>    Move/Rename file\n");
+        print("  cp <src> <dst>    Copy file or directory tree\n");
+        print("  mv <src> <dst>    Move/Rename file (or directory within a mount)\n");
         print("  mkdir <dir>       Create directory\n");
         print("  mkdir -p <path>   Create directory tree\n");
         print("  rm <file>         Delete file\n");
@@ -233,6 +306,7 @@ static void shell_execute(char *cmd)
     else if (strcmp(command, "halt") == 0)
     {
         print("\nSystem halting...\n");
+        vfs_sync();
         cpu_halt();
         return;
     }
@@ -240,6 +314,7 @@ static void shell_execute(char *cmd)
     else if (strcmp(command, "reboot") == 0)
     {
         print("\nSystem rebooting...\n");
+        vfs_sync();
         cpu_reboot();
         return;
     }
@@ -288,12 +363,6 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
         // Pass argv[1..] down to userland as argc/argv.
         int uargc = argc - 1;
         const char **uargv = (const char **)&argv[1];
@@ -314,6 +383,82 @@ static void shell_execute(char *cmd)
        DISK COMMANDS
        ========================== */
 
+    else if (strcmp(command, "diskinfo") == 0)
+    {
+        ata_info_t info = ata_get_info();
+
+        if (!info.present)
+        {
+            print("\nNo ATA disk on primary master.\n");
+            return;
+        }
+
+        print("\nATA Disk Info:\n");
+
+        print("Sectors: ");
+        print_uint(info.sectors);
+
+        print("\nLBA48: ");
+        print(info.lba48 ? "yes" : "no");
+
+        print("\nTransfer: ");
+        print(info.dma ? "bus master DMA" : "PIO");
+
+        print("\n");
+        return;
+    }
+
+    else if (strcmp(command, "remount") == 0)
+    {
+        if (fat16_remount())
+        {
+            // The disk may have changed under any cached file pages.
+            pcache_drop();
+            print("\nFAT16 volume remounted.\n");
+        }
+        else
+            print("\nFAT16 mount failed.\n");
+        return;
+    }
+
+    else if (strcmp(command, "sync") == 0)
+    {
+        if (vfs_sync())
+            print("\nDisk synced.\n");
+        else
+            print("\nSync failed.\n");
+        return;
+    }
+
+    else if (strcmp(command, "durability") == 0)
+    {
+        static const char *modes[] = {"lazy", "writeback", "flush"};
+
+        if (argc >= 2)
+        {
+            int mode = -1;
+
+            for (int i = 0; i < 3; i++)
+            {
+                if (strcmp(argv[1], modes[i]) == 0)
+                    mode = i;
+            }
+
+            if (mode < 0)
+            {
+                print("\nUsage: durability [lazy|writeback|flush]\n");
+                return;
+            }
+
+            fat16_set_durability(mode);
+        }
+
+        print("\nDurability: ");
+        print(modes[fat16_get_durability()]);
+        print("\n");
+        return;
+    }
+
     else if (strcmp(command, "diskread") == 0)
     {
         uint8_t *buf = (uint8_t *)kmalloc(512);
@@ -397,10 +542,14 @@ static void shell_execute(char *cmd)
         }
 
         fat16_bpb_t info = fat16_get_bpb();
+        const fat16_volume_t *v = fat16_get_volume();
 
-        print("\nFAT16 Boot Sector Info:\n");
+        print("\nFAT Boot Sector Info:\n");
 
-        print("Bytes/Sector: ");
+        print("Type: FAT");
+        print_uint(v->fat_bits);
+
+        print("\nBytes/Sector: ");
         print_uint(info.bytes_per_sector);
 
         print("\nSectors/Cluster: ");
@@ -424,6 +573,96 @@ static void shell_execute(char *cmd)
         print("\nTotal Sectors (32): ");
         print_uint(info.total_sectors_32);
 
+        if (v->fat_bits == 32)
+        {
+            print("\nRoot Cluster: ");
+            print_uint(info.root_cluster);
+
+            print("\nFSInfo Sector: ");
+            print_uint(info.fsinfo_sector);
+        }
+
+        print("\nFree Clusters: ");
+        print_uint(fat16_free_clusters());
+
+        print("\n");
+        return;
+    }
+
+    else if (strcmp(command, "cachestat") == 0)
+    {
+        bcache_stats_t st = bcache_get_stats();
+
+        print("\nSector Cache:\n");
+
+        print("Buffers: ");
+        print_uint(BCACHE_NUM_BUFFERS);
+
+        print("\nHits: ");
+        print_uint(st.hits);
+
+        print("\nMisses: ");
+        print_uint(st.misses);
+
+        print("\nEvictions: ");
+        print_uint(st.evictions);
+
+        print("\nWritebacks: ");
+        print_uint(st.writebacks);
+
+        print("\nDirty: ");
+        print_uint(st.dirty);
+
+        print("\nReadahead: ");
+        print_uint(st.readahead);
+
+        pcache_stats_t pst = pcache_get_stats();
+
+        print("\n\nPage Cache:\n");
+
+        print("Pages: ");
+        print_uint(pst.cached);
+        print(" / ");
+        print_uint(PCACHE_PAGES);
+
+        print("\nMapped: ");
+        print_uint(pst.mapped);
+
+        print("\nHits: ");
+        print_uint(pst.hits);
+
+        print("\nMisses: ");
+        print_uint(pst.misses);
+
+        blk_stats_t bst = blk_get_stats();
+
+        print("\n\nBlock Queue:\n");
+
+        print("Requests: ");
+        print_uint(bst.requests);
+
+        print("\nMerged: ");
+        print_uint(bst.merges);
+
+        print("\nCommands: ");
+        print_uint(bst.commands);
+
+        print("\nErrors: ");
+        print_uint(bst.errors);
+
+        fat16_dindex_stats_t dst = fat16_get_dindex_stats();
+
+        print("\n\nDirectory Index:\n");
+
+        print("Hits: ");
+        print_uint(dst.hits);
+
+        print("\nNegative hits: ");
+        print_uint(dst.negative_hits);
+
+        print("\nBuilds: ");
+        print_uint(dst.builds);
+
         print("\n");
         return;
     }
@@ -432,27 +671,45 @@ static void shell_execute(char *cmd)
        FILESYSTEM COMMANDS
        ========================== */
 
+    else if (strcmp(command, "mounts") == 0)
+    {
+        print("\n");
+
+        const vfs_mount_t *m;
+        for (int i = 0; (m = vfs_get_mount(i)) != 0; i++)
+        {
+            print(m->path);
+            print("  ");
+            print(m->ops->name);
+
+            if (m->ops == &tmpfs_vfs_ops)
+            {
+                tmpfs_stats_t ts = tmpfs_get_stats(m->data);
+                print("  ");
+                print_uint(ts.files);
+                print(" files, ");
+                print_uint(ts.bytes / 1024);
+                print("/");
+                print_uint(ts.max_bytes / 1024);
+                print(" KB");
+            }
+
+            print("\n");
+        }
+        return;
+    }
+
     else if (strcmp(command, "pwd") == 0)
     {
-        fat16_pwd();
+        print("\n");
+        print(vfs_getcwd());
+        print("\n");
         return;
     }
 
     else if (strcmp(command, "ls") == 0)
     {
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
-        if (argc == 1)
-        {
-            fat16_ls();
-            return;
-        }
-
-        if (!fat16_ls_path(argv[1]))
+        if (!vfs_readdir(argc == 1 ? "." : argv[1], shell_ls_entry, 0))
         {
             print("\nDirectory not found.\n");
         }
@@ -467,13 +724,7 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
-        if (!fat16_cd_path(argv[1]))
+        if (!vfs_chdir(argv[1]))
         {
             print("\nDirectory not found.\n");
         }
@@ -488,13 +739,7 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
-        if (!fat16_cat(argv[1]))
+        if (!shell_cat(argv[1]))
         {
             print("\nFile not found.\n");
         }
@@ -509,14 +754,13 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
+        vfs_node_t *node;
 
-        if (fat16_touch(argv[1]))
+        if (vfs_open(argv[1], VFS_O_CREAT | VFS_O_EXCL, &node))
+        {
+            vfs_close(node);
             print("\nFile created.\n");
+        }
         else
             print("\nTouch failed.\n");
 
@@ -531,12 +775,6 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
         if (strcmp(argv[1], "-p") == 0)
         {
             if (argc < 3)
@@ -545,7 +783,7 @@ static void shell_execute(char *cmd)
                 return;
             }
 
-            if (fat16_mkdir_p(argv[2]))
+            if (vfs_mkdir_p(argv[2]))
                 print("\nDirectory tree created.\n");
             else
                 print("\nmkdir -p failed.\n");
@@ -553,7 +791,7 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (fat16_mkdir(argv[1]))
+        if (vfs_mkdir(argv[1]))
             print("\nDirectory created.\n");
         else
             print("\nmkdir failed.\n");
@@ -569,12 +807,6 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
         if (strcmp(argv[1], "-r") == 0)
         {
             if (argc < 3)
@@ -583,7 +815,7 @@ static void shell_execute(char *cmd)
                 return;
             }
 
-            if (fat16_rm_rf(argv[2]))
+            if (vfs_remove_tree(argv[2]))
                 print("\nDeleted recursively.\n");
             else
                 print("\nrm -r failed.\n");
@@ -591,7 +823,7 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        int result = fat16_rm(argv[1]);
+        int result = vfs_remove(argv[1], 0);
 
         if (result == 1)
             print("\nFile deleted.\n");
@@ -611,12 +843,6 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
         if (strcmp(argv[1], "-r") == 0)
         {
             if (argc < 3)
@@ -625,7 +851,7 @@ static void shell_execute(char *cmd)
                 return;
             }
 
-            if (fat16_rm_rf(argv[2]))
+            if (vfs_remove_tree(argv[2]))
                 print("\nDirectory removed recursively.\n");
             else
                 print("\nrmdir -r failed.\n");
@@ -633,7 +859,7 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        int result = fat16_rmdir(argv[1]);
+        int result = vfs_remove(argv[1], 1);
 
         if (result == 1)
             print("\nDirectory removed.\n");
@@ -668,13 +894,7 @@ static void shell_execute(char *cmd)
                 strcat(text, " ");
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
-        if (fat16_write_file(filename, (uint8_t *)text, strlen(text)))
+        if (vfs_write_file(filename, (uint8_t *)text, strlen(text)))
             print("\nFile written.\n");
         else
             print("\nWrite failed.\n");
@@ -702,13 +922,7 @@ static void shell_execute(char *cmd)
                 strcat(text, " ");
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
-        if (fat16_append_file(filename, (uint8_t *)text, strlen(text)))
+        if (vfs_append_file(filename, (uint8_t *)text, strlen(text)))
             print("\nAppended.\n");
         else
             print("\nAppend failed.\n");
@@ -724,13 +938,7 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
-        if (fat16_cp(argv[1], argv[2]))
+        if (vfs_copy(argv[1], argv[2]))
             print("\nCopied.\n");
         else
             print("\ncp failed.\n");
@@ -746,13 +954,7 @@ static void shell_execute(char *cmd)
             return;
         }
 
-        if (!fat16_init())
-        {
-            print("\nFAT16 init failed.\n");
-            return;
-        }
-
-        if (fat16_mv(argv[1], argv[2]))
+        if (vfs_rename(argv[1], argv[2]))
             print("\nMoved.\n");
         else
             print("\nmv failed.\n");
@@ -764,6 +966,116 @@ static void shell_execute(char *cmd)
        MEMORY TEST COMMANDS
        ========================== */
 
+    else if (strcmp(command, "meminfo") == 0)
+    {
+        if (argc > 1 && strcmp(argv[1], "caches") == 0)
+        {
+            print("\nSlab caches (objects/capacity, pages):\n");
+
+            kmem_cache_stats_t cst;
+            for (int i = 0; kmem_cache_get_stats(i, &cst); i++)
+            {
+                print(cst.name);
+                print("  ");
+                print_uint(cst.object_size);
+                print(" B  ");
+                print_uint(cst.objects);
+                print("/");
+                print_uint(cst.capacity);
+                print("  ");
+                print_uint(cst.slabs);
+                print("\n");
+            }
+            return;
+        }
+
+        if (argc > 1 && strcmp(argv[1], "sites") == 0)
+        {
+            print("\nLive allocations by call site (blocks, bytes, total allocs):\n");
+
+            kmalloc_site_t site;
+            for (int i = 0; kmalloc_get_site(i, &site); i++)
+            {
+                if (site.blocks == 0)
+                    continue;
+
+                print(site.site);
+                print("  ");
+                print_uint(site.blocks);
+                print("  ");
+                print_uint(site.bytes);
+                print("  ");
+                print_uint(site.allocs);
+                print("\n");
+            }
+            return;
+        }
+
+        pmm_stats_t pst = pmm_get_stats();
+        uint32_t free_blocks = 0;
+        uint32_t largest = 0;
+
+        for (int i = 0; i <= PMM_MAX_ORDER; i++)
+        {
+            free_blocks += pst.free_blocks[i];
+            if (pst.free_blocks[i])
+                largest = (PAGE_SIZE << i) / 1024;
+        }
+
+        print("\nPages:\n");
+
+        print("Free: ");
+        print_uint(pst.free_pages * (PAGE_SIZE / 1024));
+        print(" KB of ");
+        print_uint(pst.total_pages * (PAGE_SIZE / 1024));
+        print(" KB");
+
+        print("\nFree blocks: ");
+        print_uint(free_blocks);
+
+        print("\nLargest free block: ");
+        print_uint(largest);
+        print(" KB");
+
+        kmalloc_stats_t kst = kmalloc_get_stats();
+
+        print("\n\nHeap:\n");
+
+        print("In use: ");
+        print_uint(kst.bytes);
+        print(" bytes in ");
+        print_uint(kst.blocks);
+        print(" blocks");
+
+        print("\nPeak: ");
+        print_uint(kst.peak_bytes);
+        print(" bytes");
+
+        print("\nAllocs: ");
+        print_uint(kst.allocs);
+
+        print("\nFrees: ");
+        print_uint(kst.frees);
+
+        print("\nFailures: ");
+        print_uint(kst.failures);
+
+        print("\nSizes:");
+        for (int i = 0; i <= KMALLOC_CLASSES; i++)
+        {
+            print(" ");
+            if (i < KMALLOC_CLASSES)
+                print_uint(kmalloc_class_size(i));
+            else
+                print("large");
+            print(":");
+            print_uint(kst.sizes[i]);
+        }
+
+        print("\n");
+        return;
+    }
+
     else if (strcmp(command, "heaptest") == 0)
     {
         print("\nTesting heap...\n");
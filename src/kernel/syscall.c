@@ -3,7 +3,11 @@
 #include "kernel/print.h"
 #include "vga.h"
 #include "cpu/usermode.h"
-#include "fs/fat16.h"
+#include "fs/vfs.h"
+#include "kernel/mmap.h"
+#include "memory/pmm.h"
+#include "memory/kmalloc.h"
+#include "memory/slab.h"
 
 #define MAX_FDS 16
 #define FD_PATH_MAX 128
@@ -14,28 +18,12 @@ typedef struct
     uint32_t flags;
     uint32_t offset;
     uint32_t size;
-    char path[FD_PATH_MAX];
+    char path[FD_PATH_MAX]; // absolute, for mmap()
+    vfs_node_t *node;
 } fd_entry_t;
 
 static fd_entry_t fd_table[MAX_FDS];
 
-static int copy_cstr_bounded(char *dst, const char *src, int dst_size)
-{
-    if (!dst || !src || dst_size <= 0)
-        return 0;
-
-    int i = 0;
-    for (; i < dst_size - 1; i++)
-    {
-        char c = src[i];
-        dst[i] = c;
-        if (c == '\0')
-            return 1;
-    }
-    dst[i] = '\0';
-    return 1;
-}
-
 static int fd_alloc()
 {
     for (int i = 0; i < MAX_FDS; i++)
@@ -47,6 +35,7 @@ static int fd_alloc()
             fd_table[i].offset = 0;
             fd_table[i].size = 0;
             fd_table[i].path[0] = '\0';
+            fd_table[i].node = 0;
             return i;
         }
     }
@@ -57,13 +46,44 @@ static void fd_free(int fd)
 {
     if (fd < 0 || fd >= MAX_FDS)
         return;
+    if (fd_table[fd].used)
+        vfs_close(fd_table[fd].node);
     fd_table[fd].used = 0;
+    fd_table[fd].node = 0;
     fd_table[fd].flags = 0;
     fd_table[fd].offset = 0;
     fd_table[fd].size = 0;
     fd_table[fd].path[0] = '\0';
 }
 
+static void syscall_meminfo(sys_meminfo_t *out)
+{
+    pmm_stats_t pst = pmm_get_stats();
+    kmalloc_stats_t kst = kmalloc_get_stats();
+
+    out->total_pages = pst.total_pages;
+    out->free_pages = pst.free_pages;
+    out->free_blocks = 0;
+    out->largest_free = 0;
+
+    for (int i = 0; i <= PMM_MAX_ORDER; i++)
+    {
+        out->free_blocks += pst.free_blocks[i];
+        if (pst.free_blocks[i])
+            out->largest_free = PAGE_SIZE << i;
+    }
+
+    out->heap_bytes = kst.bytes;
+    out->heap_peak = kst.peak_bytes;
+    out->heap_blocks = kst.blocks;
+    out->heap_failures = kst.failures;
+    out->slab_free = 0;
+
+    kmem_cache_stats_t cst;
+    for (int i = 0; kmem_cache_get_stats(i, &cst); i++)
+        out->slab_free += cst.capacity - cst.objects;
+}
+
 static void syscall_handler(registers_t *r)
 {
     uint32_t syscall_num = r->eax;
@@ -94,44 +114,33 @@ static void syscall_handler(registers_t *r)
             return;
         }
 
-        if (!fat16_init())
+        uint32_t vflags = 0;
+        if (flags & SYS_O_CREAT)
+            vflags |= VFS_O_CREAT;
+        if ((flags & SYS_O_WRONLY) && (flags & SYS_O_TRUNC))
+            vflags |= VFS_O_TRUNC;
+
+        vfs_node_t *node;
+        if (!vfs_open(path, vflags, &node))
         {
             r->eax = (uint32_t)-1;
             return;
         }
 
-        uint32_t fsize = 0;
-        int exists = fat16_filesize(path, &fsize);
-
-        if (!exists)
-        {
-            if (flags & SYS_O_CREAT)
-            {
-                // Create empty file (write 0 bytes).
-                if (!fat16_write_file(path, (const uint8_t *)"", 0))
-                {
-                    r->eax = (uint32_t)-1;
-                    return;
-                }
-                fsize = 0;
-            }
-            else
-            {
-                r->eax = (uint32_t)-1;
-                return;
-            }
-        }
+        uint32_t fsize = node->size;
 
         int fd = fd_alloc();
         if (fd < 0)
         {
+            vfs_close(node);
             r->eax = (uint32_t)-1;
             return;
         }
 
-        copy_cstr_bounded(fd_table[fd].path, path, FD_PATH_MAX);
+        vfs_normalize(path, fd_table[fd].path);
         fd_table[fd].flags = flags;
         fd_table[fd].size = fsize;
+        fd_table[fd].node = node;
 
         if (flags & SYS_O_APPEND)
             fd_table[fd].offset = fsize;
@@ -158,14 +167,8 @@ static void syscall_handler(registers_t *r)
             return;
         }
 
-        if (!fat16_init())
-        {
-            r->eax = (uint32_t)-1;
-            return;
-        }
-
         uint32_t out_read = 0;
-        if (!fat16_read_at(fd_table[fd].path, fd_table[fd].offset, buf, count, &out_read))
+        if (!vfs_read(fd_table[fd].node, fd_table[fd].offset, buf, count, &out_read))
         {
             r->eax = (uint32_t)-1;
             return;
@@ -192,38 +195,92 @@ static void syscall_handler(registers_t *r)
             return;
         }
 
-        if (!fat16_init())
+        fd_entry_t *e = &fd_table[fd];
+
+        // O_APPEND: every write goes to the current end of file.
+        if (e->flags & SYS_O_APPEND)
+            e->offset = e->node->size;
+
+        uint32_t written = 0;
+        vfs_write(e->node, e->offset, buf, count, &written);
+
+        if (written == 0 && count > 0)
+        {
+            r->eax = (uint32_t)-1;
+            return;
+        }
+
+        e->offset += written;
+        e->size = e->node->size;
+        r->eax = written;
+    }
+    else if (syscall_num == SYS_PWRITE)
+    {
+        int fd = (int)r->ebx;
+        const uint8_t *buf = (const uint8_t *)r->ecx;
+        uint32_t count = r->edx;
+        uint32_t offset = r->esi;
+
+        if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].used || !buf)
+        {
+            r->eax = (uint32_t)-1;
+            return;
+        }
+
+        if (!(fd_table[fd].flags & SYS_O_WRONLY))
         {
             r->eax = (uint32_t)-1;
             return;
         }
 
-        int ok = 0;
+        // Positional: the fd offset is left alone.
+        uint32_t written = 0;
+        vfs_write(fd_table[fd].node, offset, buf, count, &written);
 
-        if (fd_table[fd].flags & SYS_O_APPEND)
+        if (written == 0 && count > 0)
         {
-            ok = fat16_append_file(fd_table[fd].path, buf, count);
+            r->eax = (uint32_t)-1;
+            return;
         }
-        else if ((fd_table[fd].flags & SYS_O_TRUNC) && fd_table[fd].offset == 0)
+
+        fd_table[fd].size = fd_table[fd].node->size;
+        r->eax = written;
+    }
+    else if (syscall_num == SYS_LSEEK)
+    {
+        int fd = (int)r->ebx;
+        int32_t offset = (int32_t)r->ecx;
+        uint32_t whence = r->edx;
+
+        if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].used)
         {
-            // First write after open(trunc) rewrites file. Further writes append.
-            ok = fat16_write_file(fd_table[fd].path, buf, count);
-            fd_table[fd].flags &= ~SYS_O_TRUNC;
+            r->eax = (uint32_t)-1;
+            return;
         }
+
+        int64_t base;
+        if (whence == SYS_SEEK_SET)
+            base = 0;
+        else if (whence == SYS_SEEK_CUR)
+            base = fd_table[fd].offset;
+        else if (whence == SYS_SEEK_END)
+            base = fd_table[fd].node->size;
         else
         {
-            ok = fat16_append_file(fd_table[fd].path, buf, count);
+            r->eax = (uint32_t)-1;
+            return;
         }
 
-        if (!ok)
+        // Seeking past the end is allowed; a later write fills the gap.
+        int64_t pos = base + offset;
+        if (pos < 0 || pos > 0x7FFFFFFF)
         {
             r->eax = (uint32_t)-1;
             return;
         }
 
-        fd_table[fd].offset += count;
-        fd_table[fd].size += count;
-        r->eax = count;
+        fd_table[fd].offset = (uint32_t)pos;
+        r->eax = (uint32_t)pos;
     }
     else if (syscall_num == SYS_CLOSE)
     {
@@ -244,12 +301,7 @@ static void syscall_handler(registers_t *r)
             r->eax = (uint32_t)-1;
             return;
         }
-        if (!fat16_init())
-        {
-            r->eax = (uint32_t)-1;
-            return;
-        }
-        r->eax = fat16_cd_path(path) ? 0 : (uint32_t)-1;
+        r->eax = vfs_chdir(path) ? 0 : (uint32_t)-1;
     }
     else if (syscall_num == SYS_GETCWD)
     {
@@ -261,7 +313,7 @@ static void syscall_handler(registers_t *r)
             return;
         }
 
-        const char *cwd = fat16_get_path();
+        const char *cwd = vfs_getcwd();
         if (!cwd)
         {
             r->eax = (uint32_t)-1;
@@ -295,20 +347,46 @@ static void syscall_handler(registers_t *r)
             return;
         }
 
-        if (!fat16_init())
+        uint32_t written = 0;
+        if (!vfs_list_dir(path, out, out_size, &written))
         {
             r->eax = (uint32_t)-1;
             return;
         }
 
-        uint32_t written = 0;
-        if (!fat16_list_dir(path, out, out_size, &written))
+        r->eax = written;
+    }
+    else if (syscall_num == SYS_MMAP)
+    {
+        int fd = (int)r->ebx;
+        uint32_t offset = r->ecx;
+        uint32_t length = r->edx;
+
+        if (fd < 0 || fd >= MAX_FDS || !fd_table[fd].used || (fd_table[fd].flags & SYS_O_WRONLY))
         {
             r->eax = (uint32_t)-1;
             return;
         }
 
-        r->eax = written;
+        // The mapping opens the file again, so it outlives close().
+        uint32_t addr = mmap_file(fd_table[fd].path, offset, length);
+        r->eax = addr ? addr : (uint32_t)-1;
+    }
+    else if (syscall_num == SYS_MUNMAP)
+    {
+        r->eax = mmap_unmap(r->ebx, r->ecx) ? 0 : (uint32_t)-1;
+    }
+    else if (syscall_num == SYS_MEMINFO)
+    {
+        sys_meminfo_t *out = (sys_meminfo_t *)r->ebx;
+        if (!out)
+        {
+            r->eax = (uint32_t)-1;
+            return;
+        }
+
+        syscall_meminfo(out);
+        r->eax = 0;
     }
     else
     {
@@ -157,3 +157,70 @@ int sys_listdir(const char *path, char *out, uint32_t out_size)
     );
     return ret;
 }
+
+int sys_lseek(int fd, int32_t offset, uint32_t whence)
+{
+    int ret;
+    __asm__ __volatile__(
+        "mov $10, %%eax \n"
+        "mov %1, %%ebx \n"
+        "mov %2, %%ecx \n"
+        "mov %3, %%edx \n"
+        "int $0x80 \n"
+        "mov %%eax, %0 \n"
+        : "=r"(ret)
+        : "r"(fd), "r"(offset), "r"(whence)
+        : "eax", "ebx", "ecx", "edx"
+    );
+    return ret;
+}
+
+int sys_pwrite(int fd, const void *buf, uint32_t count, uint32_t offset)
+{
+    // Four arguments don't leave enough free registers for the mov-based
+    // pattern above, so bind them to their registers directly.
+    int ret;
+    __asm__ __volatile__(
+        "int $0x80 \n"
+        : "=a"(ret)
+        : "a"(SYS_PWRITE), "b"(fd), "c"(buf), "d"(count), "S"(offset)
+        : "memory"
+    );
+    return ret;
+}
+
+void *sys_mmap(int fd, uint32_t offset, uint32_t length)
+{
+    void *ret;
+    __asm__ __volatile__(
+        "int $0x80 \n"
+        : "=a"(ret)
+        : "a"(SYS_MMAP), "b"(fd), "c"(offset), "d"(length)
+        : "memory"
+    );
+    return ret;
+}
+
+int sys_munmap(void *addr, uint32_t length)
+{
+    int ret;
+    __asm__ __volatile__(
+        "int $0x80 \n"
+        : "=a"(ret)
+        : "a"(SYS_MUNMAP), "b"(addr), "c"(length)
+        : "memory"
+    );
+    return ret;
+}
+
+int sys_meminfo(sys_meminfo_t *out)
+{
+    int ret;
+    __asm__ __volatile__(
+        "int $0x80 \n"
+        : "=a"(ret)
+        : "a"(SYS_MEMINFO), "b"(out)
+        : "memory"
+    );
+    return ret;
+}
@@ -1,126 +1,221 @@
 #include "memory/kmalloc.h"
+#include "memory/slab.h"
+#include "memory/pmm.h"
 #include "vga.h"
 
-#define HEAP_MAGIC 0xAABBCCDD
+// Size classes served from slab caches; anything larger gets whole pages.
+#define KMALLOC_MIN_SHIFT 4 // 16 bytes
 
-typedef struct heap_block
+// Large blocks whose call site is remembered (any more only count in the
+// totals); slab objects keep theirs in the slab's tag bytes.
+#define KMALLOC_MAX_LARGE 32
+
+static const char *class_names[KMALLOC_CLASSES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"};
+
+static kmem_cache_t *classes[KMALLOC_CLASSES];
+
+// Tag n (1-based) is sites[n - 1]; tag 0 means "not tracked".
+static kmalloc_site_t sites[KMALLOC_MAX_SITES];
+static int site_count = 0;
+
+static struct
 {
-    uint32_t magic;
-    uint32_t size;
-    uint8_t free;
-    struct heap_block *next;
-} heap_block_t;
+    uint32_t addr; // 0 = free slot
+    uint8_t tag;
+} large[KMALLOC_MAX_LARGE];
 
-static heap_block_t *heap_head = 0;
-static uint32_t heap_end_addr = 0;
+static kmalloc_stats_t stats;
 
-static uint32_t align4(uint32_t size)
+/* -------------------- Accounting -------------------- */
+
+static uint8_t kmalloc_site_tag(const char *site)
 {
-    return (size + 3) & ~3;
+    for (int i = 0; i < site_count; i++)
+    {
+        if (sites[i].site == site)
+            return (uint8_t)(i + 1);
+    }
+
+    if (site_count >= KMALLOC_MAX_SITES)
+        return 0;
+
+    sites[site_count].site = site;
+    sites[site_count].allocs = 0;
+    sites[site_count].blocks = 0;
+    sites[site_count].bytes = 0;
+    site_count++;
+
+    return (uint8_t)site_count;
 }
 
-void kmalloc_init(uint32_t heap_start)
+static void kmalloc_charge(uint8_t tag, uint32_t bytes)
 {
-    heap_head = 0;
-    heap_end_addr = heap_start;
+    stats.bytes += bytes;
+    stats.blocks++;
+    stats.allocs++;
+
+    if (stats.bytes > stats.peak_bytes)
+        stats.peak_bytes = stats.bytes;
+
+    if (tag)
+    {
+        sites[tag - 1].allocs++;
+        sites[tag - 1].blocks++;
+        sites[tag - 1].bytes += bytes;
+    }
 }
 
-static heap_block_t *find_free_block(uint32_t size)
+static void kmalloc_uncharge(uint8_t tag, uint32_t bytes)
 {
-    heap_block_t *current = heap_head;
+    stats.bytes -= bytes;
+    stats.blocks--;
+    stats.frees++;
+
+    if (tag)
+    {
+        sites[tag - 1].blocks--;
+        sites[tag - 1].bytes -= bytes;
+    }
+}
 
-    while (current)
+// Remember the site of a large block; returns the tag to charge, which
+// is 0 when the table is full.
+static uint8_t kmalloc_large_set(uint32_t addr, uint8_t tag)
+{
+    for (int i = 0; i < KMALLOC_MAX_LARGE && tag; i++)
     {
-        if (current->magic != HEAP_MAGIC)
+        if (large[i].addr == 0)
         {
-            print("\n[HEAP ERROR] Heap corrupted!\n");
-            while (1) { __asm__ __volatile__("cli; hlt"); }
+            large[i].addr = addr;
+            large[i].tag = tag;
+            return tag;
         }
+    }
 
-        if (current->free && current->size >= size)
-            return current;
+    return 0;
+}
 
-        current = current->next;
+static uint8_t kmalloc_large_take(uint32_t addr)
+{
+    for (int i = 0; i < KMALLOC_MAX_LARGE; i++)
+    {
+        if (large[i].addr == addr)
+        {
+            large[i].addr = 0;
+            return large[i].tag;
+        }
     }
 
     return 0;
 }
 
-static heap_block_t *extend_heap(uint32_t size)
+/* ------------------- Public API ------------------- */
+
+void kmalloc_init()
+{
+    for (int i = 0; i < KMALLOC_CLASSES; i++)
+        classes[i] = kmem_cache_create(class_names[i], 1u << (KMALLOC_MIN_SHIFT + i));
+}
+
+void *kmalloc_at(uint32_t size, const char *site)
 {
-    heap_block_t *new_block = (heap_block_t *)heap_end_addr;
+    int c = 0;
+    while (c < KMALLOC_CLASSES && (1u << (KMALLOC_MIN_SHIFT + c)) < size)
+        c++;
 
-    new_block->magic = HEAP_MAGIC;
-    new_block->size = size;
-    new_block->free = 0;
-    new_block->next = 0;
+    stats.sizes[c]++;
 
-    heap_end_addr += sizeof(heap_block_t) + size;
+    uint8_t tag = kmalloc_site_tag(site);
+    void *ptr;
+    uint32_t bytes;
 
-    // first allocation case
-    if (!heap_head)
+    if (c < KMALLOC_CLASSES)
     {
-        heap_head = new_block;
+        ptr = kmem_cache_alloc(classes[c]);
+        bytes = 1u << (KMALLOC_MIN_SHIFT + c);
+
+        if (ptr)
+            kmem_set_tag(ptr, tag);
     }
     else
     {
-        heap_block_t *current = heap_head;
-        while (current->next)
-            current = current->next;
+        // Large objects: a run of just enough pages, whose length the
+        // page allocator remembers for kfree().
+        uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
 
-        current->next = new_block;
-    }
+        ptr = (void *)pmm_alloc_run(pages);
+        bytes = pages * PAGE_SIZE;
 
-    return new_block;
-}
-
-void *kmalloc(uint32_t size)
-{
-    size = align4(size);
-
-    heap_block_t *block = find_free_block(size);
+        if (ptr)
+            tag = kmalloc_large_set((uint32_t)ptr, tag);
+    }
 
-    if (block)
+    if (!ptr)
     {
-        block->free = 0;
-        return (void *)((uint32_t)block + sizeof(heap_block_t));
+        stats.failures++;
+        return 0;
     }
 
-    block = extend_heap(size);
-    return (void *)((uint32_t)block + sizeof(heap_block_t));
+    kmalloc_charge(tag, bytes);
+    return ptr;
 }
 
-static void merge_free_blocks()
+void kfree(void *ptr)
 {
-    heap_block_t *current = heap_head;
+    if (!ptr)
+        return;
 
-    while (current && current->next)
+    kmem_cache_t *cache = kmem_cache_of(ptr);
+    if (cache)
     {
-        if (current->free && current->next->free)
-        {
-            current->size = current->size + sizeof(heap_block_t) + current->next->size;
-            current->next = current->next->next;
-        }
-        else
+        int c = 0;
+        while (c < KMALLOC_CLASSES && classes[c] != cache)
+            c++;
+
+        // Objects of other caches go back through kmem_cache_free().
+        if (c == KMALLOC_CLASSES)
         {
-            current = current->next;
+            print("\n[HEAP ERROR] Invalid free detected!\n");
+            return;
         }
-    }
-}
 
-void kfree(void *ptr)
-{
-    if (!ptr)
-        return;
+        uint8_t tag = kmem_get_tag(ptr);
 
-    heap_block_t *block = (heap_block_t *)((uint32_t)ptr - sizeof(heap_block_t));
+        if (kmem_cache_free(cache, ptr))
+            kmalloc_uncharge(tag, 1u << (KMALLOC_MIN_SHIFT + c));
+        return;
+    }
 
-    if (block->magic != HEAP_MAGIC)
+    uint32_t pages = pmm_free_run((uint32_t)ptr);
+    if (!pages)
     {
         print("\n[HEAP ERROR] Invalid free detected!\n");
         return;
     }
 
-    block->free = 1;
-    merge_free_blocks();
+    kmalloc_uncharge(kmalloc_large_take((uint32_t)ptr), pages * PAGE_SIZE);
+}
+
+kmalloc_stats_t kmalloc_get_stats()
+{
+    return stats;
+}
+
+int kmalloc_get_site(int index, kmalloc_site_t *out)
+{
+    if (index < 0 || index >= site_count || !out)
+        return 0;
+
+    *out = sites[index];
+    return 1;
+}
+
+uint32_t kmalloc_class_size(int index)
+{
+    if (index < 0 || index >= KMALLOC_CLASSES)
+        return 0;
+
+    return 1u << (KMALLOC_MIN_SHIFT + index);
 }
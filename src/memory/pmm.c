@@ -0,0 +1,371 @@
+#include "memory/pmm.h"
+#include "vga.h"
+
+// BIOS data, VGA memory and option ROMs; never handed out.
+#define PMM_LOW_MEMORY 0x00100000u
+
+#define PMM_MAX_REGIONS 32
+
+// Memory assumed present when the boot loader tells us nothing.
+#define PMM_FALLBACK_TOP 0x00400000u
+
+// frame_info[] values: flags plus the block order.
+#define PMM_FREE 0x80 // first frame of a free block
+#define PMM_HEAD 0x40 // first frame of an allocated block
+#define PMM_MORE 0x20 // run continues with the next block
+#define PMM_ORDER_MASK 0x0F
+
+// Free blocks are linked through their own first bytes.
+typedef struct pmm_block
+{
+    struct pmm_block *prev;
+    struct pmm_block *next;
+} pmm_block_t;
+
+static uint8_t *frame_info = 0; // one byte per frame below pmm_top
+static uint32_t frame_count = 0;
+static uint32_t pmm_top = 0;
+
+static pmm_block_t *free_lists[PMM_MAX_ORDER + 1];
+
+static pmm_stats_t stats;
+
+// Usable RAM, page aligned; only needed while building the lists.
+static pmm_range_t regions[PMM_MAX_REGIONS];
+static int region_count = 0;
+
+/* -------------------- Free lists -------------------- */
+
+static pmm_block_t *pmm_block(uint32_t pfn)
+{
+    return (pmm_block_t *)(pfn * PAGE_SIZE);
+}
+
+static void pmm_list_push(uint32_t pfn, uint32_t order)
+{
+    pmm_block_t *b = pmm_block(pfn);
+
+    b->prev = 0;
+    b->next = free_lists[order];
+    if (free_lists[order])
+        free_lists[order]->prev = b;
+    free_lists[order] = b;
+
+    frame_info[pfn] = PMM_FREE | order;
+    stats.free_blocks[order]++;
+}
+
+static void pmm_list_remove(uint32_t pfn, uint32_t order)
+{
+    pmm_block_t *b = pmm_block(pfn);
+
+    if (b->prev)
+        b->prev->next = b->next;
+    else
+        free_lists[order] = b->next;
+
+    if (b->next)
+        b->next->prev = b->prev;
+
+    frame_info[pfn] = 0;
+    stats.free_blocks[order]--;
+}
+
+// Put a block back, merging it with its buddy for as long as the buddy
+// is a free block of the same order.
+static void pmm_release(uint32_t pfn, uint32_t order)
+{
+    while (order < PMM_MAX_ORDER)
+    {
+        uint32_t buddy = pfn ^ (1u << order);
+
+        if (buddy >= frame_count || frame_info[buddy] != (PMM_FREE | order))
+            break;
+
+        pmm_list_remove(buddy, order);
+        pfn &= ~(1u << order);
+        order++;
+    }
+
+    pmm_list_push(pfn, order);
+}
+
+/* -------------------- Boot-time setup -------------------- */
+
+static void pmm_add_region(uint64_t base, uint64_t len)
+{
+    if (region_count >= PMM_MAX_REGIONS || base >= PMM_LIMIT)
+        return;
+
+    uint64_t end = base + len;
+    if (end > PMM_LIMIT)
+        end = PMM_LIMIT;
+
+    uint32_t start = ((uint32_t)base + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t stop = (uint32_t)end & ~(PAGE_SIZE - 1);
+
+    if (stop <= start)
+        return;
+
+    regions[region_count].start = start;
+    regions[region_count].end = stop;
+    region_count++;
+
+    if (stop > pmm_top)
+        pmm_top = stop;
+}
+
+static void pmm_scan_memory(const multiboot_info_t *mbi)
+{
+    region_count = 0;
+    pmm_top = 0;
+
+    if (!mbi)
+    {
+        pmm_add_region(PMM_LOW_MEMORY, PMM_FALLBACK_TOP - PMM_LOW_MEMORY);
+        return;
+    }
+
+    if (mbi->flags & MULTIBOOT_INFO_MEM_MAP)
+    {
+        uint32_t at = mbi->mmap_addr;
+        uint32_t end = mbi->mmap_addr + mbi->mmap_length;
+
+        while (at < end)
+        {
+            const multiboot_mmap_entry_t *e = (const multiboot_mmap_entry_t *)at;
+
+            if (e->type == MULTIBOOT_MEMORY_AVAILABLE)
+                pmm_add_region(e->addr, e->len);
+
+            at += e->size + 4;
+        }
+    }
+    else if (mbi->flags & MULTIBOOT_INFO_MEMORY)
+    {
+        pmm_add_region(PMM_LOW_MEMORY, (uint64_t)mbi->mem_upper * 1024);
+    }
+}
+
+static int pmm_overlaps(uint32_t start, uint32_t end, const pmm_range_t *r)
+{
+    return start < r->end && r->start < end;
+}
+
+// Is [start, end) inside usable RAM and clear of every reserved range?
+static int pmm_usable(uint32_t start, uint32_t end, const pmm_range_t *reserved, int reserved_count)
+{
+    if (start < PMM_LOW_MEMORY || end <= start)
+        return 0;
+
+    for (int i = 0; i < reserved_count; i++)
+    {
+        if (pmm_overlaps(start, end, &reserved[i]))
+            return 0;
+    }
+
+    for (int i = 0; i < region_count; i++)
+    {
+        if (start >= regions[i].start && end <= regions[i].end)
+            return 1;
+    }
+
+    return 0;
+}
+
+int pmm_init(const multiboot_info_t *mbi, const pmm_range_t *reserved, int reserved_count)
+{
+    for (int i = 0; i <= PMM_MAX_ORDER; i++)
+    {
+        free_lists[i] = 0;
+        stats.free_blocks[i] = 0;
+    }
+
+    stats.total_pages = 0;
+    stats.free_pages = 0;
+
+    pmm_scan_memory(mbi);
+    if (region_count == 0)
+        return 0;
+
+    frame_count = pmm_top / PAGE_SIZE;
+
+    // The frame table goes right after the first reserved range it fits
+    // behind (normally the kernel image).
+    uint32_t info_bytes = (frame_count + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    pmm_range_t info = {0, 0};
+
+    for (int i = 0; i < reserved_count; i++)
+    {
+        uint32_t at = (reserved[i].end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+        if (pmm_usable(at, at + info_bytes, reserved, reserved_count) &&
+            (info.end == 0 || at < info.start))
+        {
+            info.start = at;
+            info.end = at + info_bytes;
+        }
+    }
+
+    if (info.end == 0)
+        return 0;
+
+    frame_info = (uint8_t *)info.start;
+    for (uint32_t i = 0; i < frame_count; i++)
+        frame_info[i] = 0;
+
+    for (int r = 0; r < region_count; r++)
+    {
+        for (uint32_t addr = regions[r].start; addr < regions[r].end; addr += PAGE_SIZE)
+        {
+            if (pmm_overlaps(addr, addr + PAGE_SIZE, &info) ||
+                !pmm_usable(addr, addr + PAGE_SIZE, reserved, reserved_count))
+                continue;
+
+            pmm_release(addr / PAGE_SIZE, 0);
+            stats.total_pages++;
+            stats.free_pages++;
+        }
+    }
+
+    return stats.total_pages > 0;
+}
+
+/* ------------------- Public API ------------------- */
+
+uint32_t pmm_get_top()
+{
+    return pmm_top;
+}
+
+uint32_t pmm_alloc_pages(uint32_t order)
+{
+    if (order > PMM_MAX_ORDER)
+        return 0;
+
+    uint32_t k = order;
+    while (k <= PMM_MAX_ORDER && !free_lists[k])
+        k++;
+
+    if (k > PMM_MAX_ORDER)
+        return 0;
+
+    uint32_t pfn = (uint32_t)free_lists[k] / PAGE_SIZE;
+    pmm_list_remove(pfn, k);
+
+    // Split down to the requested size, returning the upper halves.
+    while (k > order)
+    {
+        k--;
+        pmm_list_push(pfn + (1u << k), k);
+    }
+
+    frame_info[pfn] = PMM_HEAD | order;
+    stats.free_pages -= 1u << order;
+
+    return pfn * PAGE_SIZE;
+}
+
+void pmm_free_pages(uint32_t addr, uint32_t order)
+{
+    uint32_t pfn = addr / PAGE_SIZE;
+
+    if (!addr || (addr & (PAGE_SIZE - 1)) || pfn >= frame_count ||
+        frame_info[pfn] != (PMM_HEAD | order))
+    {
+        print("\n[PMM ERROR] Invalid free detected!\n");
+        return;
+    }
+
+    stats.free_pages += 1u << order;
+    pmm_release(pfn, order);
+}
+
+uint32_t pmm_alloc_run(uint32_t pages)
+{
+    if (pages == 0)
+        return 0;
+
+    uint32_t order = 0;
+    while (order <= PMM_MAX_ORDER && (1u << order) < pages)
+        order++;
+
+    uint32_t addr = pmm_alloc_pages(order);
+    if (!addr)
+        return 0;
+
+    uint32_t pfn = addr / PAGE_SIZE;
+    uint32_t end = pfn + (1u << order);
+
+    // Keep one block per set bit of `pages`, largest first, so each stays
+    // aligned to its size; all but the last say the run goes on.
+    uint32_t at = pfn;
+    uint32_t last = pfn;
+
+    for (int k = order; k >= 0; k--)
+    {
+        if (pages & (1u << k))
+        {
+            frame_info[at] = PMM_HEAD | PMM_MORE | k;
+            last = at;
+            at += 1u << k;
+        }
+    }
+
+    frame_info[last] &= ~PMM_MORE;
+
+    // Hand back the rest in the largest aligned blocks that fit.
+    stats.free_pages += end - at;
+
+    while (at < end)
+    {
+        uint32_t k = 0;
+        while (!(at & (1u << k)) && at + (2u << k) <= end)
+            k++;
+
+        pmm_release(at, k);
+        at += 1u << k;
+    }
+
+    return addr;
+}
+
+uint32_t pmm_free_run(uint32_t addr)
+{
+    uint32_t pfn = addr / PAGE_SIZE;
+    uint32_t pages = 0;
+
+    if (!addr || (addr & (PAGE_SIZE - 1)) || pfn >= frame_count || !(frame_info[pfn] & PMM_HEAD))
+        return 0;
+
+    uint8_t info;
+
+    do
+    {
+        info = frame_info[pfn];
+
+        uint32_t order = info & PMM_ORDER_MASK;
+
+        stats.free_pages += 1u << order;
+        pages += 1u << order;
+        pmm_release(pfn, order);
+        pfn += 1u << order;
+    } while ((info & PMM_MORE) && pfn < frame_count && (frame_info[pfn] & PMM_HEAD));
+
+    return pages;
+}
+
+uint32_t pmm_alloc_page()
+{
+    return pmm_alloc_pages(0);
+}
+
+void pmm_free_page(uint32_t addr)
+{
+    pmm_free_pages(addr, 0);
+}
+
+pmm_stats_t pmm_get_stats()
+{
+    return stats;
+}
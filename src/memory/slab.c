@@ -0,0 +1,253 @@
+#include "memory/slab.h"
+#include "memory/pmm.h"
+#include "vga.h"
+
+#define SLAB_MAGIC 0x51AB51AB
+
+// The page starts with the header, then one tag byte per object; the
+// objects follow, 8-byte aligned.
+#define SLAB_HEADER_SIZE 32
+
+typedef struct kmem_slab
+{
+    uint32_t magic;
+    kmem_cache_t *cache;
+    struct kmem_slab *prev;
+    struct kmem_slab *next;
+    void *free;     // first free object
+    uint16_t inuse;
+    uint16_t total;
+} kmem_slab_t;
+
+// A slab sits on exactly one list, chosen by how full it is. At most one
+// empty slab is kept so an alloc/free pair at a page boundary doesn't go
+// to the page allocator every time.
+struct kmem_cache
+{
+    const char *name;
+    uint32_t size;
+    uint32_t per_slab;
+    uint32_t offset; // first object within the slab
+
+    kmem_slab_t *partial;
+    kmem_slab_t *full;
+    kmem_slab_t *empty;
+
+    uint32_t objects;
+    uint32_t slabs;
+};
+
+static kmem_cache_t caches[KMEM_MAX_CACHES];
+static int cache_count = 0;
+
+/* -------------------- Slab lists -------------------- */
+
+static void slab_push(kmem_slab_t **list, kmem_slab_t *s)
+{
+    s->prev = 0;
+    s->next = *list;
+    if (*list)
+        (*list)->prev = s;
+    *list = s;
+}
+
+static void slab_remove(kmem_slab_t **list, kmem_slab_t *s)
+{
+    if (s->prev)
+        s->prev->next = s->next;
+    else
+        *list = s->next;
+
+    if (s->next)
+        s->next->prev = s->prev;
+
+    s->prev = 0;
+    s->next = 0;
+}
+
+static kmem_slab_t *slab_new(kmem_cache_t *cache)
+{
+    kmem_slab_t *s = (kmem_slab_t *)pmm_alloc_page();
+    if (!s)
+        return 0;
+
+    s->magic = SLAB_MAGIC;
+    s->cache = cache;
+    s->prev = 0;
+    s->next = 0;
+    s->inuse = 0;
+    s->total = cache->per_slab;
+
+    uint8_t *tags = (uint8_t *)s + SLAB_HEADER_SIZE;
+    for (uint32_t i = 0; i < cache->per_slab; i++)
+        tags[i] = 0;
+
+    // Chain the objects in address order.
+    uint8_t *obj = (uint8_t *)s + cache->offset;
+    s->free = obj;
+
+    for (uint32_t i = 0; i + 1 < cache->per_slab; i++)
+    {
+        *(void **)obj = obj + cache->size;
+        obj += cache->size;
+    }
+    *(void **)obj = 0;
+
+    cache->slabs++;
+    return s;
+}
+
+static void slab_release(kmem_cache_t *cache, kmem_slab_t *s)
+{
+    s->magic = 0;
+    cache->slabs--;
+    pmm_free_page((uint32_t)s);
+}
+
+/* ------------------- Public API ------------------- */
+
+kmem_cache_t *kmem_cache_create(const char *name, uint32_t size)
+{
+    if (cache_count >= KMEM_MAX_CACHES || size == 0 || size > KMEM_MAX_OBJECT)
+        return 0;
+
+    // Room for the free-list link, and 8-byte aligned objects.
+    if (size < sizeof(void *))
+        size = sizeof(void *);
+    size = (size + 7) & ~7u;
+
+    kmem_cache_t *cache = &caches[cache_count++];
+
+    cache->name = name;
+    cache->size = size;
+    cache->per_slab = (PAGE_SIZE - SLAB_HEADER_SIZE) / (size + 1);
+    while (SLAB_HEADER_SIZE + ((cache->per_slab + 7) & ~7u) + cache->per_slab * size > PAGE_SIZE)
+        cache->per_slab--;
+    cache->offset = SLAB_HEADER_SIZE + ((cache->per_slab + 7) & ~7u);
+    cache->partial = 0;
+    cache->full = 0;
+    cache->empty = 0;
+    cache->objects = 0;
+    cache->slabs = 0;
+
+    return cache;
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cache)
+{
+    if (!cache)
+        return 0;
+
+    kmem_slab_t *s = cache->partial;
+
+    if (!s)
+    {
+        s = cache->empty;
+        if (s)
+            cache->empty = 0;
+        else
+            s = slab_new(cache);
+
+        if (!s)
+            return 0;
+
+        slab_push(&cache->partial, s);
+    }
+
+    void *obj = s->free;
+    s->free = *(void **)obj;
+    s->inuse++;
+    cache->objects++;
+
+    if (s->inuse == s->total)
+    {
+        slab_remove(&cache->partial, s);
+        slab_push(&cache->full, s);
+    }
+
+    return obj;
+}
+
+int kmem_cache_free(kmem_cache_t *cache, void *obj)
+{
+    if (!obj)
+        return 1;
+
+    kmem_slab_t *s = (kmem_slab_t *)((uint32_t)obj & ~(PAGE_SIZE - 1));
+    uint32_t off = (uint32_t)obj - (uint32_t)s;
+
+    if (s->magic != SLAB_MAGIC || s->cache != cache || s->inuse == 0 ||
+        off < cache->offset || (off - cache->offset) % cache->size != 0)
+    {
+        print("\n[HEAP ERROR] Invalid free detected!\n");
+        return 0;
+    }
+
+    if (s->inuse == s->total)
+    {
+        slab_remove(&cache->full, s);
+        slab_push(&cache->partial, s);
+    }
+
+    *((uint8_t *)s + SLAB_HEADER_SIZE + (off - cache->offset) / cache->size) = 0;
+    *(void **)obj = s->free;
+    s->free = obj;
+    s->inuse--;
+    cache->objects--;
+
+    if (s->inuse == 0)
+    {
+        slab_remove(&cache->partial, s);
+
+        if (cache->empty)
+            slab_release(cache, s);
+        else
+            cache->empty = s;
+    }
+
+    return 1;
+}
+
+kmem_cache_t *kmem_cache_of(const void *ptr)
+{
+    uint32_t addr = (uint32_t)ptr;
+
+    // Slab objects never start a page; that's the header.
+    if ((addr & (PAGE_SIZE - 1)) == 0)
+        return 0;
+
+    kmem_slab_t *s = (kmem_slab_t *)(addr & ~(PAGE_SIZE - 1));
+    return (s->magic == SLAB_MAGIC) ? s->cache : 0;
+}
+
+// Tag byte of an object known to belong to a slab.
+static uint8_t *kmem_tag_slot(const void *obj)
+{
+    kmem_slab_t *s = (kmem_slab_t *)((uint32_t)obj & ~(PAGE_SIZE - 1));
+    uint32_t off = (uint32_t)obj - (uint32_t)s;
+
+    return (uint8_t *)s + SLAB_HEADER_SIZE + (off - s->cache->offset) / s->cache->size;
+}
+
+void kmem_set_tag(void *obj, uint8_t tag)
+{
+    *kmem_tag_slot(obj) = tag;
+}
+
+uint8_t kmem_get_tag(const void *obj)
+{
+    return *kmem_tag_slot(obj);
+}
+
+int kmem_cache_get_stats(int index, kmem_cache_stats_t *out)
+{
+    if (index < 0 || index >= cache_count || !out)
+        return 0;
+
+    out->name = caches[index].name;
+    out->object_size = caches[index].size;
+    out->objects = caches[index].objects;
+    out->capacity = caches[index].slabs * caches[index].per_slab;
+    out->slabs = caches[index].slabs;
+    return 1;
+}
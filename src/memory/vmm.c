@@ -0,0 +1,302 @@
+#include "memory/vmm.h"
+#include "memory/pmm.h"
+#include "memory/slab.h"
+#include "string.h"
+
+#define PDE_INDEX(va) ((va) >> 22)
+#define PTE_INDEX(va) (((va) >> 12) & 0x3FF)
+#define FRAME_MASK 0xFFFFF000u
+
+struct vmm_space
+{
+    uint32_t *directory; // page directory, identity-mapped
+    uint32_t tables;     // user-half page tables allocated
+    uint32_t pages;      // owned frames mapped
+};
+
+// Kernel page directory + the table for the first 4MB (aligned)
+static uint32_t page_directory[1024] __attribute__((aligned(4096)));
+static uint32_t first_page_table[1024] __attribute__((aligned(4096)));
+
+static vmm_space_t kernel_space;
+static vmm_space_t *current = &kernel_space;
+
+static kmem_cache_t *space_cache = 0;
+
+/* -------------------- Helpers -------------------- */
+
+static void vmm_load_cr3(uint32_t *directory)
+{
+    __asm__ __volatile__("mov %0, %%cr3" : : "r"((uint32_t)directory) : "memory");
+}
+
+static void vmm_invalidate(vmm_space_t *space, uint32_t vaddr)
+{
+    if (space == current)
+        __asm__ __volatile__("invlpg (%0)" : : "r"(vaddr) : "memory");
+}
+
+static int vmm_user_range(uint32_t start, uint32_t end)
+{
+    return start >= LAYOUT_USER_BASE && end <= LAYOUT_USER_END && start <= end;
+}
+
+// Page table entry for `vaddr`, allocating the page table when `create`
+// is set. 0 when there is none. Page tables live in identity-mapped
+// memory.
+static uint32_t *vmm_entry(vmm_space_t *space, uint32_t vaddr, int create)
+{
+    uint32_t *pde = &space->directory[PDE_INDEX(vaddr)];
+
+    if (!(*pde & PAGE_PRESENT))
+    {
+        if (!create)
+            return 0;
+
+        uint32_t table = pmm_alloc_page();
+        if (!table)
+            return 0;
+
+        memset((void *)table, 0, PAGE_SIZE);
+
+        // PDEs allow everything; the PTEs carry the real permissions.
+        *pde = table | PAGE_USER | PAGE_RW | PAGE_PRESENT;
+        space->tables++;
+    }
+
+    if (*pde & PAGE_LARGE)
+        return 0;
+
+    uint32_t *table = (uint32_t *)(*pde & FRAME_MASK);
+    return &table[PTE_INDEX(vaddr)];
+}
+
+/* -------------------- Boot-time setup -------------------- */
+
+void vmm_init(uint32_t ram_top)
+{
+    // Clear page directory
+    for (int i = 0; i < 1024; i++)
+    {
+        page_directory[i] = 0x00000002; // supervisor, read/write, not present
+    }
+
+    // Fill first page table (identity map first 4MB)
+    for (int i = 0; i < 1024; i++)
+    {
+        first_page_table[i] = (i * PAGE_SIZE) | PAGE_RW | PAGE_PRESENT;
+    }
+
+    page_directory[0] = ((uint32_t)first_page_table) | PAGE_RW | PAGE_PRESENT;
+
+    // Everything else the page allocator may hand out.
+    if (ram_top > LAYOUT_USER_BASE)
+        ram_top = LAYOUT_USER_BASE;
+
+    for (uint32_t addr = 0x400000; addr < ram_top; addr += 0x400000)
+        page_directory[PDE_INDEX(addr)] = addr | PAGE_LARGE | PAGE_RW | PAGE_PRESENT;
+
+    // 4MB pages need CR4.PSE.
+    uint32_t cr4;
+    __asm__ __volatile__("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= 0x10;
+    __asm__ __volatile__("mov %0, %%cr4" : : "r"(cr4));
+
+    kernel_space.directory = page_directory;
+    kernel_space.tables = 0;
+    kernel_space.pages = 0;
+    current = &kernel_space;
+
+    // Enable paging
+    vmm_load_cr3(page_directory);
+
+    uint32_t cr0;
+    __asm__ __volatile__("mov %%cr0, %0" : "=r"(cr0));
+    cr0 |= 0x80000000; // Set PG bit (paging enable)
+    __asm__ __volatile__("mov %0, %%cr0" : : "r"(cr0));
+}
+
+/* ------------------- Address spaces ------------------- */
+
+vmm_space_t *vmm_kernel_space()
+{
+    return &kernel_space;
+}
+
+vmm_space_t *vmm_current()
+{
+    return current;
+}
+
+vmm_space_t *vmm_space_create()
+{
+    if (!space_cache)
+        space_cache = kmem_cache_create("vmm-space", sizeof(vmm_space_t));
+
+    vmm_space_t *space = (vmm_space_t *)kmem_cache_alloc(space_cache);
+    if (!space)
+        return 0;
+
+    uint32_t dir = pmm_alloc_page();
+    if (!dir)
+    {
+        kmem_cache_free(space_cache, space);
+        return 0;
+    }
+
+    space->directory = (uint32_t *)dir;
+    space->tables = 0;
+    space->pages = 0;
+
+    // The kernel half never changes after boot, so a copy stays valid.
+    for (uint32_t i = 0; i < 1024; i++)
+        space->directory[i] = (i < PDE_INDEX(LAYOUT_USER_BASE)) ? page_directory[i] : 0;
+
+    return space;
+}
+
+void vmm_space_destroy(vmm_space_t *space)
+{
+    if (!space || space == &kernel_space || space == current)
+        return;
+
+    for (uint32_t i = PDE_INDEX(LAYOUT_USER_BASE); i < PDE_INDEX(LAYOUT_USER_END); i++)
+    {
+        uint32_t pde = space->directory[i];
+        if (!(pde & PAGE_PRESENT))
+            continue;
+
+        uint32_t *table = (uint32_t *)(pde & FRAME_MASK);
+
+        for (int j = 0; j < 1024; j++)
+        {
+            if ((table[j] & PAGE_PRESENT) && (table[j] & PAGE_OWNED))
+                pmm_free_page(table[j] & FRAME_MASK);
+        }
+
+        pmm_free_page((uint32_t)table);
+    }
+
+    pmm_free_page((uint32_t)space->directory);
+    kmem_cache_free(space_cache, space);
+}
+
+vmm_space_t *vmm_switch(vmm_space_t *space)
+{
+    vmm_space_t *prev = current;
+
+    if (space && space != current)
+    {
+        current = space;
+        vmm_load_cr3(space->directory);
+    }
+
+    return prev;
+}
+
+/* ------------------- Mappings ------------------- */
+
+int vmm_map(vmm_space_t *space, uint32_t vaddr, uint32_t paddr, uint32_t flags)
+{
+    if (!space || !vmm_user_range(vaddr, vaddr + PAGE_SIZE))
+        return 0;
+
+    uint32_t *pte = vmm_entry(space, vaddr, 1);
+    if (!pte || (*pte & PAGE_PRESENT))
+        return 0;
+
+    *pte = (paddr & FRAME_MASK) | (flags & 0xFFF) | PAGE_PRESENT;
+    vmm_invalidate(space, vaddr);
+    return 1;
+}
+
+uint32_t vmm_unmap(vmm_space_t *space, uint32_t vaddr)
+{
+    if (!space || !vmm_user_range(vaddr, vaddr + PAGE_SIZE))
+        return 0;
+
+    uint32_t *pte = vmm_entry(space, vaddr, 0);
+    if (!pte || !(*pte & PAGE_PRESENT))
+        return 0;
+
+    uint32_t entry = *pte;
+    uint32_t frame = entry & FRAME_MASK;
+
+    *pte = 0;
+    vmm_invalidate(space, vaddr);
+
+    if (entry & PAGE_OWNED)
+    {
+        pmm_free_page(frame);
+        space->pages--;
+    }
+
+    return frame;
+}
+
+int vmm_protect(vmm_space_t *space, uint32_t start, uint32_t end, uint32_t flags)
+{
+    start &= FRAME_MASK;
+
+    if (!space || !vmm_user_range(start, end))
+        return 0;
+
+    for (uint32_t va = start; va < end; va += PAGE_SIZE)
+    {
+        uint32_t *pte = vmm_entry(space, va, 0);
+        if (!pte || !(*pte & PAGE_PRESENT))
+            continue;
+
+        *pte = (*pte & ~(uint32_t)(PAGE_RW | PAGE_USER)) | (flags & (PAGE_RW | PAGE_USER));
+        vmm_invalidate(space, va);
+    }
+
+    return 1;
+}
+
+int vmm_alloc(vmm_space_t *space, uint32_t start, uint32_t end, uint32_t flags)
+{
+    start &= FRAME_MASK;
+
+    if (!space || !vmm_user_range(start, end))
+        return 0;
+
+    for (uint32_t va = start; va < end; va += PAGE_SIZE)
+    {
+        uint32_t *pte = vmm_entry(space, va, 1);
+        if (!pte)
+            return 0;
+
+        if (*pte & PAGE_PRESENT)
+        {
+            *pte |= flags & (PAGE_RW | PAGE_USER);
+            vmm_invalidate(space, va);
+            continue;
+        }
+
+        uint32_t frame = pmm_alloc_page();
+        if (!frame)
+            return 0;
+
+        memset((void *)frame, 0, PAGE_SIZE);
+
+        *pte = frame | (flags & 0xFFF) | PAGE_OWNED | PAGE_PRESENT;
+        space->pages++;
+        vmm_invalidate(space, va);
+    }
+
+    return 1;
+}
+
+uint32_t vmm_virt_to_phys(uint32_t vaddr)
+{
+    // The kernel half is an identity map.
+    if (vaddr < LAYOUT_USER_BASE)
+        return vaddr;
+
+    uint32_t *pte = vmm_entry(current, vaddr, 0);
+    if (!pte || !(*pte & PAGE_PRESENT))
+        return 0;
+
+    return (*pte & FRAME_MASK) | (vaddr & ~FRAME_MASK);
+}